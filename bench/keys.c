@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "input.h"
+#include "util.h"
+#include "ve.h"
+
+// ========================================
+// headless key stream benchmark
+//
+// usage: bin/keys [file]
+// every scenario runs in its own process, opens the file in a fresh
+// editor and replays its key stream through the input decoder and ve_next
+// like the terminal does; one json object per scenario is printed
+// without a file a synthetic 32MB file with 60 byte lines is used
+// the file itself is never written; :write goes to a temporary file
+//
+// the allocator is wrapped at link time (see the Makefile) to count the
+// allocations done by the editor
+// ========================================
+
+/**
+ * allocations since the start of the program
+ */
+static long ALLOCS;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+	ALLOCS++;
+	return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+	ALLOCS++;
+	return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	ALLOCS++;
+	return __real_realloc(ptr, size);
+}
+
+/**
+ * seconds since an arbitrary point
+ */
+double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * peak resident set size in kilobytes
+ */
+long peak_rss()
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+/**
+ * create the synthetic file; lines of words so that every motion has
+ * something to stop at
+ *
+ * params:
+ *	path	template of the path; changed in place
+ *	size	size of the file
+ */
+int make_file(char *path, long size)
+{
+	static const char *words[] = { "alpha", "beta", "gamma", "delta",
+		"x1", "y_22", "(z)", "->", "epsilon" };
+	FILE *fp = fdopen(mkstemp(path), "w");
+	if (fp == NULL)
+		return IO_ERR;
+
+	unsigned seed = 1;
+	for (long done = 0, col = 0; done < size;)
+	{
+		seed = seed * 1103515245 + 12345;
+		const char *word = words[(seed >> 16) % 9];
+		int len = strlen(word);
+		if (col + len + 1 > 60)
+		{
+			fputc('\n', fp);
+			done += col + 1;
+			col = 0;
+			continue;
+		}
+		fputs(word, fp);
+		fputc(' ', fp);
+		col += len + 1;
+	}
+	fclose(fp);
+	return NO_ERR;
+}
+
+/**
+ * append a string some number of times
+ *
+ * params:
+ *	dest	where the string is appended
+ *	src	string
+ *	times	number of times
+ */
+void repeat(struct str_t *dest, const char *src, int times)
+{
+	int len = strlen(src);
+	for (int i = 0; i < times; i++)
+		str_appends(dest, src, len);
+}
+
+/**
+ * build the key stream of a scenario
+ *
+ * params:
+ *	name	name of the scenario
+ *	path	file of the scenario
+ *	tmp	temporary file for :write
+ *	dest	where the bytes are appended
+ */
+void make_keys(const char *name, const char *path, const char *tmp,
+	struct str_t *dest)
+{
+	char cmd[512];
+	if (strcmp(name, "type") == 0)
+	{
+		// typing in the middle of the file
+		repeat(dest, "50%i", 1);
+		repeat(dest, "the quick brown fox jumps over the lazy dog\r", 2000);
+		repeat(dest, "\x1b", 1);
+	}
+	else if (strcmp(name, "delete") == 0)
+	{
+		repeat(dest, "50%i", 1);
+		repeat(dest, "\x7f", 50000);
+		repeat(dest, "\x1b", 1);
+	}
+	else if (strcmp(name, "paste") == 0)
+	{
+		// bracketed pastes of 64KB each
+		repeat(dest, "50%i", 1);
+		for (int i = 0; i < 16; i++)
+		{
+			repeat(dest, "\x1b[200~", 1);
+			repeat(dest, "pasted line of text that is long enough\r", 1600);
+			repeat(dest, "\x1b[201~", 1);
+		}
+		repeat(dest, "\x1b", 1);
+	}
+	else if (strcmp(name, "motion") == 0)
+	{
+		repeat(dest, "w", 20000);
+		repeat(dest, "b", 10000);
+		repeat(dest, "e", 20000);
+		repeat(dest, "WBE", 5000);
+		repeat(dest, "j", 20000);
+		repeat(dest, "k", 10000);
+		repeat(dest, "lh", 10000);
+		repeat(dest, "G100000wgg50%25%\x06\x02\x04\x15", 100);
+	}
+	else if (strcmp(name, "search") == 0)
+	{
+		repeat(dest, "/epsilon\r", 1);
+		repeat(dest, "n", 2000);
+		repeat(dest, "N", 2000);
+		repeat(dest, "/ep[a-z]+n\r", 1);
+		repeat(dest, "n", 2000);
+	}
+	else if (strcmp(name, "substitute") == 0)
+	{
+		repeat(dest, ":%s/gamma/GAMMA/g\r", 1);
+		repeat(dest, "u", 1);
+	}
+	else if (strcmp(name, "longline") == 0)
+	{
+		// one line of 80KB; a search or substitution is one pass over it
+		repeat(dest, "Go\x1b[200~", 1);
+		repeat(dest, "a", 80000);
+		repeat(dest, "\x1b[201~\x1b", 1);
+		repeat(dest, "/a+\r", 1);
+		repeat(dest, "N", 100);
+		repeat(dest, ":s/a|a*b/x/g\r", 1);
+		repeat(dest, "u", 1);
+	}
+	else if (strcmp(name, "undo") == 0)
+	{
+		repeat(dest, "i", 1);
+		repeat(dest, "undo me\r\x1bi", 5000);
+		repeat(dest, "\x1b", 1);
+		repeat(dest, "u", 5000);
+		repeat(dest, "\x12", 5000);
+	}
+	else if (strcmp(name, "read") == 0)
+	{
+		snprintf(cmd, sizeof(cmd), "G:read %s\r", path);
+		repeat(dest, cmd, 2);
+	}
+	else if (strcmp(name, "write") == 0)
+	{
+		snprintf(cmd, sizeof(cmd), ":saveas %s\r", tmp);
+		repeat(dest, cmd, 1);
+		repeat(dest, ":write\r", 3);
+	}
+}
+
+/**
+ * replay a key stream like term_read and print the results
+ *
+ * params:
+ *	name	name of the scenario
+ *	path	file to open
+ *	tmp	temporary file for :write
+ */
+int run(const char *name, const char *path, const char *tmp)
+{
+	struct ve_t ve;
+	struct input_t in;
+	struct str_t keys;
+	if (ve_init(&ve) || input_init(&in) || str_init(&keys))
+		return MALLOC_ERR;
+	ve_open(&ve, path);
+	ve.screen_rows = 50;
+	make_keys(name, path, tmp, &keys);
+
+	char *bytes = NULL;
+	str_build(&keys, &bytes);
+	int err = input_feed(&in, bytes, keys.len);
+	if (err)
+		return err;
+
+	long nkeys = 0;
+	long allocs = ALLOCS;
+	double start = now();
+	while (!err && in.bytes.len > 0)
+	{
+		err = input_decode(&in, 1);
+		for (int i = 0; i < in.nkeys; i++)
+		{
+			struct input_key_t *k = in.keys + i;
+			if (k->key == PASTE_KEY)
+			{
+				const char *text = NULL;
+				int text_len = 0;
+				str_span(&in.paste, k->off, &text, &text_len);
+				ve_insert(&ve, text, k->len);
+			}
+			else
+				ve_next(&ve, k->key);
+		}
+		nkeys += in.nkeys;
+		input_clear(&in);
+	}
+	double secs = now() - start;
+	allocs = ALLOCS - allocs;
+
+	long len = 0;
+	text_len(&ve.text, &len);
+	printf("{\"bench\": \"%s\", \"keys\": %ld, \"bytes\": %d, "
+		"\"ms\": %.3f, \"ns_per_key\": %.1f, \"allocs_per_key\": %.3f, "
+		"\"peak_rss_kb\": %ld, \"text_bytes\": %ld}\n",
+		name, nkeys, keys.len, secs * 1e3,
+		nkeys ? secs * 1e9 / nkeys : 0.0,
+		nkeys ? (double) allocs / nkeys : 0.0, peak_rss(), len);
+	fflush(stdout);
+
+	free(bytes);
+	str_free(&keys);
+	input_free(&in);
+	ve_free(&ve);
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	char file[] = "/tmp/ve-keys-XXXXXX";
+	char tmp[] = "/tmp/ve-keys-write-XXXXXX";
+	const char *path = argc > 1 ? argv[1] : file;
+	if (argc <= 1 && make_file(file, 32L << 20))
+	{
+		perror("make_file");
+		return 1;
+	}
+	int fd = mkstemp(tmp);
+	if (fd == -1)
+	{
+		perror("mkstemp");
+		return 1;
+	}
+	close(fd);
+
+	static const char *names[] = { "type", "delete", "paste", "motion",
+		"search", "substitute", "longline", "undo", "read", "write" };
+	// a process per scenario keeps the peak rss of each one apart
+	int err = NO_ERR;
+	int n = sizeof(names) / sizeof(names[0]);
+	for (int i = 0; i < n && !err; i++)
+	{
+		pid_t pid = fork();
+		if (pid == 0)
+			_exit(run(names[i], path, tmp) ? 1 : 0);
+		int status = 0;
+		if (pid == -1 || waitpid(pid, &status, 0) == -1 ||
+			!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			err = IO_ERR;
+	}
+
+	unlink(tmp);
+	if (argc <= 1)
+		unlink(file);
+	return err ? 1 : 0;
+}
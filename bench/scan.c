@@ -0,0 +1,139 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "util.h"
+
+// ========================================
+// newline scanner microbenchmark
+//
+// usage: bin/scan [file]
+// without a file a synthetic 256MB file with 60 byte lines is used
+// ========================================
+
+/**
+ * seconds since an arbitrary point
+ */
+double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * create the synthetic file and give its path
+ *
+ * params:
+ *	path	template of the path; changed in place
+ *	size	size of the file
+ */
+int make_file(char *path, long size)
+{
+	int fd = mkstemp(path);
+	if (fd == -1)
+		return IO_ERR;
+
+	char block[1 << 16];
+	for (int i = 0; i < (int) sizeof(block); i++)
+		block[i] = (i % 61 == 60) ? '\n' : 'a' + i % 26;
+	for (long done = 0; done < size; done += sizeof(block))
+		if (write(fd, block, sizeof(block)) != sizeof(block))
+			return IO_ERR;
+	close(fd);
+	return NO_ERR;
+}
+
+/**
+ * the old ':read' loop; one fgetc per byte
+ */
+long run_fgetc(const char *path, const char *text, long len)
+{
+	long lines = 0;
+	FILE *fd = fopen(path, "r");
+	do {
+		char ch = fgetc(fd);
+		if (feof(fd)) break;
+		lines += ch == '\n';
+	} while (1);
+	fclose(fd);
+	return lines;
+}
+
+/**
+ * one memchr per newline
+ */
+long run_memchr(const char *path, const char *text, long len)
+{
+	long lines = 0;
+	const char *p = text, *end = text + len;
+	while ((p = memchr(p, '\n', end - p)) != NULL)
+	{
+		lines++;
+		p++;
+	}
+	return lines;
+}
+
+/**
+ * lines_scan with the implementation chosen by lines_isa
+ */
+long run_scan(const char *path, const char *text, long len)
+{
+	struct lines_t lines;
+	lines_init(&lines, len);
+	lines_scan(&lines, text, len, 0);
+	long res = lines.len;
+	lines_free(&lines);
+	return res;
+}
+
+int main(int argc, char **argv)
+{
+	char tmp[] = "/tmp/ve-scan-XXXXXX";
+	const char *path = argc > 1 ? argv[1] : tmp;
+	if (argc <= 1 && make_file(tmp, 256L << 20))
+	{
+		perror("make_file");
+		return 1;
+	}
+
+	int fd = open(path, O_RDONLY);
+	long len = lseek(fd, 0, SEEK_END);
+	const char *text = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (text == MAP_FAILED)
+	{
+		perror("mmap");
+		return 1;
+	}
+
+	// touch the pages once so that every run reads from memory
+	run_memchr(path, text, len);
+
+	static const char *names[] = { "fgetc", "memchr", "scalar", "sse2",
+		"avx2" };
+	static const int isa[] = { 0, 0, SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2 };
+	for (int i = 0; i < 5; i++)
+	{
+		if (isa[i] && lines_isa(isa[i]))
+			continue;
+
+		double start = now();
+		long lines = i == 0 ? run_fgetc(path, text, len) :
+			i == 1 ? run_memchr(path, text, len) :
+			run_scan(path, text, len);
+		double secs = now() - start;
+		printf("%-8s %10.1f MB/s %10ld lines\n", names[i],
+			len / secs / 1e6, lines);
+	}
+
+	munmap((void *) text, len);
+	close(fd);
+	if (argc <= 1)
+		unlink(tmp);
+	return 0;
+}
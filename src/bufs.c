@@ -0,0 +1,140 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bufs.h"
+#include "text.h"
+#include "util.h"
+#include "ve.h"
+
+// ========================================
+// helper declaration
+// ========================================
+
+/**
+ * append a new empty editor to the list
+ *
+ * params:
+ *	self	self pointer
+ *	res	where the editor is given
+ */
+int bufs_add(struct bufs_t *self, struct ve_t **res);
+
+/**
+ * is the file of an editor the given path?
+ *
+ * params:
+ *	ve	editor
+ *	path	path of a file
+ */
+int bufs_same(struct ve_t *ve, const char *path);
+
+// ========================================
+// bufs.h - definition
+// ========================================
+
+int bufs_init(struct bufs_t *self)
+{
+	self->list = NULL;
+	self->len = 0;
+	self->cap = 0;
+	self->cur = 0;
+	self->wins = NULL;
+
+	struct ve_t *ve = NULL;
+	return bufs_add(self, &ve);
+}
+
+int bufs_free(struct bufs_t *self)
+{
+	for (int i = 0; i < self->len; i++)
+	{
+		ve_free(self->list[i]);
+		free(self->list[i]);
+	}
+	free(self->list);
+	self->list = NULL;
+	self->len = 0;
+	self->cap = 0;
+	self->cur = 0;
+	return NO_ERR;
+}
+
+struct ve_t *bufs_cur(struct bufs_t *self)
+{
+	return self->list[self->cur];
+}
+
+int bufs_open(struct bufs_t *self, const char *path, int *found)
+{
+	*found = 0;
+	for (int i = 0; i < self->len; i++)
+	{
+		if (bufs_same(self->list[i], path))
+		{
+			*found = 1;
+			return bufs_switch(self, i);
+		}
+	}
+
+	// the empty editor started without a file takes the first file
+	struct ve_t *cur = bufs_cur(self);
+	long len = 0;
+	text_len(&cur->text, &len);
+	if (cur->filename.len == 0 && !cur->dirty && len == 0)
+		return ve_open(cur, path);
+
+	struct ve_t *ve = NULL;
+	int err = bufs_add(self, &ve);
+	if (err)
+		return err;
+	ve->screen_rows = cur->screen_rows;
+	self->cur = self->len - 1;
+	return ve_open(ve, path);
+}
+
+int bufs_switch(struct bufs_t *self, int i)
+{
+	if (i < 0 || i >= self->len)
+		return RANGE_ERR;
+	self->cur = i;
+	return NO_ERR;
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+int bufs_add(struct bufs_t *self, struct ve_t **res)
+{
+	if (self->len == self->cap)
+	{
+		int cap = self->cap ? self->cap * 2 : 8;
+		struct ve_t **list = (struct ve_t **) realloc(self->list,
+			cap * sizeof(struct ve_t *));
+		if (list == NULL)
+			return MALLOC_ERR;
+		self->list = list;
+		self->cap = cap;
+	}
+
+	struct ve_t *ve = (struct ve_t *) malloc(sizeof(struct ve_t));
+	if (ve == NULL)
+		return MALLOC_ERR;
+	int err = ve_init(ve);
+	if (err)
+	{
+		free(ve);
+		return err;
+	}
+	ve->bufs = self;
+	self->list[self->len++] = ve;
+	*res = ve;
+	return NO_ERR;
+}
+
+int bufs_same(struct ve_t *ve, const char *path)
+{
+	if (ve->filename.len != (int) strlen(path))
+		return 0;
+	return strcmp(str_cstr(&ve->filename), path) == 0;
+}
@@ -0,0 +1,81 @@
+#ifndef BUFS_H
+#define BUFS_H
+
+#include "util.h"
+#include "ve.h"
+
+struct wins_t;
+
+// ========================================
+// buffer list
+// ========================================
+
+/**
+ * documents open at the same time
+ * every document is a whole editor with its own cursor, scroll offsets,
+ * undo log, highlighting and loader thread, so switching between them
+ * reloads nothing and only redraws
+ *
+ * members:
+ *	list	editors of the documents; allocated one by one so that
+ *		they never move
+ *	len	number of editors
+ *	cap	capacity of list
+ *	cur	index of the editor being shown
+ *	wins	windows showing the editors; NULL without a terminal
+ */
+struct bufs_t
+{
+	struct ve_t **list;
+	int len;
+	int cap;
+	int cur;
+	struct wins_t *wins;
+};
+
+/**
+ * initialize a list with one empty editor
+ *
+ * params:
+ *	self	self pointer
+ */
+int bufs_init(struct bufs_t *self);
+
+/**
+ * free every editor of the list
+ *
+ * params:
+ *	self	self pointer
+ */
+int bufs_free(struct bufs_t *self);
+
+/**
+ * editor being shown
+ *
+ * params:
+ *	self	self pointer
+ */
+struct ve_t *bufs_cur(struct bufs_t *self);
+
+/**
+ * show the editor of a file; the file is opened in a new editor unless
+ * it is open already
+ * an unnamed and untouched editor is reused for it
+ *
+ * params:
+ *	self	self pointer
+ *	path	path of the file
+ *	found	where it is given if the file was open already
+ */
+int bufs_open(struct bufs_t *self, const char *path, int *found);
+
+/**
+ * show another editor of the list
+ *
+ * params:
+ *	self	self pointer
+ *	i	index of the editor
+ */
+int bufs_switch(struct bufs_t *self, int i);
+
+#endif // BUFS_H
@@ -0,0 +1,631 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cols.h"
+#include "text.h"
+#include "utf8.h"
+#include "util.h"
+
+// ========================================
+// helper declaration
+// ========================================
+
+/**
+ * start the index over if it isn't of the line and version of the text
+ *
+ * params:
+ *	self	self pointer
+ *	text	document
+ *	row	line number
+ */
+void cols_sync(struct cols_t *self, struct text_t *text, int row);
+
+/**
+ * byte offset and column of a checkpoint with the pending shift applied
+ *
+ * params:
+ *	self	self pointer
+ *	i	index of the checkpoint; 0 <= i < n
+ *	off	where the byte offset is given
+ *	col	where the column is given
+ */
+void cols_get(struct cols_t *self, int i, long *off, long *col);
+
+/**
+ * move the checkpoints from one on by some bytes and columns; moving the
+ * same ones again only adds to the pending shift
+ *
+ * params:
+ *	self	self pointer
+ *	k	index of the first checkpoint to move
+ *	len	bytes to move by
+ *	width	columns to move by
+ */
+void cols_shift(struct cols_t *self, int k, long len, long width);
+
+/**
+ * drop the checkpoints from one on; the line is indexed again from the
+ * one before it when it is needed
+ *
+ * params:
+ *	self	self pointer
+ *	k	index of the first checkpoint to drop
+ */
+void cols_cut(struct cols_t *self, int k);
+
+/**
+ * number of checkpoints at or before a byte offset or a column
+ *
+ * params:
+ *	self	self pointer
+ *	key	byte offset or column
+ *	by_col	is the key a column
+ */
+int cols_count(struct cols_t *self, long key, int by_col);
+
+/**
+ * last checkpoint at or before a byte offset or a column; the start of
+ * the line if there is none
+ *
+ * params:
+ *	self	self pointer
+ *	key	byte offset or column
+ *	by_col	is the key a column
+ *	off	where the offset of the checkpoint is given
+ *	col	where the column of the checkpoint is given
+ */
+void cols_find(struct cols_t *self, long key, int by_col, long *off,
+	long *col);
+
+/**
+ * add a checkpoint after the last one; skipped if there is no memory
+ *
+ * params:
+ *	self	self pointer
+ *	off	byte offset in the line
+ *	col	column of the offset
+ */
+void cols_mark(struct cols_t *self, long off, long col);
+
+/**
+ * scan a line a character at a time from a known column
+ * stops at to_off, before the character covering to_col or at the end of
+ * the line, whichever comes first
+ *
+ * params:
+ *	text	document
+ *	start	byte offset of the line
+ *	pos	byte offset in the line the scan starts at
+ *	col	column of pos
+ *	end	length of the line
+ *	to_off	byte offset in the line to stop at
+ *	to_col	column to stop at
+ *	index	index whose checkpoints are added on the way; NULL for none
+ *	res_off	where the byte offset in the line the scan stopped at is
+ *		given
+ *	res_col	where its column is given
+ */
+void cols_walk(struct text_t *text, long start, long pos, long col,
+	long end, long to_off, long to_col, struct cols_t *index, long *res_off,
+	long *res_col);
+
+/**
+ * decode the character at a byte offset; it may cross pieces
+ *
+ * params:
+ *	text	document
+ *	off	byte offset; 0 <= off < total
+ *	total	length of the document
+ *	cp	where the code point is given
+ *	returns	number of bytes of the character
+ */
+int cols_decode(struct text_t *text, long off, long total, int *cp);
+
+/**
+ * start of the code point before a byte offset
+ *
+ * params:
+ *	text	document
+ *	off	byte offset; 0 < off <= total
+ *	total	length of the document
+ *	res	where the offset is given
+ *	cp	where the code point is given
+ */
+void cols_back(struct text_t *text, long off, long total, long *res,
+	int *cp);
+
+/**
+ * is the byte at an offset a continuation byte of a character
+ *
+ * params:
+ *	text	document
+ *	off	byte offset; the end of the document is not
+ */
+int cols_is_cont(struct text_t *text, long off);
+
+// ========================================
+// cols.h - definition
+// ========================================
+
+int cols_init(struct cols_t *self)
+{
+	self->row = -1;
+	self->version = 0;
+	self->off = NULL;
+	self->col = NULL;
+	self->n = 0;
+	self->cap = 0;
+	self->done = 0;
+	self->done_col = 0;
+	self->shift = 0;
+	self->shift_off = 0;
+	self->shift_col = 0;
+	return NO_ERR;
+}
+
+int cols_free(struct cols_t *self)
+{
+	free(self->off);
+	free(self->col);
+	return cols_init(self);
+}
+
+int cols_col(struct cols_t *self, struct text_t *text, int row, long off,
+	long *res)
+{
+	// a byte is a column as long as every byte is ascii and no tab
+	int flags = 0;
+	text_flags(text, &flags);
+	if (!(flags & (SCAN_NONASCII | SCAN_TAB)))
+	{
+		*res = off;
+		return NO_ERR;
+	}
+
+	long start = 0;
+	int len = 0;
+	text_line_start(text, row, &start);
+	text_line_len(text, row, &len);
+	if (off > len)
+		off = len;
+	cols_sync(self, text, row);
+
+	// the line is indexed as far as the offset the first time it is needed
+	long at = 0, col = 0;
+	if (off > self->done)
+		cols_walk(text, start, self->done, self->done_col, len, off,
+			LONG_MAX, self, &at, &col);
+	cols_find(self, off, 0, &at, &col);
+	cols_walk(text, start, at, col, len, off, LONG_MAX, NULL, &at, res);
+	return NO_ERR;
+}
+
+int cols_off(struct cols_t *self, struct text_t *text, int row, long col,
+	long *off, long *at)
+{
+	long start = 0;
+	int len = 0;
+	text_line_start(text, row, &start);
+	text_line_len(text, row, &len);
+
+	int flags = 0;
+	text_flags(text, &flags);
+	if (!(flags & (SCAN_NONASCII | SCAN_TAB)))
+	{
+		*off = col < len ? col : len;
+		*at = *off;
+		return NO_ERR;
+	}
+	cols_sync(self, text, row);
+
+	long pos = 0, pos_col = 0;
+	if (col >= self->done_col && self->done < len)
+		cols_walk(text, start, self->done, self->done_col, len, len, col,
+			self, &pos, &pos_col);
+	cols_find(self, col, 1, &pos, &pos_col);
+	cols_walk(text, start, pos, pos_col, len, len, col, NULL, off, at);
+	return NO_ERR;
+}
+
+int cols_seek(struct text_t *text, int row, long col, long *off, long *at)
+{
+	long start = 0;
+	int len = 0;
+	text_line_start(text, row, &start);
+	text_line_len(text, row, &len);
+	cols_walk(text, start, 0, 0, len, len, col, NULL, off, at);
+	return NO_ERR;
+}
+
+int cols_insert(struct cols_t *self, struct text_t *text, long version,
+	int row, long off, long len, long width)
+{
+	// bytes that join the inserted ones into another character change
+	// more than the columns of the insertion
+	long start = 0;
+	if (self->row == row && self->version == version)
+		text_line_start(text, row, &start);
+	if (self->row != row || self->version != version ||
+		cols_is_cont(text, start + off + len))
+	{
+		self->row = -1;
+		return NO_ERR;
+	}
+	self->version = text->version;
+
+	// nothing past the indexed part moves
+	int k = cols_count(self, off - 1, 0);
+	if (off >= self->done)
+	{
+		self->n = k;
+		return NO_ERR;
+	}
+
+	// the tabs after the insertion may now reach other stops, so the
+	// columns past it don't all move by the same width
+	int flags = 0;
+	text_flags(text, &flags);
+	if (flags & SCAN_TAB)
+	{
+		cols_cut(self, k);
+		return NO_ERR;
+	}
+	cols_shift(self, k, len, width);
+	self->done += len;
+	self->done_col += width;
+
+	// a step grown too long is indexed again when it is needed
+	long from = 0, from_col = 0, to = self->done, to_col = 0;
+	if (k > 0)
+		cols_get(self, k - 1, &from, &from_col);
+	if (k < self->n)
+		cols_get(self, k, &to, &to_col);
+	if (to - from > 2 * COLS_STEP)
+		cols_cut(self, k);
+	return NO_ERR;
+}
+
+int cols_delete(struct cols_t *self, struct text_t *text, long version,
+	int row, long off, long len, long width)
+{
+	long start = 0;
+	if (self->row == row && self->version == version)
+		text_line_start(text, row, &start);
+	if (self->row != row || self->version != version ||
+		cols_is_cont(text, start + off))
+	{
+		self->row = -1;
+		return NO_ERR;
+	}
+	self->version = text->version;
+	if (off >= self->done)
+		return NO_ERR;
+
+	// the checkpoints inside the deleted bytes are dropped and the ones
+	// after them move back; past a tab they may not all move by the same
+	// width
+	int k = cols_count(self, off, 0);
+	int flags = 0;
+	text_flags(text, &flags);
+	if (self->done < off + len || (flags & SCAN_TAB))
+	{
+		cols_cut(self, k);
+		return NO_ERR;
+	}
+	int m = cols_count(self, off + len - 1, 0);
+	if (m > k)
+	{
+		cols_shift(self, self->n, 0, 0);
+		memmove(self->off + k, self->off + m,
+			(self->n - m) * sizeof(long));
+		memmove(self->col + k, self->col + m,
+			(self->n - m) * sizeof(long));
+		self->n -= m - k;
+	}
+	cols_shift(self, k, -len, -width);
+	self->done -= len;
+	self->done_col -= width;
+	return NO_ERR;
+}
+
+int cols_char(struct text_t *text, long off, long col, long *next,
+	int *width)
+{
+	long total = 0;
+	text_len(text, &total);
+	*next = off;
+	*width = 1;
+	if (off >= total)
+		return NO_ERR;
+
+	int cp = 0;
+	*next = off + cols_decode(text, off, total, &cp);
+	*width = cp == '\t' ? COLS_TAB - col % COLS_TAB : utf8_width(cp);
+	while (cp != '\n' && *next < total)
+	{
+		int len = cols_decode(text, *next, total, &cp);
+		if (utf8_width(cp) != 0)
+			break;
+		*next += len;
+	}
+	return NO_ERR;
+}
+
+int cols_prev(struct text_t *text, long off, long *res)
+{
+	long total = 0;
+	text_len(text, &total);
+
+	// marks are stepped over back to the character they are drawn on; a
+	// mark at the start of a line is a character of its own
+	int cp = 0;
+	cols_back(text, off, total, res, &cp);
+	while (*res > 0 && utf8_width(cp) == 0)
+	{
+		char ch = 0;
+		text_at(text, *res - 1, &ch);
+		if (ch == '\n')
+			break;
+		cols_back(text, *res, total, res, &cp);
+	}
+	return NO_ERR;
+}
+
+int cols_snap(struct text_t *text, long off, long *res)
+{
+	long total = 0;
+	text_len(text, &total);
+	*res = off;
+	if (off >= total)
+		return NO_ERR;
+
+	// back to a byte starting a character that reaches the offset
+	long pos = off;
+	while (pos > 0 && off - pos < UTF8_MAX - 1 && cols_is_cont(text, pos))
+		pos--;
+	int cp = 0;
+	if (pos + cols_decode(text, pos, total, &cp) > off)
+		*res = pos;
+	else
+		cols_decode(text, off, total, &cp);
+
+	// a mark belongs to the character before it
+	if (utf8_width(cp) == 0 && *res > 0)
+	{
+		char ch = 0;
+		text_at(text, *res - 1, &ch);
+		if (ch != '\n')
+			cols_prev(text, *res, res);
+	}
+	return NO_ERR;
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+void cols_sync(struct cols_t *self, struct text_t *text, int row)
+{
+	if (self->row == row && self->version == text->version)
+		return;
+	self->row = row;
+	self->version = text->version;
+	self->n = 0;
+	self->done = 0;
+	self->done_col = 0;
+	self->shift = 0;
+	self->shift_off = 0;
+	self->shift_col = 0;
+}
+
+void cols_get(struct cols_t *self, int i, long *off, long *col)
+{
+	*off = self->off[i];
+	*col = self->col[i];
+	if (i >= self->shift)
+	{
+		*off += self->shift_off;
+		*col += self->shift_col;
+	}
+}
+
+void cols_shift(struct cols_t *self, int k, long len, long width)
+{
+	// a shift of other checkpoints is written out first
+	if (k != self->shift && (self->shift_off || self->shift_col))
+	{
+		for (int i = self->shift; i < self->n; i++)
+		{
+			self->off[i] += self->shift_off;
+			self->col[i] += self->shift_col;
+		}
+		self->shift_off = 0;
+		self->shift_col = 0;
+	}
+	self->shift = k;
+	self->shift_off += len;
+	self->shift_col += width;
+}
+
+void cols_cut(struct cols_t *self, int k)
+{
+	self->n = k;
+	self->done = 0;
+	self->done_col = 0;
+	if (k > 0)
+		cols_get(self, k - 1, &self->done, &self->done_col);
+}
+
+int cols_count(struct cols_t *self, long key, int by_col)
+{
+	int lo = 0, hi = self->n;
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		long off = 0, col = 0;
+		cols_get(self, mid, &off, &col);
+		if ((by_col ? col : off) <= key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+void cols_find(struct cols_t *self, long key, int by_col, long *off,
+	long *col)
+{
+	int k = cols_count(self, key, by_col);
+	*off = 0;
+	*col = 0;
+	if (k > 0)
+		cols_get(self, k - 1, off, col);
+}
+
+void cols_mark(struct cols_t *self, long off, long col)
+{
+	if (self->n == self->cap)
+	{
+		int cap = self->cap ? self->cap * 2 : 16;
+		long *offs = (long *) realloc(self->off, cap * sizeof(long));
+		if (offs == NULL)
+			return;
+		self->off = offs;
+		long *cols = (long *) realloc(self->col, cap * sizeof(long));
+		if (cols == NULL)
+			return;
+		self->col = cols;
+		self->cap = cap;
+	}
+	// stored as if the pending shift applied to it
+	if (self->n >= self->shift)
+	{
+		off -= self->shift_off;
+		col -= self->shift_col;
+	}
+	self->off[self->n] = off;
+	self->col[self->n] = col;
+	self->n++;
+}
+
+void cols_walk(struct text_t *text, long start, long pos, long col,
+	long end, long to_off, long to_col, struct cols_t *index, long *res_off,
+	long *res_col)
+{
+	if (to_off > end)
+		to_off = end;
+	long next = 0, next_col = 0;
+	if (index && index->n > 0)
+		cols_get(index, index->n - 1, &next, &next_col);
+	next += COLS_STEP;
+
+	struct text_iter_t it;
+	text_iter_at(text, start + pos, &it);
+	int stop = 0;
+	while (pos < to_off && !stop)
+	{
+		const char *ptr = NULL;
+		long n = 0;
+		if (text_iter_span(&it, &ptr, &n) || n <= 0)
+			break;
+		if (n > to_off - pos)
+			n = to_off - pos;
+
+		long i = 0;
+		while (i < n)
+		{
+			// ascii is a column a byte but a tab reaches the next stop
+			unsigned char ch = ptr[i];
+			int len = 1, width = 1;
+			if (ch == '\t')
+				width = COLS_TAB - col % COLS_TAB;
+			else if (ch >= 0x80)
+			{
+				// a character crossing pieces is copied out first
+				char tmp[UTF8_MAX];
+				const char *src = ptr + i;
+				long avail = n - i;
+				if (utf8_len(ch) > avail && pos + i + avail < end)
+				{
+					avail = end - pos - i;
+					if (avail > UTF8_MAX)
+						avail = UTF8_MAX;
+					for (long j = 0; j < avail; j++)
+						text_at(text, start + pos + i + j, tmp + j);
+					src = tmp;
+				}
+				int cp = 0;
+				len = utf8_decode(src, avail, &cp);
+				width = utf8_width(cp);
+			}
+			if (width > 0 && col + width > to_col)
+			{
+				stop = 1;
+				break;
+			}
+			if (index && pos + i >= next)
+			{
+				cols_mark(index, pos + i, col);
+				next = pos + i + COLS_STEP;
+			}
+			i += len;
+			col += width;
+		}
+
+		// the last character may have ended in a later piece
+		text_iter_advance(&it, i);
+		pos += i;
+	}
+
+	if (index && pos > index->done)
+	{
+		index->done = pos;
+		index->done_col = col;
+	}
+	*res_off = pos;
+	*res_col = col;
+}
+
+int cols_decode(struct text_t *text, long off, long total, int *cp)
+{
+	const char *ptr = NULL;
+	long len = 0;
+	text_span(text, off, &ptr, &len);
+	if (utf8_len(*ptr) <= len || off + len == total)
+		return utf8_decode(ptr, len, cp);
+
+	char tmp[UTF8_MAX];
+	long n = total - off < UTF8_MAX ? total - off : UTF8_MAX;
+	for (long i = 0; i < n; i++)
+		text_at(text, off + i, tmp + i);
+	return utf8_decode(tmp, n, cp);
+}
+
+void cols_back(struct text_t *text, long off, long total, long *res,
+	int *cp)
+{
+	// back over the continuation bytes a character may have; they are
+	// bytes of their own unless a character starts before them and ends
+	// at the offset
+	long pos = off - 1;
+	while (pos > 0 && off - pos < UTF8_MAX && cols_is_cont(text, pos))
+		pos--;
+	if (pos + cols_decode(text, pos, total, cp) != off)
+	{
+		pos = off - 1;
+		cols_decode(text, pos, total, cp);
+	}
+	*res = pos;
+}
+
+int cols_is_cont(struct text_t *text, long off)
+{
+	long total = 0;
+	text_len(text, &total);
+	if (off < 0 || off >= total)
+		return 0;
+	char ch = 0;
+	text_at(text, off, &ch);
+	return (ch & 0xc0) == 0x80;
+}
@@ -0,0 +1,190 @@
+#ifndef COLS_H
+#define COLS_H
+
+#include "text.h"
+#include "util.h"
+
+// ========================================
+// display columns
+// ========================================
+
+/**
+ * number of bytes of a line between two checkpoints of the index
+ */
+#define COLS_STEP 256
+
+/**
+ * display columns between tab stops
+ */
+#define COLS_TAB 8
+
+/**
+ * index between the bytes and the display columns of one line
+ * a checkpoint is kept every COLS_STEP bytes, so any column is found by
+ * scanning at most a step from the nearest one; the line is indexed only
+ * as far as it has been asked about, and edits made in the line shift
+ * the checkpoints instead of dropping them; typing at one place keeps
+ * adding to one shift rather than moving every checkpoint after it;
+ * with tabs in the document the checkpoints after an edit are dropped
+ * instead, as the tab stops past it may take other widths
+ * plain ascii documents without tabs need no index; a byte is a column
+ *
+ * members:
+ *	row		line of the index; -1 if there is none
+ *	version		version of the text the index matches
+ *	off		byte offsets of the checkpoints in the line; the
+ *			first one is 0
+ *	col		columns of the checkpoints
+ *	n		number of checkpoints
+ *	cap		capacity of the checkpoints
+ *	done		bytes of the line indexed so far
+ *	done_col	column of done
+ *	shift		first checkpoint of a shift not yet written out
+ *	shift_off	bytes the checkpoints from shift on are further
+ *			than stored
+ *	shift_col	columns they are further than stored
+ */
+struct cols_t
+{
+	int row;
+	long version;
+
+	long *off;
+	long *col;
+	int n;
+	int cap;
+
+	long done;
+	long done_col;
+
+	int shift;
+	long shift_off;
+	long shift_col;
+};
+
+/**
+ * initialize an empty index
+ *
+ * params:
+ *	self	self pointer
+ */
+int cols_init(struct cols_t *self);
+
+/**
+ * free the index
+ *
+ * params:
+ *	self	self pointer
+ */
+int cols_free(struct cols_t *self);
+
+/**
+ * display column of a byte of a line
+ *
+ * params:
+ *	self	self pointer
+ *	text	document
+ *	row	line number; 0 <= row < lines
+ *	off	byte offset in the line; at the start of a character
+ *	res	where the column is given
+ */
+int cols_col(struct cols_t *self, struct text_t *text, int row, long off,
+	long *res);
+
+/**
+ * character of a line covering a display column
+ * a column past the end of the line gives the end of the line
+ *
+ * params:
+ *	self	self pointer
+ *	text	document
+ *	row	line number; 0 <= row < lines
+ *	col	display column
+ *	off	where the byte offset of the character in the line is given
+ *	at	where the column the character starts at is given
+ */
+int cols_off(struct cols_t *self, struct text_t *text, int row, long col,
+	long *off, long *at);
+
+/**
+ * cols_off without an index; scans the line from its start
+ *
+ * params:
+ *	text	document
+ *	row	line number; 0 <= row < lines
+ *	col	display column
+ *	off	where the byte offset of the character in the line is given
+ *	at	where the column the character starts at is given
+ */
+int cols_seek(struct text_t *text, int row, long col, long *off, long *at);
+
+/**
+ * keep the index after bytes were inserted into its line
+ * anything but the next change of the text after version drops the
+ * index instead
+ *
+ * params:
+ *	self	self pointer
+ *	text	document after the insertion
+ *	version	version of the text before the insertion
+ *	row	line of the insertion
+ *	off	byte offset of the insertion in the line
+ *	len	number of inserted bytes; no newlines
+ *	width	display columns of the inserted bytes
+ */
+int cols_insert(struct cols_t *self, struct text_t *text, long version,
+	int row, long off, long len, long width);
+
+/**
+ * keep the index after bytes were deleted from its line
+ * anything but the next change of the text after version drops the
+ * index instead
+ *
+ * params:
+ *	self	self pointer
+ *	text	document after the deletion
+ *	version	version of the text before the deletion
+ *	row	line of the deletion
+ *	off	byte offset of the deletion in the line
+ *	len	number of deleted bytes; no newlines
+ *	width	display columns of the deleted bytes
+ */
+int cols_delete(struct cols_t *self, struct text_t *text, long version,
+	int row, long off, long len, long width);
+
+/**
+ * character at a byte offset with the zero width marks following it
+ *
+ * params:
+ *	text	document
+ *	off	byte offset; 0 <= off <= length
+ *	col	display column of the character; a tab reaches the next tab
+ *		stop from it
+ *	next	where the offset after the character is given
+ *	width	where its display columns are given; 1 at the end
+ */
+int cols_char(struct text_t *text, long off, long col, long *next,
+	int *width);
+
+/**
+ * start of the character before a byte offset; zero width marks go
+ * with the character they follow
+ *
+ * params:
+ *	text	document
+ *	off	byte offset; 0 < off <= length
+ *	res	where the offset is given
+ */
+int cols_prev(struct text_t *text, long off, long *res);
+
+/**
+ * start of the character a byte offset is in
+ *
+ * params:
+ *	text	document
+ *	off	byte offset; 0 <= off <= length
+ *	res	where the offset is given
+ */
+int cols_snap(struct text_t *text, long off, long *res);
+
+#endif // COLS_H
@@ -0,0 +1,250 @@
+#define _GNU_SOURCE
+#include <string.h>
+
+#include "input.h"
+#include "utf8.h"
+#include "util.h"
+#include "ve.h"
+
+// ========================================
+// helper declaration
+// ========================================
+
+/**
+ * decode the key at the start of the bytes
+ *
+ * params:
+ *	src	bytes to decode
+ *	len	number of bytes; at least 1
+ *	final	no more bytes are coming soon
+ *	key	where the key is given
+ *	used	where the number of bytes of the key is given; 0 if the key
+ *		is not complete yet
+ */
+void input_key(const char *src, int len, int final, int *key, int *used);
+
+/**
+ * append pasted text; the terminal sends '\r' for every newline
+ *
+ * params:
+ *	self	self pointer
+ *	src	pasted text
+ *	len	length of the text
+ */
+int input_paste(struct input_t *self, const char *src, long len);
+
+/**
+ * start and end of a bracketed paste
+ */
+static const char PASTE_START[] = "\x1b[200~";
+static const char PASTE_END[] = "\x1b[201~";
+
+// ========================================
+// input.h - definition
+// ========================================
+
+int input_init(struct input_t *self)
+{
+	str_init(&self->bytes);
+	str_init(&self->paste);
+	self->nkeys = 0;
+	return NO_ERR;
+}
+
+int input_free(struct input_t *self)
+{
+	str_free(&self->bytes);
+	str_free(&self->paste);
+	self->nkeys = 0;
+	return NO_ERR;
+}
+
+int input_feed(struct input_t *self, const char *src, int len)
+{
+	return str_appends(&self->bytes, src, len);
+}
+
+int input_decode(struct input_t *self, int final)
+{
+	// the pending bytes are contiguous once the gap is at the end
+	const char *src = str_cstr(&self->bytes);
+	int len = self->bytes.len;
+
+	int pos = 0;
+	while (pos < len && self->nkeys < INPUT_QUEUE)
+	{
+		int key = 0, used = 0;
+		int start_len = sizeof(PASTE_START) - 1;
+		int end_len = sizeof(PASTE_END) - 1;
+		if (len - pos >= start_len &&
+			memcmp(src + pos, PASTE_START, start_len) == 0)
+		{
+			// the whole block is needed before it can be inserted
+			const char *body = src + pos + start_len;
+			const char *end = memmem(body, src + len - body, PASTE_END,
+				end_len);
+			if (end == NULL)
+				break;
+
+			struct input_key_t *k = self->keys + self->nkeys;
+			k->key = PASTE_KEY;
+			k->off = self->paste.len;
+			int err = input_paste(self, body, end - body);
+			if (err)
+				return err;
+			k->len = self->paste.len - k->off;
+			self->nkeys++;
+			pos = end + end_len - src;
+			continue;
+		}
+
+		input_key(src + pos, len - pos, final, &key, &used);
+		if (used == 0)
+			break;
+		pos += used;
+
+		// unknown sequences decode to no key
+		if (key == 0)
+			continue;
+		self->keys[self->nkeys].key = key;
+		self->keys[self->nkeys].off = 0;
+		self->keys[self->nkeys].len = 0;
+		self->nkeys++;
+	}
+
+	// drop the decoded bytes from the front
+	str_gap_move(&self->bytes, 0);
+	return str_gap_delete(&self->bytes, 0, pos);
+}
+
+int input_clear(struct input_t *self)
+{
+	self->nkeys = 0;
+	return str_clear(&self->paste);
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+void input_key(const char *src, int len, int final, int *key, int *used)
+{
+	unsigned char ch = src[0];
+	*key = 0;
+	*used = 1;
+
+	// a character of several bytes is one key once all of them are here
+	int n = utf8_len(ch);
+	if (n > 1)
+	{
+		int i = 1;
+		while (i < n && i < len && (src[i] & 0xc0) == 0x80)
+			i++;
+		if (i < n && i == len && !final)
+		{
+			*used = 0;
+			return;
+		}
+		int cp = 0;
+		*used = utf8_decode(src, i, &cp);
+		if (cp >= 0)
+			*key = UTF8_KEY + cp;
+		return;
+	}
+	if (n == 0)
+		return;
+
+	if (ch != '\x1b')
+	{
+		if (ch == '\r')
+			*key = ENTER_KEY;
+		else if (ch == '\t')
+			*key = TAB_KEY;
+		else if (ch == 127)
+			*key = BACKSPACE_KEY;
+		else
+			*key = ch;
+		return;
+	}
+
+	// a lone escape may be the start of a sequence
+	if (len == 1)
+	{
+		if (final)
+			*key = ESC_KEY;
+		else
+			*used = 0;
+		return;
+	}
+
+	// alt + q
+	if (src[1] == 'q')
+	{
+		*key = QUIT_KEY;
+		*used = 2;
+		return;
+	}
+
+	// anything but a control sequence makes the escape a key of its own
+	if (src[1] != '[' && src[1] != 'O')
+	{
+		*key = ESC_KEY;
+		return;
+	}
+
+	// parameters are followed by a final byte in 0x40-0x7e
+	int end = 2;
+	while (end < len && !(0x40 <= src[end] && src[end] <= 0x7e))
+		end++;
+	if (end == len)
+	{
+		if (final)
+			*key = ESC_KEY;
+		else
+			*used = 0;
+		return;
+	}
+	*used = end + 1;
+
+	if (end == 2)
+	{
+		switch(src[2])
+		{
+		case 'A':
+			*key = UP_KEY;
+			break;
+		case 'B':
+			*key = DOWN_KEY;
+			break;
+		case 'C':
+			*key = RIGHT_KEY;
+			break;
+		case 'D':
+			*key = LEFT_KEY;
+			break;
+		}
+	}
+	else if (end == 3 && src[2] == '3' && src[3] == '~')
+		*key = DELETE_KEY;
+}
+
+int input_paste(struct input_t *self, const char *src, long len)
+{
+	long run = 0;
+	for (long i = 0; i < len; i++)
+	{
+		if (src[i] != '\r')
+			continue;
+
+		// "\r\n" and a lone '\r' both become '\n'
+		int err = str_appends(&self->paste, src + run, i - run);
+		if (!err)
+			err = str_appendc(&self->paste, '\n');
+		if (err)
+			return err;
+		if (i + 1 < len && src[i + 1] == '\n')
+			i++;
+		run = i + 1;
+	}
+	return str_appends(&self->paste, src + run, len - run);
+}
@@ -0,0 +1,98 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "util.h"
+
+// ========================================
+// input decoder
+// ========================================
+
+/**
+ * maximum number of keys decoded in one batch
+ */
+#define INPUT_QUEUE 256
+
+/**
+ * milliseconds to wait for the rest of an escape sequence before a lone
+ * escape is taken as the escape key
+ */
+#define INPUT_WAIT_MS 25
+
+/**
+ * decoded key
+ *
+ * members:
+ *	key	*_KEY value, printable ascii or a control character
+ *	off	PASTE_KEY only; offset of the pasted text in paste
+ *	len	PASTE_KEY only; length of the pasted text
+ */
+struct input_key_t
+{
+	int key;
+	long off;
+	long len;
+};
+
+/**
+ * streaming decoder turning terminal bytes into keys
+ *
+ * members:
+ *	bytes	bytes that are not decoded yet
+ *	keys	decoded keys
+ *	nkeys	number of decoded keys
+ *	paste	text of every pasted block in keys
+ */
+struct input_t
+{
+	struct str_t bytes;
+	struct input_key_t keys[INPUT_QUEUE];
+	int nkeys;
+	struct str_t paste;
+};
+
+/**
+ * initialize an empty decoder
+ *
+ * params:
+ *	self	self pointer
+ */
+int input_init(struct input_t *self);
+
+/**
+ * free the decoder
+ *
+ * params:
+ *	self	self pointer
+ */
+int input_free(struct input_t *self);
+
+/**
+ * add bytes read from the terminal
+ *
+ * params:
+ *	self	self pointer
+ *	src	bytes that were read
+ *	len	number of bytes
+ */
+int input_feed(struct input_t *self, const char *src, int len);
+
+/**
+ * decode as many pending bytes as possible into keys
+ * an unfinished escape sequence is kept for the next call unless final
+ * is set; an unfinished paste is always kept
+ *
+ * params:
+ *	self	self pointer
+ *	final	no more bytes are coming soon
+ */
+int input_decode(struct input_t *self, int final);
+
+/**
+ * forget the decoded keys and their pasted text
+ *
+ * params:
+ *	self	self pointer
+ */
+int input_clear(struct input_t *self);
+
+#endif // INPUT_H
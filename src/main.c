@@ -1,7 +1,9 @@
+#include <stddef.h>
+
 #include "term.h"
 
-int main()
+int main(int argc, char **argv)
 {
-	term_run();
+	term_run(argc > 1 ? argv[1] : NULL);
 	return 0;
 }
@@ -0,0 +1,187 @@
+#include <stddef.h>
+
+#include "motion.h"
+#include "text.h"
+#include "util.h"
+
+// ========================================
+// helper declaration
+// ========================================
+
+/**
+ * move forward to the start (w) or the end (e) of a word
+ *
+ * params:
+ *	text	text to move in
+ *	off	byte offset of the cursor
+ *	cls	class table
+ *	end	stop at the ends of the words instead of their starts
+ *	count	number of words
+ *	res	where the new offset is given
+ */
+int motion_forward(struct text_t *text, long off, const unsigned char *cls,
+	int end, long count, long *res);
+
+/**
+ * move backward to the start of a word
+ *
+ * params:
+ *	text	text to move in
+ *	off	byte offset of the cursor
+ *	cls	class table
+ *	count	number of words
+ *	res	where the new offset is given
+ */
+int motion_backward(struct text_t *text, long off, const unsigned char *cls,
+	long count, long *res);
+
+/**
+ * class of every byte for words; bytes of utf-8 sequences are letters
+ */
+static const unsigned char MOTION_CLASS[256] = {
+	[0 ... 255] = MOTION_PUNCT,
+	['\t' ... '\r'] = MOTION_BLANK,
+	[' '] = MOTION_BLANK,
+	['0' ... '9'] = MOTION_WORD,
+	['A' ... 'Z'] = MOTION_WORD,
+	['a' ... 'z'] = MOTION_WORD,
+	['_'] = MOTION_WORD,
+	[0x80 ... 0xff] = MOTION_WORD,
+};
+
+/**
+ * class of every byte for WORDs
+ */
+static const unsigned char MOTION_BIG_CLASS[256] = {
+	[0 ... 255] = MOTION_WORD,
+	['\t' ... '\r'] = MOTION_BLANK,
+	[' '] = MOTION_BLANK,
+};
+
+// ========================================
+// motion.h - definition
+// ========================================
+
+int motion_word(struct text_t *text, long off, int motion, long count,
+	long *res)
+{
+	*res = off;
+	if (count < 1)
+		count = 1;
+	if (count > MOTION_MAX_COUNT)
+		count = MOTION_MAX_COUNT;
+
+	const unsigned char *cls = MOTION_CLASS;
+	if (motion == 'W' || motion == 'B' || motion == 'E')
+		cls = MOTION_BIG_CLASS;
+
+	switch (motion)
+	{
+	case 'w':
+	case 'W':
+		return motion_forward(text, off, cls, 0, count, res);
+	case 'e':
+	case 'E':
+		return motion_forward(text, off, cls, 1, count, res);
+	case 'b':
+	case 'B':
+		return motion_backward(text, off, cls, count, res);
+	}
+	return RANGE_ERR;
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+int motion_forward(struct text_t *text, long off, const unsigned char *cls,
+	int end, long count, long *res)
+{
+	long total = 0;
+	text_len(text, &total);
+	if (off >= total)
+		return NO_ERR;
+
+	// past the last word w goes to the end and e to the last byte
+	*res = end ? total - 1 : total;
+
+	struct text_iter_t it;
+	int err = text_iter_at(text, off, &it);
+	if (err)
+		return err;
+
+	// every byte after off is checked against the one before it
+	unsigned char prev = 0;
+	long pos = off;
+	const char *ptr = NULL;
+	long len = 0;
+	for (; text_iter_span(&it, &ptr, &len) == NO_ERR;
+		text_iter_advance(&it, len))
+	{
+		const unsigned char *src = (const unsigned char *) ptr;
+		long i = 0;
+		if (pos == off)
+			prev = src[i++];
+		for (; i < len; i++)
+		{
+			unsigned char c = src[i];
+			int hit = end ?
+				cls[prev] && cls[c] != cls[prev] && pos + i - 1 > off :
+				(cls[c] && cls[c] != cls[prev]) ||
+				(c == '\n' && prev == '\n');
+			if (hit && --count == 0)
+			{
+				*res = pos + i - end;
+				return NO_ERR;
+			}
+			prev = c;
+		}
+		pos += len;
+	}
+	return NO_ERR;
+}
+
+int motion_backward(struct text_t *text, long off, const unsigned char *cls,
+	long count, long *res)
+{
+	long total = 0;
+	text_len(text, &total);
+	if (off > total)
+		off = total;
+	*res = 0;
+	if (off == 0)
+		return NO_ERR;
+
+	struct text_iter_t it;
+	int err = text_iter_at(text, off, &it);
+	if (err)
+		return err;
+
+	// the byte at pos is checked once the one before it is known
+	long pos = off;
+	int have = 0;
+	unsigned char cur = 0;
+	const char *ptr = NULL;
+	long len = 0;
+	for (; text_iter_span_back(&it, &ptr, &len) == NO_ERR;
+		text_iter_retreat(&it, len))
+	{
+		const unsigned char *src = (const unsigned char *) ptr;
+		for (long i = len - 1; i >= 0; i--)
+		{
+			unsigned char c = src[i];
+			if (have && ((cls[cur] && cls[cur] != cls[c]) ||
+				(cur == '\n' && c == '\n')) && --count == 0)
+			{
+				*res = pos;
+				return NO_ERR;
+			}
+			cur = c;
+			have = 1;
+			pos--;
+		}
+	}
+
+	// the start of the document is always a word start
+	return NO_ERR;
+}
@@ -0,0 +1,47 @@
+#ifndef MOTION_H
+#define MOTION_H
+
+#include "text.h"
+#include "util.h"
+
+// ========================================
+// word motions
+// ========================================
+
+/**
+ * classes of the bytes; a word is a run of bytes of the same class
+ */
+enum
+{
+	MOTION_BLANK = 0,
+	MOTION_WORD,
+	MOTION_PUNCT,
+};
+
+/**
+ * largest count a motion takes
+ */
+#define MOTION_MAX_COUNT 999999999L
+
+/**
+ * offset reached by a word motion repeated count times
+ * the bytes are classified with a lookup table while the pieces are
+ * scanned in place
+ *
+ * motions:
+ *	w W	start of the next word; an empty line is a word too
+ *	b B	start of the previous word; an empty line is a word too
+ *	e E	end of the next word
+ * the uppercase motions take any run of non-blank bytes as one word
+ *
+ * params:
+ *	text	text to move in
+ *	off	byte offset of the cursor
+ *	motion	one of w b e W B E
+ *	count	number of times the motion is repeated; at least 1
+ *	res	where the new offset is given
+ */
+int motion_word(struct text_t *text, long off, int motion, long count,
+	long *res);
+
+#endif // MOTION_H
@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+#include "util.h"
+
+/**
+ * alignment of the objects and of the start of the objects in a chunk
+ */
+#define POOL_ALIGN 16
+
+// ========================================
+// pool.h - definition
+// ========================================
+
+int pool_init(struct pool_t *self, long size, int count)
+{
+	// an object must hold the link of the free list
+	if (size < (long) sizeof(void *))
+		size = sizeof(void *);
+	self->size = (size + POOL_ALIGN - 1) / POOL_ALIGN * POOL_ALIGN;
+	self->count = count > 0 ? count : 1;
+	self->chunks = NULL;
+	self->used = self->count;
+	self->free = NULL;
+	return NO_ERR;
+}
+
+int pool_free(struct pool_t *self)
+{
+	while (self->chunks)
+	{
+		void *next = *(void **) self->chunks;
+		free(self->chunks);
+		self->chunks = next;
+	}
+	self->used = self->count;
+	self->free = NULL;
+	return NO_ERR;
+}
+
+int pool_get(struct pool_t *self, void **res)
+{
+	char *ptr = NULL;
+	if (self->free)
+	{
+		ptr = (char *) self->free;
+		self->free = *(void **) ptr;
+	}
+	else
+	{
+		if (self->used == self->count)
+		{
+			char *chunk = (char *) malloc(POOL_ALIGN +
+				self->count * self->size);
+			if (chunk == NULL)
+				return MALLOC_ERR;
+			*(void **) chunk = self->chunks;
+			self->chunks = chunk;
+			self->used = 0;
+		}
+		ptr = (char *) self->chunks + POOL_ALIGN + self->used * self->size;
+		self->used++;
+	}
+	memset(ptr, 0, self->size);
+	*res = ptr;
+	return NO_ERR;
+}
+
+void pool_put(struct pool_t *self, void *ptr)
+{
+	if (ptr == NULL)
+		return;
+	*(void **) ptr = self->free;
+	self->free = ptr;
+}
@@ -0,0 +1,69 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "util.h"
+
+// ========================================
+// object pool
+// ========================================
+
+/**
+ * allocator of objects of one size
+ * objects are handed out in order from chunks holding many of them, so
+ * objects allocated one after another sit next to each other; freed
+ * objects are handed out again first, and the whole pool is freed one
+ * chunk at a time without visiting the objects
+ *
+ * members:
+ *	size	size of an object; rounded up to keep them aligned
+ *	count	number of objects in a chunk
+ *	chunks	chunks; linked through their first word
+ *	used	number of objects handed out of the newest chunk
+ *	free	freed objects; linked through their first word
+ */
+struct pool_t
+{
+	long size;
+	int count;
+	void *chunks;
+	int used;
+	void *free;
+};
+
+/**
+ * initialize an empty pool
+ *
+ * params:
+ *	self	self pointer
+ *	size	size of an object
+ *	count	number of objects in a chunk
+ */
+int pool_init(struct pool_t *self, long size, int count);
+
+/**
+ * free every chunk; the objects handed out are gone with them
+ *
+ * params:
+ *	self	self pointer
+ */
+int pool_free(struct pool_t *self);
+
+/**
+ * allocate a zeroed object
+ *
+ * params:
+ *	self	self pointer
+ *	res	where the object is given
+ */
+int pool_get(struct pool_t *self, void **res);
+
+/**
+ * give an object back to be handed out again
+ *
+ * params:
+ *	self	self pointer
+ *	ptr	object from pool_get
+ */
+void pool_put(struct pool_t *self, void *ptr);
+
+#endif // POOL_H
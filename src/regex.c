@@ -0,0 +1,1083 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "regex.h"
+#include "util.h"
+
+// ========================================
+// helper declaration
+// ========================================
+
+/**
+ * kinds of syntax tree nodes
+ */
+enum
+{
+	RE_SET = 0,
+	RE_CAT,
+	RE_ALT,
+	RE_STAR,
+	RE_PLUS,
+	RE_QUEST,
+	RE_EMPTY,
+};
+
+/**
+ * kinds of nfa states
+ */
+enum
+{
+	RE_N_SET = 0,
+	RE_N_SPLIT,
+	RE_N_EPS,
+	RE_N_ACCEPT,
+};
+
+/**
+ * node of the syntax tree
+ *
+ * members:
+ *	type	RE_* kind of the node
+ *	a	first child
+ *	b	second child; concatenation and alternation only
+ *	set	bytes matched by the node; sets only
+ */
+struct re_node_t
+{
+	int type;
+	int a;
+	int b;
+	struct re_set_t set;
+};
+
+/**
+ * state of the parser
+ *
+ * members:
+ *	pat	pattern
+ *	len	length of the pattern
+ *	pos	current position in the pattern
+ *	depth	nesting of groups
+ *	nodes	nodes of the syntax tree
+ *	n	number of nodes
+ *	cap	capacity of nodes
+ */
+struct re_parser_t
+{
+	const char *pat;
+	long len;
+	long pos;
+	int depth;
+	struct re_node_t *nodes;
+	int n;
+	int cap;
+};
+
+/**
+ * fragment of an nfa; end is an epsilon state whose out is not set yet
+ */
+struct re_frag_t
+{
+	int start;
+	int end;
+};
+
+/**
+ * add a node to the syntax tree
+ * gives the index of the node or -1 if there is no memory
+ *
+ * params:
+ *	p	parser
+ *	type	kind of the node
+ *	a	first child
+ *	b	second child
+ */
+int re_node(struct re_parser_t *p, int type, int a, int b);
+
+/**
+ * parse an alternation: cat ('|' cat)*
+ * gives the index of the node, -1 if there is no memory and -2 if the
+ * pattern is not valid
+ *
+ * params:
+ *	p	parser
+ */
+int re_parse_alt(struct re_parser_t *p);
+
+/**
+ * parse a concatenation of repetitions
+ *
+ * params:
+ *	p	parser
+ */
+int re_parse_cat(struct re_parser_t *p);
+
+/**
+ * parse an atom followed by any number of * + ?
+ *
+ * params:
+ *	p	parser
+ */
+int re_parse_repeat(struct re_parser_t *p);
+
+/**
+ * parse a group, a class, an escape or a single character
+ *
+ * params:
+ *	p	parser
+ */
+int re_parse_atom(struct re_parser_t *p);
+
+/**
+ * parse a bracket expression; the '[' is already consumed
+ *
+ * params:
+ *	p	parser
+ *	set	where the bytes of the class are given
+ */
+int re_parse_class(struct re_parser_t *p, struct re_set_t *set);
+
+/**
+ * bytes of the escape \c; gives 0 for an escape that is not a class
+ *
+ * params:
+ *	c	escaped character
+ *	set	where the bytes are given
+ */
+int re_escape(char c, struct re_set_t *set);
+
+/**
+ * add a byte or every byte of a range to a set
+ *
+ * params:
+ *	set	set of bytes
+ *	lo	first byte
+ *	hi	last byte
+ */
+void re_set_add(struct re_set_t *set, int lo, int hi);
+
+/**
+ * is the byte in the set
+ *
+ * params:
+ *	set	set of bytes
+ *	c	byte
+ */
+int re_set_has(const struct re_set_t *set, unsigned char c);
+
+/**
+ * append the literal bytes of a tree made of single characters
+ * gives 0 if the tree is not such a literal
+ *
+ * params:
+ *	nodes	nodes of the syntax tree
+ *	node	root of the tree
+ *	dest	where the bytes are appended
+ */
+int re_literal(struct re_node_t *nodes, int node, struct str_t *dest);
+
+/**
+ * add a state to an nfa; gives its index or -1 if there is no memory
+ *
+ * params:
+ *	nfa	automaton
+ *	type	RE_N_* kind of the state
+ *	out	next state
+ *	out1	second next state
+ */
+int re_nfa_add(struct re_nfa_t *nfa, int type, int out, int out1);
+
+/**
+ * build the nfa of a syntax tree with thompson's construction
+ * the concatenations are reversed if reverse is set
+ *
+ * params:
+ *	nfa	automaton
+ *	nodes	nodes of the syntax tree
+ *	node	root of the tree
+ *	reverse	build the automaton of the reversed language
+ *	frag	where the fragment is given
+ */
+int re_nfa_build(struct re_nfa_t *nfa, struct re_node_t *nodes, int node,
+	int reverse, struct re_frag_t *frag);
+
+/**
+ * build a complete nfa; with any set the match may start anywhere
+ *
+ * params:
+ *	nfa	automaton
+ *	nodes	nodes of the syntax tree
+ *	root	root of the tree
+ *	reverse	build the automaton of the reversed language
+ *	any	skip any number of bytes before the match
+ */
+int re_nfa_compile(struct re_nfa_t *nfa, struct re_node_t *nodes, int root,
+	int reverse, int any);
+
+/**
+ * empty a dfa and make it run an nfa; the memory it has is kept
+ *
+ * params:
+ *	self	self pointer; zeroed or used before
+ *	nfa	automaton the states are made of
+ */
+int re_dfa_reset(struct re_dfa_t *self, struct re_nfa_t *nfa);
+
+/**
+ * free the dfa
+ *
+ * params:
+ *	self	self pointer
+ */
+void re_dfa_free(struct re_dfa_t *self);
+
+/**
+ * forget every state but the dead one
+ *
+ * params:
+ *	self	self pointer
+ */
+void re_dfa_flush(struct re_dfa_t *self);
+
+/**
+ * epsilon closure of the nfa states in set; the closure replaces them
+ * sorted and without the states that neither consume nor accept
+ * gives the size of the closure
+ *
+ * params:
+ *	self	self pointer
+ *	n	number of states in set
+ *	accept	where it is given if the closure accepts
+ */
+int re_dfa_closure(struct re_dfa_t *self, int n, int *accept);
+
+/**
+ * find or add the state of the closure in set
+ * gives the index of the state or -1 if there is no memory
+ *
+ * params:
+ *	self	self pointer
+ *	n	size of the set
+ *	accept	does the set accept
+ */
+int re_dfa_state(struct re_dfa_t *self, int n, int accept);
+
+/**
+ * starting state of the dfa; -1 if there is no memory
+ *
+ * params:
+ *	self	self pointer
+ */
+int re_dfa_start(struct re_dfa_t *self);
+
+/**
+ * state after a byte; -1 if there is no memory
+ *
+ * params:
+ *	self	self pointer
+ *	from	current state
+ *	c	next byte
+ */
+int re_dfa_next(struct re_dfa_t *self, int from, unsigned char c);
+
+/**
+ * end of the longest match starting at an offset of the prepared line
+ *
+ * params:
+ *	self	self pointer
+ *	i	offset where a match starts
+ *	end	where the end of the match is given
+ */
+int re_end(struct regex_t *self, long i, long *end);
+
+/**
+ * size of the hash table of a dfa
+ */
+#define RE_HASH (RE_MAX_STATES * 2)
+
+// ========================================
+// regex.h - definition
+// ========================================
+
+int regex_init(struct regex_t *self)
+{
+	memset(self, 0, sizeof(*self));
+	return NO_ERR;
+}
+
+int regex_compile(struct regex_t *self, const char *pat, long len)
+{
+	self->bol = 0;
+	self->eol = 0;
+	self->lit_len = 0;
+	self->fwd.n = 0;
+	self->rev.n = 0;
+	self->line = NULL;
+	self->len = 0;
+
+	// anchors are only special at the ends of the pattern
+	if (len > 0 && pat[0] == '^')
+	{
+		self->bol = 1;
+		pat++;
+		len--;
+	}
+	if (len > 0 && pat[len - 1] == '$')
+	{
+		long slashes = 0;
+		while (slashes < len - 1 && pat[len - 2 - slashes] == '\\')
+			slashes++;
+		if (slashes % 2 == 0)
+		{
+			self->eol = 1;
+			len--;
+		}
+	}
+
+	// the tree is built in the nodes of the last pattern
+	struct re_parser_t p;
+	memset(&p, 0, sizeof(p));
+	p.pat = pat;
+	p.len = len;
+	p.nodes = self->nodes;
+	p.cap = self->nodes_cap;
+	int root = re_parse_alt(&p);
+	self->nodes = p.nodes;
+	self->nodes_cap = p.cap;
+	int err = NO_ERR;
+	if (root == -1)
+		err = MALLOC_ERR;
+	else if (root == -2 || p.pos != p.len)
+		err = RANGE_ERR;
+
+	// plain patterns can be searched without the automata
+	struct str_t lit;
+	str_init(&lit);
+	if (!err && !self->bol && !self->eol && len > 0 &&
+		re_literal(p.nodes, root, &lit))
+	{
+		if (self->lit_cap < lit.len + 1)
+		{
+			char *buffer = (char *) realloc(self->lit, lit.len + 1);
+			if (buffer == NULL)
+				err = MALLOC_ERR;
+			else
+			{
+				self->lit = buffer;
+				self->lit_cap = lit.len + 1;
+			}
+		}
+		if (!err)
+		{
+			memcpy(self->lit, str_cstr(&lit), lit.len + 1);
+			self->lit_len = lit.len;
+		}
+	}
+	str_free(&lit);
+
+	if (!err)
+		err = re_nfa_compile(&self->fwd, p.nodes, root, 0, 0);
+	if (!err)
+		err = re_nfa_compile(&self->rev, p.nodes, root, 1, !self->eol);
+	if (!err)
+		err = re_dfa_reset(&self->fdfa, &self->fwd);
+	if (!err)
+		err = re_dfa_reset(&self->rdfa, &self->rev);
+	if (err)
+		regex_free(self);
+	return err;
+}
+
+int regex_free(struct regex_t *self)
+{
+	re_dfa_free(&self->fdfa);
+	re_dfa_free(&self->rdfa);
+	free(self->fwd.states);
+	free(self->rev.states);
+	free(self->nodes);
+	free(self->lit);
+	free(self->starts);
+	free(self->trail);
+	memset(self, 0, sizeof(*self));
+	return NO_ERR;
+}
+
+int regex_line(struct regex_t *self, const char *line, long len)
+{
+	if (self->cap < len + 1)
+	{
+		char *starts = (char *) realloc(self->starts, len + 1);
+		if (starts == NULL)
+			return MALLOC_ERR;
+		self->starts = starts;
+		int *trail = (int *) realloc(self->trail, (len + 1) * sizeof(int));
+		if (trail == NULL)
+			return MALLOC_ERR;
+		self->trail = trail;
+		self->cap = len + 1;
+	}
+	self->line = line;
+	self->len = len;
+	self->trail_hi = -1;
+	memset(self->starts, 0, len + 1);
+
+	// the reversed automaton accepts at i when a match starts at i
+	// the states never move so they can be kept in a register
+	struct re_dfa_t *d = &self->rdfa;
+	struct re_dstate_t *states = d->states;
+	char *starts = self->starts;
+	int bol = self->bol;
+	int s = re_dfa_start(d);
+	for (long i = len; s > 0; i--)
+	{
+		struct re_dstate_t *cur = states + s;
+		if (cur->accept && (!bol || i == 0))
+			starts[i] = 1;
+		if (i == 0)
+			break;
+		unsigned char c = line[i - 1];
+		s = cur->next[c] >= 0 ? cur->next[c] : re_dfa_next(d, s, c);
+	}
+	return s < 0 ? MALLOC_ERR : NO_ERR;
+}
+
+int regex_next(struct regex_t *self, long from, long *start, long *end)
+{
+	*start = -1;
+	*end = -1;
+	if (from < 0 || from > self->len)
+		return NO_ERR;
+	const char *hit = (const char *) memchr(self->starts + from, 1,
+		self->len + 1 - from);
+	if (hit == NULL)
+		return NO_ERR;
+	*start = hit - self->starts;
+	return re_end(self, *start, end);
+}
+
+int regex_prev(struct regex_t *self, long to, long *start, long *end)
+{
+	*start = -1;
+	*end = -1;
+	if (to > self->len + 1)
+		to = self->len + 1;
+
+	// the starts are already known; only the last one is run forward
+	long i = to - 1;
+	while (i >= 0 && !self->starts[i])
+		i--;
+	if (i < 0)
+		return NO_ERR;
+	*start = i;
+	return re_end(self, i, end);
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+int re_end(struct regex_t *self, long i, long *end)
+{
+	struct re_dfa_t *d = &self->fdfa;
+	struct re_dstate_t *states = d->states;
+	const char *line = self->line;
+	long len = self->len;
+	int *trail = self->trail;
+	int flushes = d->flushes;
+
+	// the run before is only known after where it started
+	long hi = self->trail_hi;
+	if (i < self->trail_lo || self->trail_flushes != flushes)
+		hi = -1;
+
+	// run forward until the automaton dies
+	int s = re_dfa_start(d);
+	long last = -1, j = i;
+	if (s > 0 && states[s].accept && (!self->eol || i == len))
+		last = i;
+	while (s > 0 && j < len)
+	{
+		unsigned char c = line[j++];
+		int next = states[s].next[c];
+		s = next >= 0 ? next : re_dfa_next(d, s, c);
+		if (s < 0)
+			return MALLOC_ERR;
+		if (d->flushes != flushes)
+			hi = -1;
+		if (s > 0 && states[s].accept && (!self->eol || j == len))
+			last = j;
+
+		// in the state the run before was in here, the rest of this run
+		// is the rest of that one; the matches of a line are found in
+		// one pass this way instead of one pass per match
+		if (j <= hi && trail[j] == s)
+		{
+			if (self->trail_last > j)
+				last = self->trail_last;
+			self->trail_lo = i;
+			self->trail_last = last;
+			*end = last < 0 ? i : last;
+			return NO_ERR;
+		}
+		trail[j] = s;
+	}
+
+	self->trail_lo = i;
+	self->trail_hi = d->flushes == flushes ? j : -1;
+	self->trail_last = last;
+	self->trail_flushes = d->flushes;
+	*end = last < 0 ? i : last;
+	return NO_ERR;
+}
+
+int re_node(struct re_parser_t *p, int type, int a, int b)
+{
+	if (p->n == p->cap)
+	{
+		int cap = (p->cap + 1) * 2;
+		struct re_node_t *nodes = (struct re_node_t *) realloc(p->nodes,
+			cap * sizeof(struct re_node_t));
+		if (nodes == NULL)
+			return -1;
+		p->nodes = nodes;
+		p->cap = cap;
+	}
+	struct re_node_t *node = p->nodes + p->n;
+	memset(node, 0, sizeof(*node));
+	node->type = type;
+	node->a = a;
+	node->b = b;
+	return p->n++;
+}
+
+int re_parse_alt(struct re_parser_t *p)
+{
+	int left = re_parse_cat(p);
+	while (left >= 0 && p->pos < p->len && p->pat[p->pos] == '|')
+	{
+		p->pos++;
+		int right = re_parse_cat(p);
+		if (right < 0)
+			return right;
+		left = re_node(p, RE_ALT, left, right);
+	}
+	return left;
+}
+
+int re_parse_cat(struct re_parser_t *p)
+{
+	int left = -3;
+	while (p->pos < p->len && p->pat[p->pos] != '|' &&
+		p->pat[p->pos] != ')')
+	{
+		int right = re_parse_repeat(p);
+		if (right < 0)
+			return right;
+		left = left == -3 ? right : re_node(p, RE_CAT, left, right);
+		if (left < 0)
+			return left;
+	}
+	return left == -3 ? re_node(p, RE_EMPTY, 0, 0) : left;
+}
+
+int re_parse_repeat(struct re_parser_t *p)
+{
+	int node = re_parse_atom(p);
+	while (node >= 0 && p->pos < p->len)
+	{
+		char c = p->pat[p->pos];
+		int type = c == '*' ? RE_STAR : c == '+' ? RE_PLUS :
+			c == '?' ? RE_QUEST : -1;
+		if (type < 0)
+			break;
+		p->pos++;
+		node = re_node(p, type, node, 0);
+	}
+	return node;
+}
+
+int re_parse_atom(struct re_parser_t *p)
+{
+	char c = p->pat[p->pos++];
+	struct re_set_t set;
+	memset(&set, 0, sizeof(set));
+
+	switch (c)
+	{
+	case '(':
+	{
+		if (p->depth == RE_MAX_DEPTH)
+			return -2;
+		p->depth++;
+		int node = re_parse_alt(p);
+		p->depth--;
+		if (node < 0)
+			return node;
+		if (p->pos == p->len || p->pat[p->pos] != ')')
+			return -2;
+		p->pos++;
+		return node;
+	}
+	case '*':
+	case '+':
+	case '?':
+		// nothing to repeat
+		return -2;
+	case '.':
+		re_set_add(&set, 0, 255);
+		break;
+	case '[':
+		if (re_parse_class(p, &set))
+			return -2;
+		break;
+	case '\\':
+		if (p->pos == p->len)
+			return -2;
+		c = p->pat[p->pos++];
+		if (!re_escape(c, &set))
+			re_set_add(&set, (unsigned char) c, (unsigned char) c);
+		break;
+	default:
+		re_set_add(&set, (unsigned char) c, (unsigned char) c);
+		break;
+	}
+
+	int node = re_node(p, RE_SET, 0, 0);
+	if (node >= 0)
+		p->nodes[node].set = set;
+	return node;
+}
+
+int re_parse_class(struct re_parser_t *p, struct re_set_t *set)
+{
+	int negate = 0;
+	if (p->pos < p->len && p->pat[p->pos] == '^')
+	{
+		negate = 1;
+		p->pos++;
+	}
+
+	// a ']' right after the '[' is a member
+	int first = 1;
+	while (p->pos < p->len && (first || p->pat[p->pos] != ']'))
+	{
+		first = 0;
+		int lo = (unsigned char) p->pat[p->pos++];
+		if (lo == '\\' && p->pos < p->len)
+		{
+			char c = p->pat[p->pos++];
+			if (re_escape(c, set))
+				continue;
+			lo = (unsigned char) c;
+		}
+
+		int hi = lo;
+		if (p->pos + 1 < p->len && p->pat[p->pos] == '-' &&
+			p->pat[p->pos + 1] != ']')
+		{
+			hi = (unsigned char) p->pat[p->pos + 1];
+			p->pos += 2;
+			if (hi == '\\' && p->pos < p->len)
+				hi = (unsigned char) p->pat[p->pos++];
+			if (hi < lo)
+				return RANGE_ERR;
+		}
+		re_set_add(set, lo, hi);
+	}
+	if (p->pos == p->len)
+		return RANGE_ERR;
+	p->pos++;
+
+	if (negate)
+		for (int i = 0; i < 4; i++)
+			set->bits[i] = ~set->bits[i];
+	return NO_ERR;
+}
+
+int re_escape(char c, struct re_set_t *set)
+{
+	struct re_set_t s;
+	memset(&s, 0, sizeof(s));
+	switch (c)
+	{
+	case 'd':
+	case 'D':
+		re_set_add(&s, '0', '9');
+		break;
+	case 'w':
+	case 'W':
+		re_set_add(&s, '0', '9');
+		re_set_add(&s, 'a', 'z');
+		re_set_add(&s, 'A', 'Z');
+		re_set_add(&s, '_', '_');
+		break;
+	case 's':
+	case 'S':
+		re_set_add(&s, ' ', ' ');
+		re_set_add(&s, '\t', '\r');
+		break;
+	case 't':
+		re_set_add(&s, '\t', '\t');
+		break;
+	default:
+		return 0;
+	}
+
+	int negate = c == 'D' || c == 'W' || c == 'S';
+	for (int i = 0; i < 4; i++)
+		set->bits[i] |= negate ? ~s.bits[i] : s.bits[i];
+	return 1;
+}
+
+void re_set_add(struct re_set_t *set, int lo, int hi)
+{
+	for (int c = lo; c <= hi; c++)
+		set->bits[c >> 6] |= 1ULL << (c & 63);
+}
+
+int re_set_has(const struct re_set_t *set, unsigned char c)
+{
+	return (set->bits[c >> 6] >> (c & 63)) & 1;
+}
+
+int re_literal(struct re_node_t *nodes, int node, struct str_t *dest)
+{
+	struct re_node_t *n = nodes + node;
+	if (n->type == RE_CAT)
+		return re_literal(nodes, n->a, dest) &&
+			re_literal(nodes, n->b, dest);
+	if (n->type != RE_SET)
+		return 0;
+
+	int count = 0, byte = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		unsigned long long bits = n->set.bits[i];
+		count += __builtin_popcountll(bits);
+		if (bits)
+			byte = i * 64 + __builtin_ctzll(bits);
+	}
+	return count == 1 && str_appendc(dest, byte) == NO_ERR;
+}
+
+int re_nfa_add(struct re_nfa_t *nfa, int type, int out, int out1)
+{
+	if (nfa->n == nfa->cap)
+	{
+		int cap = (nfa->cap + 1) * 2;
+		struct re_nstate_t *states = (struct re_nstate_t *) realloc(
+			nfa->states, cap * sizeof(struct re_nstate_t));
+		if (states == NULL)
+			return -1;
+		nfa->states = states;
+		nfa->cap = cap;
+	}
+	struct re_nstate_t *s = nfa->states + nfa->n;
+	memset(s, 0, sizeof(*s));
+	s->type = type;
+	s->out = out;
+	s->out1 = out1;
+	return nfa->n++;
+}
+
+int re_nfa_build(struct re_nfa_t *nfa, struct re_node_t *nodes, int node,
+	int reverse, struct re_frag_t *frag)
+{
+	struct re_node_t n = nodes[node];
+	struct re_frag_t a, b;
+	int err = NO_ERR;
+
+	if (n.type == RE_SET || n.type == RE_EMPTY)
+	{
+		frag->end = re_nfa_add(nfa, RE_N_EPS, -1, -1);
+		if (frag->end < 0)
+			return MALLOC_ERR;
+		if (n.type == RE_EMPTY)
+		{
+			frag->start = frag->end;
+			return NO_ERR;
+		}
+		frag->start = re_nfa_add(nfa, RE_N_SET, frag->end, -1);
+		if (frag->start < 0)
+			return MALLOC_ERR;
+		nfa->states[frag->start].set = n.set;
+		return NO_ERR;
+	}
+
+	if (n.type == RE_CAT)
+	{
+		int first = reverse ? n.b : n.a;
+		int second = reverse ? n.a : n.b;
+		err = re_nfa_build(nfa, nodes, first, reverse, &a);
+		if (!err)
+			err = re_nfa_build(nfa, nodes, second, reverse, &b);
+		if (err)
+			return err;
+		nfa->states[a.end].out = b.start;
+		frag->start = a.start;
+		frag->end = b.end;
+		return NO_ERR;
+	}
+
+	err = re_nfa_build(nfa, nodes, n.a, reverse, &a);
+	if (!err && n.type == RE_ALT)
+		err = re_nfa_build(nfa, nodes, n.b, reverse, &b);
+	if (err)
+		return err;
+	int end = re_nfa_add(nfa, RE_N_EPS, -1, -1);
+	if (end < 0)
+		return MALLOC_ERR;
+	int split = re_nfa_add(nfa, RE_N_SPLIT, a.start,
+		n.type == RE_ALT ? b.start : end);
+	if (split < 0)
+		return MALLOC_ERR;
+
+	switch (n.type)
+	{
+	case RE_ALT:
+		nfa->states[a.end].out = end;
+		nfa->states[b.end].out = end;
+		frag->start = split;
+		break;
+	case RE_STAR:
+		nfa->states[a.end].out = split;
+		frag->start = split;
+		break;
+	case RE_PLUS:
+		nfa->states[a.end].out = split;
+		frag->start = a.start;
+		break;
+	case RE_QUEST:
+		nfa->states[a.end].out = end;
+		frag->start = split;
+		break;
+	}
+	frag->end = end;
+	return NO_ERR;
+}
+
+int re_nfa_compile(struct re_nfa_t *nfa, struct re_node_t *nodes, int root,
+	int reverse, int any)
+{
+	struct re_frag_t frag;
+	int err = re_nfa_build(nfa, nodes, root, reverse, &frag);
+	if (err)
+		return err;
+	int accept = re_nfa_add(nfa, RE_N_ACCEPT, -1, -1);
+	if (accept < 0)
+		return MALLOC_ERR;
+	nfa->states[frag.end].out = accept;
+	nfa->start = frag.start;
+	if (!any)
+		return NO_ERR;
+
+	// split -> match | any byte -> split
+	int split = re_nfa_add(nfa, RE_N_SPLIT, frag.start, -1);
+	int loop = re_nfa_add(nfa, RE_N_SET, split, -1);
+	if (split < 0 || loop < 0)
+		return MALLOC_ERR;
+	nfa->states[split].out1 = loop;
+	re_set_add(&nfa->states[loop].set, 0, 255);
+	nfa->start = split;
+	return NO_ERR;
+}
+
+int re_dfa_reset(struct re_dfa_t *self, struct re_nfa_t *nfa)
+{
+	self->nfa = nfa;
+	if (self->states == NULL)
+	{
+		self->states = (struct re_dstate_t *) malloc(
+			RE_MAX_STATES * sizeof(struct re_dstate_t));
+		self->hash = (int *) malloc(RE_HASH * sizeof(int));
+		if (self->states == NULL || self->hash == NULL)
+			return MALLOC_ERR;
+	}
+
+	// the scratch space only grows with the nfa
+	if (self->cap < nfa->n + 1)
+	{
+		int cap = (nfa->n + 1) * 2;
+		int *stack = (int *) realloc(self->stack, cap * sizeof(int));
+		if (stack == NULL)
+			return MALLOC_ERR;
+		self->stack = stack;
+		int *set = (int *) realloc(self->set, cap * sizeof(int));
+		if (set == NULL)
+			return MALLOC_ERR;
+		self->set = set;
+		int *mark = (int *) realloc(self->mark, cap * sizeof(int));
+		if (mark == NULL)
+			return MALLOC_ERR;
+		self->mark = mark;
+		self->cap = cap;
+	}
+	memset(self->mark, 0, self->cap * sizeof(int));
+	self->gen = 0;
+
+	// the dead state goes nowhere
+	struct re_dstate_t *dead = self->states;
+	dead->set = 0;
+	dead->n = 0;
+	dead->accept = 0;
+	memset(dead->next, 0, sizeof(dead->next));
+	re_dfa_flush(self);
+	return NO_ERR;
+}
+
+void re_dfa_free(struct re_dfa_t *self)
+{
+	free(self->states);
+	free(self->hash);
+	free(self->stack);
+	free(self->set);
+	free(self->mark);
+	free(self->pool);
+	memset(self, 0, sizeof(*self));
+}
+
+void re_dfa_flush(struct re_dfa_t *self)
+{
+	self->n = 1;
+	self->start = -1;
+	self->pool_len = 0;
+	self->flushes++;
+	memset(self->hash, -1, RE_HASH * sizeof(int));
+}
+
+int re_dfa_closure(struct re_dfa_t *self, int n, int *accept)
+{
+	struct re_nstate_t *states = self->nfa->states;
+	int *mark = self->mark;
+	if (++self->gen == 0)
+	{
+		memset(mark, 0, self->nfa->n * sizeof(int));
+		self->gen = 1;
+	}
+	int gen = self->gen;
+
+	// every state is pushed at most once
+	int top = 0;
+	for (int i = n - 1; i >= 0; i--)
+	{
+		if (mark[self->set[i]] == gen)
+			continue;
+		mark[self->set[i]] = gen;
+		self->stack[top++] = self->set[i];
+	}
+
+	int size = 0;
+	*accept = 0;
+	while (top > 0)
+	{
+		struct re_nstate_t *s = states + self->stack[--top];
+		if (s->type == RE_N_SET || s->type == RE_N_ACCEPT)
+		{
+			*accept |= s->type == RE_N_ACCEPT;
+			self->set[size++] = s - states;
+			continue;
+		}
+
+		int outs[2] = {s->type == RE_N_SPLIT ? s->out1 : -1, s->out};
+		for (int k = 0; k < 2; k++)
+		{
+			if (outs[k] < 0 || mark[outs[k]] == gen)
+				continue;
+			mark[outs[k]] = gen;
+			self->stack[top++] = outs[k];
+		}
+	}
+
+	// insertion sort; the sets are small
+	for (int i = 1; i < size; i++)
+	{
+		int v = self->set[i], j = i;
+		for (; j > 0 && self->set[j - 1] > v; j--)
+			self->set[j] = self->set[j - 1];
+		self->set[j] = v;
+	}
+	return size;
+}
+
+int re_dfa_state(struct re_dfa_t *self, int n, int accept)
+{
+	if (n == 0)
+		return 0;
+
+	unsigned long h = 2166136261UL;
+	for (int i = 0; i < n; i++)
+		h = (h ^ (unsigned long) self->set[i]) * 16777619UL;
+	int slot = h % RE_HASH;
+	for (; self->hash[slot] >= 0; slot = (slot + 1) % RE_HASH)
+	{
+		struct re_dstate_t *s = self->states + self->hash[slot];
+		if (s->n == n && memcmp(self->pool + s->set, self->set,
+			n * sizeof(int)) == 0)
+			return self->hash[slot];
+	}
+
+	// a full cache starts over; the caller only keeps the new state
+	if (self->n == RE_MAX_STATES)
+	{
+		re_dfa_flush(self);
+		return re_dfa_state(self, n, accept);
+	}
+
+	// the sets share one growing block
+	if (self->pool_len + n > self->pool_cap)
+	{
+		long cap = self->pool_cap * 2 + n;
+		int *pool = (int *) realloc(self->pool, cap * sizeof(int));
+		if (pool == NULL)
+			return -1;
+		self->pool = pool;
+		self->pool_cap = cap;
+	}
+	struct re_dstate_t *s = self->states + self->n;
+	s->set = self->pool_len;
+	memcpy(self->pool + s->set, self->set, n * sizeof(int));
+	self->pool_len += n;
+	s->n = n;
+	s->accept = accept;
+	memset(s->next, -1, sizeof(s->next));
+	self->hash[slot] = self->n;
+	return self->n++;
+}
+
+int re_dfa_start(struct re_dfa_t *self)
+{
+	if (self->start >= 0)
+		return self->start;
+	int accept = 0;
+	self->set[0] = self->nfa->start;
+	int n = re_dfa_closure(self, 1, &accept);
+	self->start = re_dfa_state(self, n, accept);
+	return self->start;
+}
+
+int re_dfa_next(struct re_dfa_t *self, int from, unsigned char c)
+{
+	struct re_dstate_t *s = self->states + from;
+	if (s->next[c] >= 0)
+		return s->next[c];
+
+	struct re_nstate_t *states = self->nfa->states;
+	const int *set = self->pool + s->set;
+	int n = 0;
+	for (int i = 0; i < s->n; i++)
+	{
+		struct re_nstate_t *ns = states + set[i];
+		if (ns->type == RE_N_SET && re_set_has(&ns->set, c))
+			self->set[n++] = ns->out;
+	}
+
+	int accept = 0;
+	n = re_dfa_closure(self, n, &accept);
+	int count = self->n;
+	int to = re_dfa_state(self, n, accept);
+
+	// a flush freed the state that was left
+	if (to >= 0 && self->n >= count)
+		self->states[from].next[c] = to;
+	return to;
+}
@@ -0,0 +1,249 @@
+#ifndef REGEX_H
+#define REGEX_H
+
+#include "util.h"
+
+// ========================================
+// regular expression
+//
+// syntax:
+//	c	the character c
+//	.	any character
+//	[abc]	one of the characters; ranges like a-z and [^...] work too
+//	\d \w \s	digit, word character, whitespace; \D \W \S negate
+//	\c	the character c even if it is special
+//	ab	a followed by b
+//	a|b	a or b
+//	a* a+ a?	repetitions of a
+//	(a)	grouping
+//	^ $	start and end of the line; only at the ends of the pattern
+//
+// patterns are matched one line at a time without backtracking; every
+// match is the leftmost one and among those the longest one
+// ========================================
+
+/**
+ * maximum number of dfa states cached per automaton; the cache is
+ * thrown away and rebuilt when it is full
+ */
+#define RE_MAX_STATES 1024
+
+/**
+ * maximum nesting of groups
+ */
+#define RE_MAX_DEPTH 256
+
+/**
+ * set of bytes
+ */
+struct re_set_t
+{
+	unsigned long long bits[4];
+};
+
+/**
+ * state of the nfa
+ *
+ * members:
+ *	type	RE_N_* kind of the state
+ *	out	next state
+ *	out1	second next state; splits only
+ *	set	bytes consumed by the state; sets only
+ */
+struct re_nstate_t
+{
+	int type;
+	int out;
+	int out1;
+	struct re_set_t set;
+};
+
+/**
+ * thompson nfa
+ *
+ * members:
+ *	states	states of the automaton
+ *	n	number of states
+ *	cap	capacity of states
+ *	start	starting state
+ */
+struct re_nfa_t
+{
+	struct re_nstate_t *states;
+	int n;
+	int cap;
+	int start;
+};
+
+/**
+ * state of the dfa; a set of nfa states
+ *
+ * members:
+ *	set	sorted nfa states that consume a byte or accept; an offset in
+ *		the pool of the dfa
+ *	n	number of nfa states
+ *	accept	does the set contain the accepting state
+ *	next	next state for every byte; -1 until it is computed
+ */
+struct re_dstate_t
+{
+	long set;
+	int n;
+	int accept;
+	int next[256];
+};
+
+/**
+ * dfa built lazily from an nfa while it runs
+ * state 0 is the dead state
+ *
+ * members:
+ *	nfa	automaton the states are made of
+ *	states	computed states
+ *	n	number of computed states
+ *	start	starting state; -1 until it is computed
+ *	hash	index of the states by their set; -1 for empty slots
+ *	stack	scratch space for the closures
+ *	set	set of the last closure
+ *	mark	visited nfa states of the last closure
+ *	cap	capacity of stack, set and mark
+ *	gen	generation of mark
+ *	flushes	number of times the cache was thrown away
+ *	pool	sets of the states one after the other
+ *	pool_len	used part of pool
+ *	pool_cap	capacity of pool
+ */
+struct re_dfa_t
+{
+	struct re_nfa_t *nfa;
+	struct re_dstate_t *states;
+	int n;
+	int start;
+	int *hash;
+	int *stack;
+	int *set;
+	int *mark;
+	int cap;
+	int gen;
+	int flushes;
+
+	int *pool;
+	long pool_len;
+	long pool_cap;
+};
+
+/**
+ * compiled regular expression
+ *
+ * members:
+ *	fwd	nfa of the pattern
+ *	rev	nfa of the reversed pattern that may start anywhere
+ *	fdfa	dfa of fwd; finds where a match ends
+ *	rdfa	dfa of rev; finds where matches start
+ *	bol	is the pattern anchored at the start of the line
+ *	eol	is the pattern anchored at the end of the line
+ *	nodes	syntax tree of the last compiled pattern
+ *	nodes_cap	capacity of nodes
+ *	lit	the pattern as plain bytes if it has no special characters
+ *	lit_len	length of lit; 0 if the pattern is not plain
+ *	lit_cap	capacity of lit
+ *	line	line given to regex_line
+ *	len	length of the line
+ *	starts	starts[i] is set when a match starts at i
+ *	trail	trail[i] is the state of fdfa at i in the last forward run
+ *	cap	capacity of starts and trail
+ *	trail_lo	start of the last forward run
+ *	trail_hi	end of trail; -1 if it can't be followed
+ *	trail_last	end of the longest match of the last forward run
+ *	trail_flushes	flushes of fdfa when trail was made
+ */
+struct regex_t
+{
+	struct re_nfa_t fwd;
+	struct re_nfa_t rev;
+	struct re_dfa_t fdfa;
+	struct re_dfa_t rdfa;
+	int bol;
+	int eol;
+
+	struct re_node_t *nodes;
+	int nodes_cap;
+
+	char *lit;
+	long lit_len;
+	long lit_cap;
+
+	const char *line;
+	long len;
+	char *starts;
+	int *trail;
+	long cap;
+	long trail_lo;
+	long trail_hi;
+	long trail_last;
+	int trail_flushes;
+};
+
+/**
+ * initialize a regular expression that matches nothing yet
+ *
+ * params:
+ *	self	self pointer
+ */
+int regex_init(struct regex_t *self);
+
+/**
+ * compile a pattern
+ * the memory of the pattern compiled before is used again, so compiling
+ * one pattern after another allocates nothing once it is big enough
+ * gives RANGE_ERR if the pattern is not valid
+ *
+ * params:
+ *	self	self pointer
+ *	pat	pattern
+ *	len	length of the pattern
+ */
+int regex_compile(struct regex_t *self, const char *pat, long len);
+
+/**
+ * free a compiled pattern
+ *
+ * params:
+ *	self	self pointer
+ */
+int regex_free(struct regex_t *self);
+
+/**
+ * find where matches start in a line in one backward pass
+ * the line must stay valid while regex_next is used
+ *
+ * params:
+ *	self	self pointer
+ *	line	content of the line without the '\n'
+ *	len	length of the line
+ */
+int regex_line(struct regex_t *self, const char *line, long len);
+
+/**
+ * first match of the prepared line that starts at or after from
+ *
+ * params:
+ *	self	self pointer
+ *	from	offset in the line
+ *	start	where the start of the match is given; -1 if there is none
+ *	end	where the end of the match is given
+ */
+int regex_next(struct regex_t *self, long from, long *start, long *end);
+
+/**
+ * last match of the prepared line that starts before to
+ *
+ * params:
+ *	self	self pointer
+ *	to	offset in the line
+ *	start	where the start of the match is given; -1 if there is none
+ *	end	where the end of the match is given
+ */
+int regex_prev(struct regex_t *self, long to, long *start, long *end);
+
+#endif // REGEX_H
@@ -0,0 +1,346 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "screen.h"
+#include "utf8.h"
+#include "util.h"
+
+// ========================================
+// helper declaration
+// ========================================
+
+/**
+ * append the sequence that selects the given attributes
+ *
+ * params:
+ *	b	where the sequence is appended
+ *	attr	SCREEN_* bits
+ */
+void screen_sgr(struct str_t *b, int attr);
+
+/**
+ * append the shortest sequence that moves the cursor
+ *
+ * params:
+ *	b	where the sequence is appended
+ *	row	current row of the cursor; -1 if unknown
+ *	col	current column of the cursor
+ *	to_row	row to move to
+ *	to_col	column to move to
+ */
+void screen_move(struct str_t *b, int row, int col, int to_row, int to_col);
+
+/**
+ * does the cell differ between the frame and the terminal
+ *
+ * params:
+ *	self	self pointer
+ *	i	index of the cell
+ */
+int screen_dirty(struct screen_t *self, long i);
+
+/**
+ * blank the halves of wide characters left outside the cells about to be
+ * drawn over
+ *
+ * params:
+ *	self	self pointer
+ *	row	row of the cells
+ *	col	first column; inside the row
+ *	len	number of cells; inside the row
+ */
+void screen_cut(struct screen_t *self, int row, int col, int len);
+
+/**
+ * append the characters of some cells; the right halves of wide
+ * characters print nothing
+ *
+ * params:
+ *	b	where the characters are appended
+ *	text	code points of the cells
+ *	len	number of cells
+ */
+void screen_text(struct str_t *b, const int *text, int len);
+
+// ========================================
+// screen.h - definition
+// ========================================
+
+int screen_init(struct screen_t *self)
+{
+	memset(self, 0, sizeof(*self));
+	return NO_ERR;
+}
+
+int screen_free(struct screen_t *self)
+{
+	free(self->text);
+	free(self->attr);
+	free(self->last_text);
+	free(self->last_attr);
+	memset(self, 0, sizeof(*self));
+	return NO_ERR;
+}
+
+int screen_resize(struct screen_t *self, int rows, int cols)
+{
+	if (rows < 0) rows = 0;
+	if (cols < 0) cols = 0;
+	long n = (long) rows * cols;
+
+	int *text = (int *) malloc((n + 1) * sizeof(int));
+	unsigned char *attr = (unsigned char *) malloc(n + 1);
+	int *last_text = (int *) malloc((n + 1) * sizeof(int));
+	unsigned char *last_attr = (unsigned char *) malloc(n + 1);
+	if (!text || !attr || !last_text || !last_attr)
+	{
+		free(text);
+		free(attr);
+		free(last_text);
+		free(last_attr);
+		return MALLOC_ERR;
+	}
+
+	screen_free(self);
+	self->rows = rows;
+	self->cols = cols;
+	self->text = text;
+	self->attr = attr;
+	self->last_text = last_text;
+	self->last_attr = last_attr;
+	self->valid = 0;
+	screen_clear(self);
+	return NO_ERR;
+}
+
+void screen_clear(struct screen_t *self)
+{
+	long n = (long) self->rows * self->cols;
+	for (long i = 0; i < n; i++)
+		self->text[i] = ' ';
+	memset(self->attr, 0, n);
+}
+
+void screen_blank(struct screen_t *self, int row, int col, int rows,
+	int cols)
+{
+	if (col < 0)
+	{
+		cols += col;
+		col = 0;
+	}
+	if (cols > self->cols - col)
+		cols = self->cols - col;
+	if (cols <= 0)
+		return;
+	for (int r = row < 0 ? 0 : row; r < row + rows && r < self->rows; r++)
+	{
+		screen_cut(self, r, col, cols);
+		long i = (long) r * self->cols + col;
+		for (int c = 0; c < cols; c++)
+			self->text[i + c] = ' ';
+		memset(self->attr + i, 0, cols);
+	}
+}
+
+void screen_put(struct screen_t *self, int row, int col, const char *src,
+	int len, int attr)
+{
+	if (row < 0 || row >= self->rows || col >= self->cols)
+		return;
+	if (len > self->cols - col)
+		len = self->cols - col;
+	if (len <= 0)
+		return;
+
+	screen_cut(self, row, col, len);
+	long i = (long) row * self->cols + col;
+	for (int c = 0; c < len; c++)
+	{
+		unsigned char ch = src[c];
+		self->text[i + c] = ch < 0x80 ? ch : '?';
+	}
+	memset(self->attr + i, attr, len);
+}
+
+void screen_put_char(struct screen_t *self, int row, int col, int cp,
+	int width, int attr)
+{
+	if (row < 0 || row >= self->rows || col < 0 || col + width > self->cols)
+		return;
+
+	screen_cut(self, row, col, width);
+	long i = (long) row * self->cols + col;
+	self->text[i] = cp;
+	self->attr[i] = attr;
+	if (width == 2)
+	{
+		self->text[i + 1] = SCREEN_WIDE;
+		self->attr[i + 1] = attr;
+	}
+}
+
+int screen_flush(struct screen_t *self, struct str_t *b)
+{
+	long n = (long) self->rows * self->cols;
+
+	// start from a blank terminal when its content is unknown
+	if (!self->valid)
+	{
+		str_appends(b, "\x1b[m\x1b[2J", 7);
+		for (long i = 0; i < n; i++)
+			self->last_text[i] = ' ';
+		memset(self->last_attr, 0, n);
+		self->valid = 1;
+	}
+
+	int row = -1, col = 0, attr = 0;
+	for (int r = 0; r < self->rows; r++)
+	{
+		long base = (long) r * self->cols;
+		if (memcmp(self->text + base, self->last_text + base,
+			self->cols * sizeof(int)) == 0 &&
+			memcmp(self->attr + base, self->last_attr + base,
+			self->cols) == 0)
+			continue;
+
+		int c = 0;
+		while (c < self->cols)
+		{
+			if (!screen_dirty(self, base + c))
+			{
+				c++;
+				continue;
+			}
+
+			// a run ends after SCREEN_GAP unchanged cells
+			int end = c;
+			for (int j = c + 1; j < self->cols && j - end <= SCREEN_GAP;
+				j++)
+				if (screen_dirty(self, base + j))
+					end = j;
+
+			// a wide character is printed whole; the terminal cursor
+			// moves over both of its columns
+			if (c > 0 && self->text[base + c] == SCREEN_WIDE)
+				c--;
+			if (end + 1 < self->cols && self->text[base + end + 1] ==
+				SCREEN_WIDE)
+				end++;
+
+			screen_move(b, row, col, r, c);
+			long start = base + c;
+			while (c <= end)
+			{
+				if (self->attr[base + c] != attr)
+				{
+					attr = self->attr[base + c];
+					screen_sgr(b, attr);
+				}
+
+				// cells sharing the attribute go out in one copy
+				int same = c + 1;
+				while (same <= end && self->attr[base + same] == attr)
+					same++;
+				screen_text(b, self->text + base + c, same - c);
+				c = same;
+			}
+			memcpy(self->last_text + start, self->text + start,
+				(base + c - start) * sizeof(int));
+			memcpy(self->last_attr + start, self->attr + start,
+				base + c - start);
+
+			// the cursor is left in a pending wrap at the last column
+			row = c < self->cols ? r : -1;
+			col = c;
+		}
+	}
+
+	if (attr)
+		screen_sgr(b, 0);
+	return NO_ERR;
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+void screen_sgr(struct str_t *b, int attr)
+{
+	if (attr == 0)
+	{
+		str_appends(b, "\x1b[m", 3);
+		return;
+	}
+
+	str_appends(b, "\x1b[0", 3);
+	if (attr & SCREEN_BOLD)
+		str_appends(b, ";1", 2);
+	if (attr & SCREEN_REVERSE)
+		str_appends(b, ";7", 2);
+	if (attr & SCREEN_MAGENTA)
+		str_appends(b, ";35", 3);
+	if (attr & SCREEN_RED_BG)
+		str_appends(b, ";41", 3);
+	if (attr & SCREEN_FG)
+	{
+		char fg[4] = { ';', '3', '0' + ((attr & SCREEN_FG) >> 4), 0 };
+		str_appends(b, fg, 3);
+	}
+	str_appendc(b, 'm');
+}
+
+void screen_move(struct str_t *b, int row, int col, int to_row, int to_col)
+{
+	if (row == to_row && col == to_col)
+		return;
+
+	char buffer[32];
+	if (row == to_row && to_col > col)
+		snprintf(buffer, sizeof(buffer), "\x1b[%dC", to_col - col);
+	else if (to_col == 0)
+		snprintf(buffer, sizeof(buffer), "\x1b[%dH", to_row + 1);
+	else
+		snprintf(buffer, sizeof(buffer), "\x1b[%d;%dH", to_row + 1,
+			to_col + 1);
+	str_appends(b, buffer, strlen(buffer));
+}
+
+int screen_dirty(struct screen_t *self, long i)
+{
+	return self->text[i] != self->last_text[i] ||
+		self->attr[i] != self->last_attr[i];
+}
+
+void screen_cut(struct screen_t *self, int row, int col, int len)
+{
+	long base = (long) row * self->cols;
+	if (col > 0 && self->text[base + col] == SCREEN_WIDE)
+		self->text[base + col - 1] = ' ';
+	if (col + len < self->cols && self->text[base + col + len] == SCREEN_WIDE)
+		self->text[base + col + len] = ' ';
+}
+
+void screen_text(struct str_t *b, const int *text, int len)
+{
+	// characters are encoded into a small buffer and appended in blocks
+	char buffer[256];
+	int n = 0;
+	for (int i = 0; i < len; i++)
+	{
+		int cp = text[i];
+		if (cp == SCREEN_WIDE)
+			continue;
+		if (cp < 0x80)
+			buffer[n++] = cp;
+		else
+			n += utf8_encode(cp, buffer + n);
+		if (n > (int) sizeof(buffer) - UTF8_MAX)
+		{
+			str_appends(b, buffer, n);
+			n = 0;
+		}
+	}
+	str_appends(b, buffer, n);
+}
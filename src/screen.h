@@ -0,0 +1,160 @@
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include "util.h"
+
+// ========================================
+// shadow screen
+// ========================================
+
+/**
+ * attributes of a cell; combined as bits
+ * SCREEN_FG holds one foreground colour out of SCREEN_FG_*
+ */
+enum
+{
+	SCREEN_BOLD = 1,
+	SCREEN_REVERSE = 2,
+	SCREEN_MAGENTA = 4,
+	SCREEN_RED_BG = 8,
+
+	SCREEN_FG_RED = 1 << 4,
+	SCREEN_FG_GREEN = 2 << 4,
+	SCREEN_FG_YELLOW = 3 << 4,
+	SCREEN_FG_BLUE = 4 << 4,
+	SCREEN_FG_PURPLE = 5 << 4,
+	SCREEN_FG_CYAN = 6 << 4,
+	SCREEN_FG = 7 << 4,
+};
+
+/**
+ * number of unchanged cells that are reprinted instead of moving the
+ * cursor over them
+ */
+#define SCREEN_GAP 4
+
+/**
+ * most bytes screen_flush sends for one cell: a cursor move, every
+ * attribute and a character
+ */
+#define SCREEN_CELL_MAX 40
+
+/**
+ * character of the cell covered by the right half of a wide character
+ */
+#define SCREEN_WIDE -1
+
+/**
+ * grid of cells being drawn and the grid last sent to the terminal
+ * only the difference between them is sent
+ *
+ * members:
+ *	rows		number of rows
+ *	cols		number of columns
+ *	text		code points of the frame being drawn; a wide
+ *			character is followed by a SCREEN_WIDE cell
+ *	attr		attributes of the frame being drawn
+ *	last_text	code points on the terminal
+ *	last_attr	attributes on the terminal
+ *	valid		does last_* match the terminal
+ */
+struct screen_t
+{
+	int rows;
+	int cols;
+
+	int *text;
+	unsigned char *attr;
+	int *last_text;
+	unsigned char *last_attr;
+	int valid;
+};
+
+/**
+ * initialize an empty screen
+ *
+ * params:
+ *	self	self pointer
+ */
+int screen_init(struct screen_t *self);
+
+/**
+ * free the screen
+ *
+ * params:
+ *	self	self pointer
+ */
+int screen_free(struct screen_t *self);
+
+/**
+ * change the size of the screen; the next flush redraws everything
+ *
+ * params:
+ *	self	self pointer
+ *	rows	number of rows
+ *	cols	number of columns
+ */
+int screen_resize(struct screen_t *self, int rows, int cols);
+
+/**
+ * blank the frame being drawn
+ *
+ * params:
+ *	self	self pointer
+ */
+void screen_clear(struct screen_t *self);
+
+/**
+ * blank a rectangle of the frame being drawn; clipped to the screen
+ *
+ * params:
+ *	self	self pointer
+ *	row	first row
+ *	col	first column
+ *	rows	number of rows
+ *	cols	number of columns
+ */
+void screen_blank(struct screen_t *self, int row, int col, int rows,
+	int cols);
+
+/**
+ * put characters into the frame being drawn; clipped to the row
+ *
+ * params:
+ *	self	self pointer
+ *	row	row of the first character
+ *	col	column of the first character
+ *	src	printable ascii; any other byte is put as '?'
+ *	len	number of characters
+ *	attr	SCREEN_* bits of the characters
+ */
+void screen_put(struct screen_t *self, int row, int col, const char *src,
+	int len, int attr);
+
+/**
+ * put one character into the frame being drawn
+ * a wide character that doesn't fit in the row is not put
+ *
+ * params:
+ *	self	self pointer
+ *	row	row of the character
+ *	col	column of the character
+ *	cp	code point; printable
+ *	width	number of columns; 1 or 2
+ *	attr	SCREEN_* bits of the character
+ */
+void screen_put_char(struct screen_t *self, int row, int col, int cp,
+	int width, int attr);
+
+/**
+ * append the escape sequences that turn the terminal into the frame
+ * being drawn; the frame becomes the terminal content
+ * the position of the terminal cursor is unknown afterwards
+ *
+ * params:
+ *	self	self pointer
+ *	b	where the escape sequences are appended
+ */
+int screen_flush(struct screen_t *self, struct str_t *b);
+
+#endif // SCREEN_H
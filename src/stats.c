@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "stats.h"
+#include "util.h"
+
+// ========================================
+// helper declaration
+// ========================================
+
+/**
+ * order of two samples for qsort
+ *
+ * params:
+ *	a	first sample
+ *	b	second sample
+ */
+int stats_cmp(const void *a, const void *b);
+
+/**
+ * write one complete event of the chrome trace format
+ *
+ * params:
+ *	fp	file being written
+ *	name	name of the event
+ *	start	start in nanoseconds
+ *	ns	duration in nanoseconds
+ *	keys	number of keys of the frame; -1 to leave it out
+ *	first	is it the first event of the file?
+ */
+void stats_event(FILE *fp, const char *name, long start, long ns, int keys,
+	int first);
+
+// ========================================
+// stats.h - definition
+// ========================================
+
+int stats_init(struct stats_t *self)
+{
+	memset(self->samples, 0, sizeof(self->samples));
+	memset(self->count, 0, sizeof(self->count));
+	memset(&self->cur, 0, sizeof(self->cur));
+	self->trace = NULL;
+	self->traced = 0;
+	return NO_ERR;
+}
+
+int stats_free(struct stats_t *self)
+{
+	free(self->trace);
+	self->trace = NULL;
+	self->traced = 0;
+	return NO_ERR;
+}
+
+long stats_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+void stats_begin(struct stats_t *self, long now)
+{
+	if (self->cur.start == 0)
+		self->cur.start = now;
+}
+
+void stats_add(struct stats_t *self, int stage, long ns)
+{
+	self->samples[stage][self->count[stage] % STATS_WINDOW] = ns;
+	self->count[stage]++;
+	self->cur.ns[stage] += ns;
+	if (stage == STATS_KEY)
+		self->cur.keys++;
+}
+
+void stats_end(struct stats_t *self, long now)
+{
+	if (self->cur.start == 0)
+		return;
+	stats_add(self, STATS_FRAME, now - self->cur.start);
+	if (self->trace)
+		self->trace[self->traced++ % STATS_TRACE] = self->cur;
+	memset(&self->cur, 0, sizeof(self->cur));
+}
+
+int stats_get(struct stats_t *self, int stage, long *p50, long *p99,
+	long *max)
+{
+	*p50 = *p99 = *max = 0;
+	long n = self->count[stage];
+	if (n > STATS_WINDOW)
+		n = STATS_WINDOW;
+	if (n == 0)
+		return NO_ERR;
+
+	// only asked for on demand so the window is sorted on a copy
+	long sorted[STATS_WINDOW];
+	memcpy(sorted, self->samples[stage], n * sizeof(long));
+	qsort(sorted, n, sizeof(long), stats_cmp);
+	*p50 = sorted[(n - 1) / 2];
+	*p99 = sorted[(n - 1) * 99 / 100];
+	*max = sorted[n - 1];
+	return NO_ERR;
+}
+
+int stats_trace(struct stats_t *self, int on)
+{
+	if (!on)
+		return stats_free(self);
+	if (self->trace)
+		return NO_ERR;
+
+	self->trace = malloc(STATS_TRACE * sizeof(struct stats_frame_t));
+	if (self->trace == NULL)
+		return MALLOC_ERR;
+	self->traced = 0;
+	return NO_ERR;
+}
+
+int stats_dump(struct stats_t *self, const char *path)
+{
+	if (self->trace == NULL)
+		return RANGE_ERR;
+	FILE *fp = fopen(path, "w");
+	if (fp == NULL)
+		return IO_ERR;
+
+	// oldest frame first; the ring only holds the latest frames
+	long first = self->traced > STATS_TRACE ? self->traced - STATS_TRACE : 0;
+	fprintf(fp, "{\"traceEvents\": [");
+	for (long i = first; i < self->traced; i++)
+	{
+		struct stats_frame_t *f = self->trace + i % STATS_TRACE;
+		long total = f->ns[STATS_FRAME];
+		long *ns = f->ns;
+
+		// keys are interleaved with decoding so they are laid out after
+		// it; the frame ends with rendering and writing
+		long write = f->start + total - ns[STATS_WRITE];
+		long render = write - ns[STATS_RENDER];
+		stats_event(fp, "frame", f->start, total, f->keys, i == first);
+		stats_event(fp, "decode", f->start, ns[STATS_DECODE], -1, 0);
+		stats_event(fp, "keys", f->start + ns[STATS_DECODE], ns[STATS_KEY],
+			f->keys, 0);
+		stats_event(fp, "render", render, ns[STATS_RENDER], -1, 0);
+		stats_event(fp, "write", write, ns[STATS_WRITE], -1, 0);
+	}
+	fprintf(fp, "\n], \"displayTimeUnit\": \"ns\"}\n");
+
+	int err = ferror(fp) ? IO_ERR : NO_ERR;
+	if (fclose(fp) != 0)
+		err = IO_ERR;
+	return err;
+}
+
+const char *stats_name(int stage)
+{
+	static const char *names[STATS_STAGES] = {
+		"decode", "key", "render", "write", "frame",
+	};
+	return 0 <= stage && stage < STATS_STAGES ? names[stage] : "";
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+int stats_cmp(const void *a, const void *b)
+{
+	long x = *(const long *) a;
+	long y = *(const long *) b;
+	return (x > y) - (x < y);
+}
+
+void stats_event(FILE *fp, const char *name, long start, long ns, int keys,
+	int first)
+{
+	// the format takes microseconds
+	fprintf(fp, "%s\n{\"name\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, "
+		"\"dur\": %.3f, \"pid\": 1, \"tid\": 1", first ? "" : ",", name,
+		start / 1e3, ns / 1e3);
+	if (keys >= 0)
+		fprintf(fp, ", \"args\": {\"keys\": %d}", keys);
+	fprintf(fp, "}");
+}
@@ -0,0 +1,163 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "util.h"
+
+// ========================================
+// latency statistics
+// ========================================
+
+/**
+ * samples kept per stage; percentiles are over the latest ones
+ */
+#define STATS_WINDOW 1024
+
+/**
+ * frames kept by the trace ring buffer
+ */
+#define STATS_TRACE 4096
+
+/**
+ * stages of a frame
+ *
+ * stages:
+ *	STATS_DECODE	decoding the bytes read from the terminal into keys
+ *	STATS_KEY	applying one key; sampled once per key
+ *	STATS_RENDER	building the frame
+ *	STATS_WRITE	writing the frame to the terminal
+ *	STATS_FRAME	from the first byte read to the frame written
+ */
+enum
+{
+	STATS_DECODE = 0,
+	STATS_KEY,
+	STATS_RENDER,
+	STATS_WRITE,
+	STATS_FRAME,
+	STATS_STAGES,
+};
+
+/**
+ * record of one frame
+ *
+ * members:
+ *	start	clock of the start of the frame in nanoseconds; 0 if unstarted
+ *	ns	nanoseconds spent in every stage; keys are summed
+ *	keys	number of keys applied
+ */
+struct stats_frame_t
+{
+	long start;
+	long ns[STATS_STAGES];
+	int keys;
+};
+
+/**
+ * rolling latency samples of every stage and an optional frame trace
+ *
+ * members:
+ *	samples	ring of the latest samples of every stage
+ *	count	number of samples ever added to every stage
+ *	cur	frame being measured
+ *	trace	ring of the latest frames; NULL while not tracing
+ *	traced	number of frames ever added to the trace
+ */
+struct stats_t
+{
+	long samples[STATS_STAGES][STATS_WINDOW];
+	long count[STATS_STAGES];
+	struct stats_frame_t cur;
+	struct stats_frame_t *trace;
+	long traced;
+};
+
+/**
+ * initialize empty statistics
+ *
+ * params:
+ *	self	self pointer
+ */
+int stats_init(struct stats_t *self);
+
+/**
+ * free the statistics
+ *
+ * params:
+ *	self	self pointer
+ */
+int stats_free(struct stats_t *self);
+
+/**
+ * monotonic clock in nanoseconds
+ */
+long stats_now();
+
+/**
+ * start the current frame unless it is started already
+ *
+ * params:
+ *	self	self pointer
+ *	now	clock from stats_now
+ */
+void stats_begin(struct stats_t *self, long now);
+
+/**
+ * add a sample to a stage and to the current frame
+ *
+ * params:
+ *	self	self pointer
+ *	stage	one of STATS_*
+ *	ns	duration in nanoseconds
+ */
+void stats_add(struct stats_t *self, int stage, long ns);
+
+/**
+ * finish the current frame; samples its total and traces it
+ *
+ * params:
+ *	self	self pointer
+ *	now	clock from stats_now
+ */
+void stats_end(struct stats_t *self, long now);
+
+/**
+ * percentiles of the latest samples of a stage; all 0 without samples
+ *
+ * params:
+ *	self	self pointer
+ *	stage	one of STATS_*
+ *	p50	where the median is given
+ *	p99	where the 99th percentile is given
+ *	max	where the largest sample is given
+ */
+int stats_get(struct stats_t *self, int stage, long *p50, long *p99,
+	long *max);
+
+/**
+ * start or stop tracing the frames; stopping forgets the trace
+ *
+ * params:
+ *	self	self pointer
+ *	on	trace the frames?
+ */
+int stats_trace(struct stats_t *self, int on);
+
+/**
+ * write the traced frames as a chrome trace json file
+ * every stage of a frame is a complete event nested in the frame
+ *
+ * params:
+ *	self	self pointer
+ *	path	path of the file
+ */
+int stats_dump(struct stats_t *self, const char *path);
+
+/**
+ * name of a stage
+ *
+ * params:
+ *	stage	one of STATS_*
+ */
+const char *stats_name(int stage);
+
+#endif // STATS_H
@@ -0,0 +1,184 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "swap.h"
+#include "text.h"
+#include "util.h"
+
+// ========================================
+// helper declaration
+// ========================================
+
+/**
+ * write the snapshot to the swap file; the writer thread
+ *
+ * params:
+ *	arg	swap
+ */
+void *swap_run(void *arg);
+
+/**
+ * free the snapshot of a finished write and record its version
+ *
+ * params:
+ *	self	self pointer
+ */
+int swap_finish(struct swap_t *self);
+
+// ========================================
+// swap.h - definition
+// ========================================
+
+int swap_init(struct swap_t *self)
+{
+	self->path = NULL;
+	self->found = 0;
+	self->saved = -1;
+	self->since = 0;
+	self->running = 0;
+	self->done = 0;
+	self->err = NO_ERR;
+	memset(&self->snap, 0, sizeof(self->snap));
+	self->version = 0;
+	pthread_mutex_init(&self->lock, NULL);
+	return NO_ERR;
+}
+
+int swap_free(struct swap_t *self)
+{
+	int done = 0;
+	swap_poll(self, 1, &done);
+	free(self->path);
+	self->path = NULL;
+	pthread_mutex_destroy(&self->lock);
+	return NO_ERR;
+}
+
+int swap_open(struct swap_t *self, const char *file)
+{
+	int done = 0;
+	swap_poll(self, 1, &done);
+	free(self->path);
+	self->saved = -1;
+	self->since = 0;
+
+	// .name.ve.swp next to the file
+	const char *slash = strrchr(file, '/');
+	int dir = slash ? slash - file + 1 : 0;
+	int len = strlen(file) + 9;
+	self->path = (char *) malloc(len);
+	if (self->path == NULL)
+		return MALLOC_ERR;
+	snprintf(self->path, len, "%.*s.%s.ve.swp", dir, file, file + dir);
+
+	self->found = access(self->path, F_OK) == 0;
+	return NO_ERR;
+}
+
+int swap_start(struct swap_t *self, struct text_t *text)
+{
+	if (self->path == NULL || self->running)
+		return RANGE_ERR;
+
+	int err = text_snap(text, &self->snap);
+	if (err)
+		return err;
+	self->version = text->version;
+	self->done = 0;
+	self->err = NO_ERR;
+
+	// without a thread the snapshot is written right away
+	if (pthread_create(&self->thread, NULL, swap_run, self) != 0)
+	{
+		swap_run(self);
+		return swap_finish(self);
+	}
+	self->running = 1;
+	return NO_ERR;
+}
+
+int swap_poll(struct swap_t *self, int wait, int *done)
+{
+	*done = 0;
+	if (!self->running)
+		return NO_ERR;
+
+	pthread_mutex_lock(&self->lock);
+	int finished = self->done;
+	pthread_mutex_unlock(&self->lock);
+	if (!finished && !wait)
+		return NO_ERR;
+
+	pthread_join(self->thread, NULL);
+	self->running = 0;
+	*done = 1;
+	return swap_finish(self);
+}
+
+int swap_remove(struct swap_t *self)
+{
+	int done = 0;
+	swap_poll(self, 1, &done);
+	if (self->path && unlink(self->path) != 0 && errno != ENOENT)
+		return IO_ERR;
+	self->found = 0;
+	self->saved = -1;
+	self->since = 0;
+	return NO_ERR;
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+void *swap_run(void *arg)
+{
+	struct swap_t *self = (struct swap_t *) arg;
+	int err = NO_ERR;
+
+	int len = strlen(self->path) + 8;
+	char *tmp = (char *) malloc(len);
+	int fd = -1;
+	if (tmp == NULL)
+		err = MALLOC_ERR;
+	else
+	{
+		snprintf(tmp, len, "%s.XXXXXX", self->path);
+		fd = mkstemp(tmp);
+		if (fd == -1)
+			err = IO_ERR;
+	}
+
+	// the swap file is replaced only by a complete copy
+	long written = 0;
+	if (fd != -1)
+	{
+		err = text_snap_write(&self->snap, fd, &written);
+		if (!err && fsync(fd) != 0)
+			err = IO_ERR;
+		if (close(fd) != 0)
+			err = IO_ERR;
+		if (!err && rename(tmp, self->path) != 0)
+			err = IO_ERR;
+		if (err)
+			unlink(tmp);
+	}
+	free(tmp);
+
+	pthread_mutex_lock(&self->lock);
+	self->err = err;
+	self->done = 1;
+	pthread_mutex_unlock(&self->lock);
+	return NULL;
+}
+
+int swap_finish(struct swap_t *self)
+{
+	text_snap_free(&self->snap);
+	if (self->err == NO_ERR)
+		self->saved = self->version;
+	return self->err;
+}
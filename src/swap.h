@@ -0,0 +1,117 @@
+#ifndef SWAP_H
+#define SWAP_H
+
+#include <pthread.h>
+
+#include "text.h"
+#include "util.h"
+
+// ========================================
+// swap file
+// ========================================
+
+/**
+ * milliseconds from the first unsaved change to its autosave
+ * build with -DSWAP_MS=<ms> to change it
+ */
+#ifndef SWAP_MS
+#define SWAP_MS 2000
+#endif
+
+/**
+ * milliseconds between checks for the end of a background write
+ */
+#define SWAP_POLL_MS 50
+
+/**
+ * copy of the document kept next to the file; written in the background
+ * from a snapshot so that the editor never waits for the disk
+ *
+ * members:
+ *	path	path of the swap file; NULL without a file
+ *	found	a swap file already existed when the file was opened; it is
+ *		never overwritten until it is recovered or deleted
+ *	saved	version of the document in the swap file; -1 for none
+ *	since	clock of the first change missing from the swap file in
+ *		nanoseconds; 0 if none
+ *	thread	writer thread
+ *	running	was the thread started and not joined yet
+ *	lock	guards done
+ *	done	has the thread finished
+ *	err	error of the thread
+ *	snap	snapshot being written
+ *	version	version of the document in the snapshot
+ */
+struct swap_t
+{
+	char *path;
+	int found;
+	long saved;
+	long since;
+
+	pthread_t thread;
+	int running;
+	pthread_mutex_t lock;
+	int done;
+	int err;
+
+	struct text_snap_t snap;
+	long version;
+};
+
+/**
+ * initialize a swap without a file
+ *
+ * params:
+ *	self	self pointer
+ */
+int swap_init(struct swap_t *self);
+
+/**
+ * wait for the writer thread and free the swap; the file stays
+ *
+ * params:
+ *	self	self pointer
+ */
+int swap_free(struct swap_t *self);
+
+/**
+ * use the swap file of a file; .name.ve.swp in the same directory
+ * sets found if the swap file already exists
+ *
+ * params:
+ *	self	self pointer
+ *	file	path of the edited file
+ */
+int swap_open(struct swap_t *self, const char *file);
+
+/**
+ * take a snapshot of the document and write it in the background
+ * the snapshot goes to a temporary file that is renamed over the swap
+ * file, so the swap file is always complete
+ *
+ * params:
+ *	self	self pointer
+ *	text	document; must outlive the write
+ */
+int swap_start(struct swap_t *self, struct text_t *text);
+
+/**
+ * finish a background write if it is done
+ *
+ * params:
+ *	self	self pointer
+ *	wait	wait for the write to be done
+ *	done	where it is given if a write was finished
+ */
+int swap_poll(struct swap_t *self, int wait, int *done);
+
+/**
+ * wait for the writer thread and delete the swap file
+ *
+ * params:
+ *	self	self pointer
+ */
+int swap_remove(struct swap_t *self);
+
+#endif // SWAP_H
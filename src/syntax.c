@@ -0,0 +1,574 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "screen.h"
+#include "syntax.h"
+#include "text.h"
+#include "util.h"
+
+/**
+ * states of the c lexer at the end of a line
+ *
+ * states:
+ *	SYNTAX_C_NORMAL		nothing open
+ *	SYNTAX_C_COMMENT	inside a block comment
+ *	SYNTAX_C_STRING		inside a string continued with a backslash
+ *	SYNTAX_C_PREPROC	inside a preprocessor line continued with a
+ *				backslash
+ *	SYNTAX_C_LINE_COMMENT	inside a line comment continued with a
+ *				backslash
+ */
+enum
+{
+	SYNTAX_C_NORMAL = 0,
+	SYNTAX_C_COMMENT,
+	SYNTAX_C_STRING,
+	SYNTAX_C_PREPROC,
+	SYNTAX_C_LINE_COMMENT,
+};
+
+// ========================================
+// helper declaration
+// ========================================
+
+/**
+ * make room for the state of a number of lines
+ *
+ * params:
+ *	self	self pointer
+ *	n	number of lines
+ */
+int syntax_reserve(struct syntax_t *self, long n);
+
+/**
+ * move the cached states after an edit and mark the edited lines stale
+ * lines [row, row + old) became the lines [row, row + new)
+ *
+ * params:
+ *	self	self pointer
+ *	row	first edited line
+ *	old	number of lines before the edit
+ *	new	number of lines after the edit
+ */
+void syntax_edit(struct syntax_t *self, long row, long old, long new);
+
+/**
+ * colour some characters if colours are asked for
+ *
+ * params:
+ *	attr	colours of the line; NULL if only the state is wanted
+ *	start	first character
+ *	end	character after the last one
+ *	color	SCREEN_* bits
+ */
+void syntax_paint(unsigned char *attr, long start, long end, int color);
+
+/**
+ * end of a quoted literal; an escaped end of line continues it
+ *
+ * params:
+ *	src	line
+ *	len	length of the line
+ *	i	character after the opening quote
+ *	quote	closing quote
+ *	open	where it is given if the literal goes on to the next line
+ */
+long syntax_quoted(const char *src, long len, long i, char quote, int *open);
+
+/**
+ * colour of a word of c
+ *
+ * params:
+ *	src	word
+ *	len	length of the word
+ */
+int syntax_c_word(const char *src, long len);
+
+/**
+ * lex a line of c
+ *
+ * params:
+ *	state	state at the end of the line before
+ *	src	line without the '\n'
+ *	len	length of the line
+ *	attr	where the colours are put; NULL if only the state is wanted
+ */
+int syntax_lex_c(int state, const char *src, long len, unsigned char *attr);
+
+/**
+ * lex a line of json; every line starts the same
+ *
+ * params:
+ *	state	state at the end of the line before
+ *	src	line without the '\n'
+ *	len	length of the line
+ *	attr	where the colours are put
+ */
+int syntax_lex_json(int state, const char *src, long len,
+	unsigned char *attr);
+
+/**
+ * lex a line of a log; the leading timestamp and the level words are
+ * coloured
+ *
+ * params:
+ *	state	state at the end of the line before
+ *	src	line without the '\n'
+ *	len	length of the line
+ *	attr	where the colours are put
+ */
+int syntax_lex_log(int state, const char *src, long len,
+	unsigned char *attr);
+
+// ========================================
+// syntax.h - definition
+// ========================================
+
+int syntax_init(struct syntax_t *self)
+{
+	self->lang = SYNTAX_NONE;
+	self->states = NULL;
+	self->cap = 0;
+	self->valid = 0;
+	self->stale = 0;
+	self->hi = 0;
+	self->attr = NULL;
+	self->attr_cap = 0;
+	return str_init(&self->line);
+}
+
+int syntax_free(struct syntax_t *self)
+{
+	free(self->states);
+	free(self->attr);
+	str_free(&self->line);
+	return syntax_init(self);
+}
+
+int syntax_open(struct syntax_t *self, const char *path)
+{
+	static const struct
+	{
+		const char *ext;
+		int lang;
+	} exts[] = {
+		{ ".c", SYNTAX_C }, { ".h", SYNTAX_C }, { ".cc", SYNTAX_C },
+		{ ".cpp", SYNTAX_C }, { ".hpp", SYNTAX_C },
+		{ ".json", SYNTAX_JSON }, { ".log", SYNTAX_LOG },
+	};
+
+	syntax_clear(self);
+	self->lang = SYNTAX_NONE;
+	const char *ext = strrchr(path, '.');
+	if (ext == NULL || strchr(ext, '/'))
+		return NO_ERR;
+	for (int i = 0; i < (int) (sizeof(exts) / sizeof(exts[0])); i++)
+		if (strcmp(ext, exts[i].ext) == 0)
+			self->lang = exts[i].lang;
+	return NO_ERR;
+}
+
+void syntax_clear(struct syntax_t *self)
+{
+	self->valid = 0;
+	self->stale = 0;
+	self->hi = 0;
+}
+
+int syntax_update(struct syntax_t *self, struct text_t *text, long row)
+{
+	long drow = 0, old = 0, new = 0;
+	text_damage(text, &drow, &old, &new);
+
+	// only c carries a state from one line to the next
+	if (self->lang != SYNTAX_C)
+		return NO_ERR;
+	if (drow >= 0)
+		syntax_edit(self, drow, old, new);
+
+	int lines = 0;
+	text_lines(text, &lines);
+	if (row > lines)
+		row = lines;
+	if (self->stale >= row)
+		return NO_ERR;
+
+	struct text_iter_t it;
+	int err = text_iter_row(text, self->stale, &it);
+	while (!err && self->stale < row)
+	{
+		long i = self->stale;
+		int state = i ? self->states[i - 1] : SYNTAX_C_NORMAL;
+
+		const char *src = NULL;
+		long len = 0;
+		err = text_iter_line(&it, &self->line, SYNTAX_LINE, &src, &len);
+		if (err == MALLOC_ERR)
+			return err;
+		if (src)
+			state = syntax_lex_c(state, src, len, NULL);
+
+		// a line after the edits that ends the same ends the same as
+		// everything after it too
+		if (i >= self->hi && i < self->valid && self->states[i] == state)
+		{
+			self->stale = self->hi = self->valid;
+			if (self->stale < row)
+				err = text_iter_row(text, self->stale, &it);
+			continue;
+		}
+
+		err = syntax_reserve(self, i + 1);
+		if (err)
+			return err;
+		self->states[i] = state;
+		self->stale = i + 1;
+		if (self->valid < self->stale)
+			self->valid = self->stale;
+		err = NO_ERR;
+	}
+
+	// the states after the last lexed line follow from the ones it had
+	// before, so they can't be compared against any earlier
+	if (self->hi < self->stale)
+		self->hi = self->stale;
+	return NO_ERR;
+}
+
+int syntax_line(struct syntax_t *self, struct text_iter_t *it, long row,
+	const char **src, long *len, const unsigned char **attr)
+{
+	int err = text_iter_line(it, &self->line, SYNTAX_LINE, src, len);
+	if (err == MALLOC_ERR)
+		return err;
+	if (*src == NULL)
+		return RANGE_ERR;
+
+	if (*len + 1 > self->attr_cap)
+	{
+		long cap = self->attr_cap ? self->attr_cap : 256;
+		while (cap < *len + 1)
+			cap *= 2;
+		unsigned char *attr = (unsigned char *) realloc(self->attr, cap);
+		if (attr == NULL)
+			return MALLOC_ERR;
+		self->attr = attr;
+		self->attr_cap = cap;
+	}
+	memset(self->attr, 0, *len);
+	*attr = self->attr;
+
+	int state = 0;
+	if (0 < row && row <= self->stale)
+		state = self->states[row - 1];
+	if (self->lang == SYNTAX_C)
+		syntax_lex_c(state, *src, *len, self->attr);
+	else if (self->lang == SYNTAX_JSON)
+		syntax_lex_json(state, *src, *len, self->attr);
+	else if (self->lang == SYNTAX_LOG)
+		syntax_lex_log(state, *src, *len, self->attr);
+	return NO_ERR;
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+int syntax_reserve(struct syntax_t *self, long n)
+{
+	if (n <= self->cap)
+		return NO_ERR;
+	long cap = self->cap ? self->cap : 1024;
+	while (cap < n)
+		cap *= 2;
+	int *states = (int *) realloc(self->states, cap * sizeof(int));
+	if (states == NULL)
+		return MALLOC_ERR;
+	self->states = states;
+	self->cap = cap;
+	return NO_ERR;
+}
+
+void syntax_edit(struct syntax_t *self, long row, long old, long new)
+{
+	if (row >= self->valid)
+		return;
+
+	// the lines after the last stale one are compared against while
+	// lexing again; they move with the edit
+	long end = row + old;
+	if (self->stale < self->valid && self->hi >= end)
+		self->hi += new - old;
+	else
+		self->hi = row + new;
+
+	if (end < self->valid &&
+		syntax_reserve(self, self->valid + new - old) == NO_ERR)
+	{
+		memmove(self->states + row + new, self->states + end,
+			(self->valid - end) * sizeof(int));
+		self->valid += new - old;
+	}
+	else
+		self->valid = row;
+	if (self->stale > row)
+		self->stale = row;
+}
+
+void syntax_paint(unsigned char *attr, long start, long end, int color)
+{
+	if (attr && color)
+		memset(attr + start, color, end - start);
+}
+
+long syntax_quoted(const char *src, long len, long i, char quote, int *open)
+{
+	while (i < len)
+	{
+		if (src[i] == '\\')
+			i += 2;
+		else if (src[i++] == quote)
+		{
+			*open = 0;
+			return i;
+		}
+	}
+	*open = i > len;
+	return len;
+}
+
+int syntax_c_word(const char *src, long len)
+{
+	static const char *keywords[] = { "auto", "break", "case", "const",
+		"continue", "default", "do", "else", "extern", "for", "goto",
+		"if", "inline", "register", "restrict", "return", "sizeof",
+		"static", "switch", "typedef", "volatile", "while", NULL };
+	static const char *types[] = { "_Bool", "bool", "char", "double",
+		"enum", "float", "int", "long", "short", "signed", "size_t",
+		"struct", "union", "unsigned", "void", NULL };
+	static const char *consts[] = { "NULL", "false", "true", NULL };
+
+	for (int i = 0; keywords[i]; i++)
+		if ((long) strlen(keywords[i]) == len &&
+			memcmp(keywords[i], src, len) == 0)
+			return SCREEN_FG_YELLOW;
+	for (int i = 0; types[i]; i++)
+		if ((long) strlen(types[i]) == len &&
+			memcmp(types[i], src, len) == 0)
+			return SCREEN_FG_GREEN;
+	for (int i = 0; consts[i]; i++)
+		if ((long) strlen(consts[i]) == len &&
+			memcmp(consts[i], src, len) == 0)
+			return SCREEN_FG_PURPLE;
+	return 0;
+}
+
+int syntax_lex_c(int state, const char *src, long len, unsigned char *attr)
+{
+	// a preprocessor line is coloured whole apart from its comments and
+	// strings
+	int pre = state == SYNTAX_C_PREPROC;
+	if (state == SYNTAX_C_PREPROC)
+		state = SYNTAX_C_NORMAL;
+	else if (state == SYNTAX_C_NORMAL)
+	{
+		long i = 0;
+		while (i < len && (src[i] == ' ' || src[i] == '\t'))
+			i++;
+		pre = i < len && src[i] == '#';
+	}
+	int base = pre ? SCREEN_FG_BLUE : 0;
+
+	long i = 0;
+	int open = 0;
+	while (i < len)
+	{
+		long start = i;
+		int color = base;
+		unsigned char ch = src[i];
+		if (state == SYNTAX_C_COMMENT)
+		{
+			color = SCREEN_FG_CYAN;
+			const char *star = src + i;
+			while ((star = memchr(star, '*', src + len - star)) &&
+				!(star + 1 < src + len && star[1] == '/'))
+				star++;
+			i = len;
+			if (star)
+			{
+				i = star - src + 2;
+				state = SYNTAX_C_NORMAL;
+			}
+		}
+		else if (state == SYNTAX_C_LINE_COMMENT)
+		{
+			color = SCREEN_FG_CYAN;
+			i = len;
+		}
+		else if (state == SYNTAX_C_STRING)
+		{
+			color = SCREEN_FG_RED;
+			i = syntax_quoted(src, len, i, '"', &open);
+			state = open ? SYNTAX_C_STRING : SYNTAX_C_NORMAL;
+		}
+		else if (ch == '/' && i + 1 < len && src[i + 1] == '*')
+		{
+			color = SCREEN_FG_CYAN;
+			state = SYNTAX_C_COMMENT;
+			i += 2;
+		}
+		else if (ch == '/' && i + 1 < len && src[i + 1] == '/')
+		{
+			color = SCREEN_FG_CYAN;
+			state = SYNTAX_C_LINE_COMMENT;
+			i += 2;
+		}
+		else if (ch == '"')
+		{
+			color = SCREEN_FG_RED;
+			i = syntax_quoted(src, len, i + 1, '"', &open);
+			state = open ? SYNTAX_C_STRING : SYNTAX_C_NORMAL;
+		}
+		else if (ch == '\'')
+		{
+			color = SCREEN_FG_RED;
+			i = syntax_quoted(src, len, i + 1, '\'', &open);
+		}
+		else if (attr == NULL)
+		{
+			// only comments and literals change the state
+			while (i < len && src[i] != '/' && src[i] != '"' &&
+				src[i] != '\'')
+				i++;
+			if (i == start)
+				i++;
+		}
+		else if (isalnum(ch) || ch == '_')
+		{
+			while (i < len && (isalnum((unsigned char) src[i]) ||
+				src[i] == '_' || (isdigit(ch) && src[i] == '.')))
+				i++;
+			if (!pre && attr)
+				color = isdigit(ch) ? SCREEN_FG_PURPLE :
+					syntax_c_word(src + start, i - start);
+		}
+		else
+			i++;
+		syntax_paint(attr, start, i, color);
+	}
+
+	// a backslash at the end carries the line on
+	int cont = len > 0 && src[len - 1] == '\\';
+	if (state == SYNTAX_C_LINE_COMMENT && !cont)
+		state = SYNTAX_C_NORMAL;
+	if (state == SYNTAX_C_NORMAL && pre && cont)
+		state = SYNTAX_C_PREPROC;
+	return state;
+}
+
+int syntax_lex_json(int state, const char *src, long len,
+	unsigned char *attr)
+{
+	long i = 0;
+	int open = 0;
+	while (i < len)
+	{
+		long start = i;
+		int color = 0;
+		unsigned char ch = src[i];
+		if (ch == '"')
+		{
+			// keys are told apart from values by the ':' after them
+			i = syntax_quoted(src, len, i + 1, '"', &open);
+			long j = i;
+			while (j < len && (src[j] == ' ' || src[j] == '\t'))
+				j++;
+			color = j < len && src[j] == ':' ? SCREEN_FG_BLUE :
+				SCREEN_FG_GREEN;
+		}
+		else if (isdigit(ch) || ch == '-')
+		{
+			while (i < len && (isdigit((unsigned char) src[i]) ||
+				strchr("+-.eE", src[i])))
+				i++;
+			color = SCREEN_FG_PURPLE;
+		}
+		else if (isalpha(ch))
+		{
+			while (i < len && isalpha((unsigned char) src[i]))
+				i++;
+			if ((i - start == 4 && (memcmp(src + start, "true", 4) == 0 ||
+				memcmp(src + start, "null", 4) == 0)) ||
+				(i - start == 5 && memcmp(src + start, "false", 5) == 0))
+				color = SCREEN_FG_YELLOW;
+		}
+		else
+			i++;
+		syntax_paint(attr, start, i, color);
+	}
+	return state;
+}
+
+int syntax_lex_log(int state, const char *src, long len,
+	unsigned char *attr)
+{
+	static const struct
+	{
+		const char *word;
+		int color;
+	} levels[] = {
+		{ "FATAL", SCREEN_FG_RED | SCREEN_BOLD },
+		{ "PANIC", SCREEN_FG_RED | SCREEN_BOLD },
+		{ "CRITICAL", SCREEN_FG_RED | SCREEN_BOLD },
+		{ "ERROR", SCREEN_FG_RED },
+		{ "ERR", SCREEN_FG_RED },
+		{ "WARNING", SCREEN_FG_YELLOW },
+		{ "WARN", SCREEN_FG_YELLOW },
+		{ "INFO", SCREEN_FG_GREEN },
+		{ "NOTICE", SCREEN_FG_GREEN },
+		{ "DEBUG", SCREEN_FG_CYAN },
+		{ "TRACE", SCREEN_FG_CYAN },
+	};
+
+	// the leading words made of digits and separators are the timestamp
+	long i = 0;
+	while (i < len)
+	{
+		long j = i;
+		int digits = 0;
+		while (j < len && src[j] != ' ' &&
+			strchr("0123456789-:.,/TZ+[]", src[j]))
+			digits |= isdigit((unsigned char) src[j++]);
+		if (!digits || (j < len && src[j] != ' '))
+			break;
+		syntax_paint(attr, i, j, SCREEN_FG_BLUE);
+		for (i = j; i < len && src[i] == ' '; i++)
+			;
+	}
+
+	// level words in any case
+	while (i < len)
+	{
+		if (!isalpha((unsigned char) src[i]))
+		{
+			i++;
+			continue;
+		}
+		long start = i;
+		while (i < len && isalnum((unsigned char) src[i]))
+			i++;
+		for (int k = 0; k < (int) (sizeof(levels) / sizeof(levels[0]));
+			k++)
+		{
+			if ((long) strlen(levels[k].word) == i - start &&
+				strncasecmp(levels[k].word, src + start, i - start) == 0)
+			{
+				syntax_paint(attr, start, i, levels[k].color);
+				break;
+			}
+		}
+	}
+	return state;
+}
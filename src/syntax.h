@@ -0,0 +1,130 @@
+#ifndef SYNTAX_H
+#define SYNTAX_H
+
+#include "text.h"
+#include "util.h"
+
+// ========================================
+// syntax highlighting
+// ========================================
+
+/**
+ * languages; picked by the extension of the file
+ *
+ * languages:
+ *	SYNTAX_NONE	no highlighting
+ *	SYNTAX_C	.c .h .cc .cpp .hpp
+ *	SYNTAX_JSON	.json
+ *	SYNTAX_LOG	.log; levels and timestamps
+ */
+enum
+{
+	SYNTAX_NONE = 0,
+	SYNTAX_C,
+	SYNTAX_JSON,
+	SYNTAX_LOG,
+};
+
+/**
+ * lines longer than this are drawn plain and keep the state they start
+ * with
+ */
+#define SYNTAX_LINE (64 * 1024)
+
+/**
+ * highlighting of a document
+ * only the lexer state at the end of every line is kept; the visible lines
+ * are coloured again from the state they start with when they are drawn
+ * an edit makes the states from its first line stale, and they are lexed
+ * again only as far as the drawn lines need, stopping as soon as a line
+ * after the edit ends in the state it ended in before
+ *
+ * members:
+ *	lang	one of SYNTAX_*
+ *	states	lexer state at the end of every line
+ *	cap	capacity of states
+ *	valid	number of lines with a state
+ *	stale	states [0, stale) are right
+ *	hi	states [hi, valid) were right before the last edits; lexing
+ *		stops at the first of them that comes out the same
+ *	attr	colours of the last line given by syntax_line
+ *	attr_cap	capacity of attr
+ *	line	copy of a line that crosses pieces
+ */
+struct syntax_t
+{
+	int lang;
+
+	int *states;
+	long cap;
+	long valid;
+	long stale;
+	long hi;
+
+	unsigned char *attr;
+	long attr_cap;
+	struct str_t line;
+};
+
+/**
+ * initialize without highlighting
+ *
+ * params:
+ *	self	self pointer
+ */
+int syntax_init(struct syntax_t *self);
+
+/**
+ * free the highlighting
+ *
+ * params:
+ *	self	self pointer
+ */
+int syntax_free(struct syntax_t *self);
+
+/**
+ * pick the language of a file and forget the cached states
+ *
+ * params:
+ *	self	self pointer
+ *	path	name of the file
+ */
+int syntax_open(struct syntax_t *self, const char *path);
+
+/**
+ * forget the cached states; the document was replaced
+ *
+ * params:
+ *	self	self pointer
+ */
+void syntax_clear(struct syntax_t *self);
+
+/**
+ * apply the edits made since the last call and lex the lines before a
+ * row so that the state every line up to it starts with is known
+ *
+ * params:
+ *	self	self pointer
+ *	text	document
+ *	row	last line to be drawn
+ */
+int syntax_update(struct syntax_t *self, struct text_t *text, long row);
+
+/**
+ * content and colours of a line; the state of the line before it must be
+ * known from syntax_update
+ * a line longer than SYNTAX_LINE gives RANGE_ERR
+ *
+ * params:
+ *	self	self pointer
+ *	it	at the start of the line; moved to the next line
+ *	row	index of the line
+ *	src	where the content is given
+ *	len	where the length is given
+ *	attr	where the SCREEN_* bits of every character are given; valid
+ *		until the next call
+ */
+int syntax_line(struct syntax_t *self, struct text_iter_t *it, long row,
+	const char **src, long *len, const unsigned char **attr);
+
+#endif // SYNTAX_H
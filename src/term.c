@@ -1,56 +1,99 @@
+#define _GNU_SOURCE
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <termios.h>
 #include <unistd.h>
 
+#include "bufs.h"
+#include "cols.h"
+#include "input.h"
+#include "screen.h"
+#include "stats.h"
+#include "syntax.h"
 #include "term.h"
+#include "text.h"
+#include "utf8.h"
 #include "util.h"
 #include "ve.h"
+#include "win.h"
 
 // ========================================
 // global variables
 // ========================================
 
 static struct termios OLD_TERM;	// Old terminal state
-static struct ve_t GLOBAL;	// Editor global state
+static struct bufs_t BUFS;	// Open documents
+static struct ve_t *VE;		// Editor of the document being shown
+static struct wins_t WINS;	// Windows sharing the screen
 static int WS_ROWS;		// size of the terminal; rows
 static int WS_COLS;		// size of the terminal; cols
-static int OFFSET_ROW;		// cursor offset; row
-static int OFFSET_COL;		// cursor offset; column
 static int LAST_KEY;		// Last pressed key
+static struct screen_t SCREEN;	// Last frame sent and the frame being drawn
+static struct str_t FRAME;	// Output of a frame; reused by every frame
+static struct input_t INPUT;	// Bytes read from the terminal and their keys
+static struct str_t LINE;	// Visible bytes of a line crossing pieces
+static volatile sig_atomic_t RESIZED;	// Set by SIGWINCH; seen by term_run
+static sigset_t WAIT_MASK;	// Signals let through while waiting for keys
+
+/**
+ * milliseconds between frames while a file loads in the background
+ */
+#define TERM_LOAD_MS 100
 
 // ========================================
 // helper function - declaration
 // ========================================
 
 void panic(const char *msg);
-void term_init();
+void term_init(const char *filename);
 void term_free();
 void term_render();
 void term_read();
+int term_pending(int ms);
 void term_enable_raw();
 void term_enable_alt();
 void term_update_ws();
 void term_sigwinch(int);
 void term_disable_raw();
 void term_disable_alt();
-void term_render_lines(struct str_t *b);
-void term_render_line(struct str_t *b, int line);
-void term_render_status_bar(struct str_t *b);
+void term_enable_paste();
+void term_disable_paste();
+void term_render_win(struct win_t *win);
+void term_render_lines(struct win_t *win);
+void term_render_line(struct win_t *win, int line, struct text_iter_t *it);
+void term_render_wide(struct win_t *win, int row, int line_index,
+	struct text_iter_t *cur, long len);
+int term_render_text(int line, int col, int cols, const char *src, long len,
+	const unsigned char *attr, int base, long at);
+void term_render_win_status(struct win_t *win);
+void term_render_splits(struct win_t *win);
+void term_render_status_bar();
+void term_copy(struct str_t *src, char *dest, int size);
 
 // ========================================
 // term.h - definition
 // ========================================
 
-void term_run()
+void term_run(const char *filename)
 {
-	term_init();
-	while (GLOBAL.is_running)
+	term_init(filename);
+	while (VE->is_running)
 	{
+		// the size is read again between frames; the signal handler
+		// only asks for it
+		if (RESIZED)
+			term_update_ws();
+
+		// show whatever the loader threads indexed meanwhile; the
+		// hidden buffers keep loading too
+		for (int i = 0; i < BUFS.len; i++)
+			if (text_load_poll(&BUFS.list[i]->text, 0))
+				panic("text_load_poll");
 		term_render();
 		term_read();
 	}
@@ -63,172 +106,264 @@ void term_run()
 
 void panic(const char *msg)
 {
+	term_disable_paste();
 	term_disable_alt();
 	perror(msg);
 	exit(1);
 }
 
-void term_init() 
+void term_init(const char *filename) 
 {
+	// SIGWINCH is blocked but while waiting for keys, so it never lands
+	// in the middle of a frame and never slips in just before a wait; the
+	// threads started from here on inherit the block
+	sigset_t block;
+	sigemptyset(&block);
+	sigaddset(&block, SIGWINCH);
+	if (sigprocmask(SIG_BLOCK, &block, &WAIT_MASK) == -1)
+		panic("sigprocmask");
+	sigdelset(&WAIT_MASK, SIGWINCH);
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = term_sigwinch;
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(SIGWINCH, &sa, NULL) == -1)
+		panic("sigaction");
+
 	// initialize the global state
-	ve_init(&GLOBAL);
+	if (bufs_init(&BUFS))
+		panic("bufs_init");
+	VE = bufs_cur(&BUFS);
+	if (filename)
+		ve_open(VE, filename);
+	if (wins_init(&WINS, &BUFS))
+		panic("wins_init");
 
 	// initialize the cursor offsets
-	OFFSET_ROW = 0;
-	OFFSET_COL = 0;
+	VE->offset_row = 0;
+	VE->offset_col = 0;
+
+	// nothing has been drawn yet
+	screen_init(&SCREEN);
+	str_init(&FRAME);
+	input_init(&INPUT);
+	str_init(&LINE);
 	
 	// enable raw mode
 	term_enable_raw();
 	
 	// enable alt buffer
 	term_enable_alt();
+
+	// pasted text comes between markers
+	term_enable_paste();
 	
 	// update window size
 	term_update_ws();
-
-	// handle window change signal
-	signal(SIGWINCH, term_sigwinch);
 }
 
 void term_free() 
 {
 	// free the global state
-	ve_free(&GLOBAL);
+	wins_free(&WINS);
+	bufs_free(&BUFS);
+	screen_free(&SCREEN);
+	str_free(&FRAME);
+	input_free(&INPUT);
+	str_free(&LINE);
 	
 	// disable raw mode
 	term_disable_raw();
 	
+	// disable bracketed paste
+	term_disable_paste();
+
 	// disable alt mode
 	term_disable_alt();
 }
 
 void term_render() 
 {
-	struct str_t b;
-	str_init(&b);
-
-	// TODO: calculate the offsets
-	if (OFFSET_ROW > GLOBAL.crow)
-		OFFSET_ROW = GLOBAL.crow;
-	if (GLOBAL.crow > OFFSET_ROW + WS_ROWS - 1)
-		OFFSET_ROW = GLOBAL.crow - WS_ROWS + 1;
-	if (OFFSET_COL > GLOBAL.ccol)
-		OFFSET_COL = GLOBAL.ccol;
-	if (GLOBAL.ccol > OFFSET_COL + WS_COLS - 1)
-		OFFSET_COL = GLOBAL.ccol - WS_COLS + 1;
-
-	// make the cursor invisible
-	// clear the screen
-	// and go to the top left corner of screen
-	str_appends(&b, "\x1b[?25l", 6);
-	str_appends(&b, "\x1b[2J", 4);
-	str_appends(&b, "\x1b[H", 3);
-
-	// render the lines
-	term_render_lines(&b);
-
-	// render the status bar
-	term_render_status_bar(&b);
-
-	// position the cursor
+	// a frame without keys is started by the render itself
+	long start = stats_now();
+	stats_begin(&VE->stats, start);
+
+	struct str_t *b = &FRAME;
+	str_clear(b);
+
+	// the offsets keep the cursor inside the focused window; columns are
+	// display columns, and a wide character under the cursor is shown
+	// whole
+	wins_sync(&WINS);
+	struct win_t *cur = WINS.cur;
+	if (VE->offset_row > VE->crow)
+		VE->offset_row = VE->crow;
+	if (VE->crow > VE->offset_row + cur->text_rows - 1)
+		VE->offset_row = VE->crow - cur->text_rows + 1;
+	long ccol = VE->ccol, next = 0;
+	int width = 1, flags = 0;
+	text_flags(&VE->text, &flags);
+	if (flags & (SCAN_NONASCII | SCAN_TAB))
+	{
+		long line = 0;
+		text_line_start(&VE->text, VE->crow, &line);
+		cols_col(&VE->cols, &VE->text, VE->crow, VE->ccol, &ccol);
+		cols_char(&VE->text, line + VE->ccol, ccol, &next, &width);
+	}
+	if (VE->offset_col > ccol)
+		VE->offset_col = ccol;
+	if (ccol + width > VE->offset_col + cur->cols && cur->cols >= width)
+		VE->offset_col = ccol + width - cur->cols;
+	wins_sync(&WINS);
+
+	// draw the frame; the frame keeps whatever isn't drawn again
+	struct win_t *first = wins_next(&WINS, NULL, 1);
+	struct win_t *win = first;
+	do
+	{
+		term_render_win(win);
+		win = wins_next(&WINS, win, 1);
+	} while (win != first);
+	term_render_splits(WINS.root);
+	screen_blank(&SCREEN, WS_ROWS, 0, 1, WS_COLS);
+	term_render_status_bar();
+
+	// make the cursor invisible and send only what changed
+	str_appends(b, "\x1b[?25l", 6);
+	screen_flush(&SCREEN, b);
+
+	// position the cursor; inside the prompt while typing a command
 	char buffer[80];
-	snprintf(buffer, sizeof(buffer), "\x1b[%d;%dH",
-		(GLOBAL.crow - OFFSET_ROW) + 1,
-		(GLOBAL.ccol - OFFSET_COL) + 1);
-	str_appends(&b, buffer, strlen(buffer));
+	if (VE->mode == PROMPT_MODE && VE->msg.len == 0)
+	{
+		char prompt[256];
+		term_copy(&VE->prompt, prompt, sizeof(prompt));
+		int gap = VE->prompt.gap < (int) sizeof(prompt) ?
+			VE->prompt.gap : (int) sizeof(prompt) - 1;
+		snprintf(buffer, sizeof(buffer), "\x1b[%d;%ldH",
+			WS_ROWS + 1, utf8_cols(prompt, gap) + 1);
+	}
+	else
+		snprintf(buffer, sizeof(buffer), "\x1b[%d;%ldH",
+			cur->row + (VE->crow - VE->offset_row) + 1,
+			cur->col + (ccol - VE->offset_col) + 1);
+	str_appends(b, buffer, strlen(buffer));
 
 	// make the cursor visible again
-	str_appends(&b, "\x1b[?25h", 6);
+	str_appends(b, "\x1b[?25h", 6);
 	
-	// print the final render
-	write(STDOUT_FILENO, b.text, b.len);
+	// time spent building the frame
+	long built = stats_now();
+	VE->frame_ns = built - start;
+	VE->frame_ns_total += VE->frame_ns;
+	stats_add(&VE->stats, STATS_RENDER, built - start);
 
-	str_free(&b);
+	// print the final render
+	write(STDOUT_FILENO, str_cstr(b), b->len);
+	VE->frame_bytes = b->len;
+	VE->frame_total += b->len;
+	VE->frames++;
+
+	long written = stats_now();
+	stats_add(&VE->stats, STATS_WRITE, written - built);
+	stats_end(&VE->stats, written);
 }
 
 void term_read() 
 {
-	int key = 0;
-	char buffer[8] = {};
-	if (read(STDIN_FILENO, buffer, sizeof(buffer)) == -1)
-		panic("read");
-
-	// read printable buffer character
-	if (32 <= buffer[0] && buffer[0] <= 126 && buffer[1] == 0)
-		key = buffer[0];
-
-	// handle enter
-	if (buffer[0] == '\r' && buffer[1] == 0)
+	// autosaves of every buffer are due some time after a change and the
+	// progress of a loading file is redrawn every now and then
+	int wait = -1;
+	long now = stats_now();
+	for (int i = 0; i < BUFS.len; i++)
 	{
-		key = ENTER_KEY;
+		int due = -1;
+		ve_autosave(BUFS.list[i], now, &due);
+		if (due >= 0 && (wait < 0 || due < wait))
+			wait = due;
 	}
-
-	// handle tab
-	if (buffer[0] == '\t' && buffer[1] == 0)
-	{
-		key = TAB_KEY;
-	}
-
-	// handle backspace
-	if (buffer[0] == 127 && buffer[1] == 0)
+	long done = 0, total = 0;
+	text_load_progress(&VE->text, &done, &total);
+	if (total > 0 && (wait < 0 || wait > TERM_LOAD_MS))
+		wait = TERM_LOAD_MS;
+
+	// a resize ends the wait too
+	if (!term_pending(wait))
+		return;
+
+	// the first read waits for a key; everything already pending is
+	// applied in the same batch so that only one frame is rendered
+	do
 	{
-		key = BACKSPACE_KEY;
-	}
-
-	// handle esc key
-	if (buffer[0] == '\x1b' && buffer[1] == 0)
-	{
-		key = ESC_KEY;
-	}
-
-	// handle quit key
-	if (buffer[0] == '\x1b' && buffer[2] == 0)
-	{
-		switch(buffer[1])
+		char buffer[4096];
+		int len = read(STDIN_FILENO, buffer, sizeof(buffer));
+		if (len == -1 && errno != EINTR)
+			panic("read");
+
+		// the frame starts once the first bytes arrive
+		long start = stats_now();
+		if (len > 0)
+			stats_begin(&VE->stats, start);
+		if (len > 0 && input_feed(&INPUT, buffer, len))
+			panic("input_feed");
+
+		// a lone escape is final once nothing follows it shortly; the
+		// wait itself is not decoding
+		if (input_decode(&INPUT, 0))
+			panic("input_decode");
+		long end = stats_now();
+		if (INPUT.bytes.len > 0 && !term_pending(INPUT_WAIT_MS))
 		{
-		case 'q':
-			key = QUIT_KEY;
-			break;
+			start = stats_now();
+			if (input_decode(&INPUT, 1))
+				panic("input_decode");
+			end = stats_now();
 		}
-	}
+		if (len > 0)
+			stats_add(&VE->stats, STATS_DECODE, end - start);
 
-	// handle special keys
-	if (buffer[0] == '\x1b' && buffer[1] == '[' && buffer[3] == '~' &&
-		buffer[4] == 0)
-	{
-		switch(buffer[2])
+		for (int i = 0; i < INPUT.nkeys && VE->is_running; i++)
 		{
-		case '3':
-			key = DELETE_KEY;
-			break;
+			struct input_key_t *k = INPUT.keys + i;
+			struct ve_t *ve = VE;
+			start = end;
+
+			// store the last pressed key
+			LAST_KEY = k->key;
+
+			// move to the next state
+			if (k->key == PASTE_KEY)
+			{
+				const char *text = NULL;
+				int text_len = 0;
+				str_span(&INPUT.paste, k->off, &text, &text_len);
+				ve_insert(VE, text, k->len);
+			}
+			else
+				ve_next(VE, k->key);
+
+			end = stats_now();
+			stats_add(&ve->stats, STATS_KEY, end - start);
+
+			// the rest of the keys go to the buffer switched to, which
+			// times its own frames and shows in the focused window
+			VE = bufs_cur(&BUFS);
+			wins_sync(&WINS);
+			if (VE != ve)
+			{
+				stats_end(&ve->stats, end);
+				stats_begin(&VE->stats, end);
+			}
 		}
-	}
-
-	// handle arrow keys
-	if (buffer[0] == '\x1b' && buffer[1] == '[' && buffer[3] == 0)
-	{
-		switch(buffer[2])
-		{
-		case 'A':
-			key = UP_KEY;
-			break;
-		case 'B':
-			key = DOWN_KEY;
-			break;
-		case 'C':
-			key = RIGHT_KEY;
-			break;
-		case 'D':
-			key = LEFT_KEY;
-			break;
-		}
-	}
-
-	// store the last pressed key
-	LAST_KEY = key;
+		input_clear(&INPUT);
+	} while (VE->is_running && (INPUT.bytes.len > 0 || term_pending(0)));
+}
 
-	// move to the next state
-	ve_next(&GLOBAL, key);
+int term_pending(int ms)
+{
+	struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+	struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+	return ppoll(&pfd, 1, ms < 0 ? NULL : &ts, &WAIT_MASK) > 0;
 }
 
 void term_enable_raw() 
@@ -272,6 +407,7 @@ void term_enable_alt()
 void term_update_ws() 
 {
 	// get the window size
+	RESIZED = 0;
 	struct winsize ws;
 	if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1)
 		panic("ioctl");
@@ -279,14 +415,21 @@ void term_update_ws()
 
 	WS_ROWS = ws.ws_row;
 	WS_COLS = ws.ws_col;
+	if (screen_resize(&SCREEN, WS_ROWS + 1, WS_COLS))
+		panic("screen_resize");
 
-	// re-render
-	term_render();
+	// every window is placed and drawn again on the blank screen
+	wins_layout(&WINS, WS_ROWS, WS_COLS);
+
+	// room for the largest frame; the pages are only touched as far as
+	// frames reach
+	if (str_reserve(&FRAME, (WS_ROWS + 1) * WS_COLS * SCREEN_CELL_MAX + 256))
+		panic("str_reserve");
 }
 
 void term_sigwinch(int signum) 
 {
-	term_update_ws();
+	RESIZED = 1;
 }
 
 void term_disable_raw() 
@@ -300,101 +443,353 @@ void term_disable_alt()
 	write(STDOUT_FILENO, "\x1b[?1049l", 8);
 }
 
-void term_render_lines(struct str_t *b)
+void term_enable_paste() 
 {
-	for (int line = 0; line < WS_ROWS; line++)
+	write(STDOUT_FILENO, "\x1b[?2004h", 8);
+}
+
+void term_disable_paste() 
+{
+	write(STDOUT_FILENO, "\x1b[?2004l", 8);
+}
+
+void term_render_win(struct win_t *win)
+{
+	// the text is drawn again only if something it shows changed; an
+	// edit changes the version of every window showing its buffer
+	struct ve_t *ve = win->ve;
+	struct win_key_t key;
+	memset(&key, 0, sizeof(key));
+	key.ve = ve;
+	key.version = ve->text.version;
+	key.lang = ve->syntax.lang;
+	key.offset_row = win->offset_row;
+	key.offset_col = win->offset_col;
+	key.intro = ve->intro;
+	if (memcmp(&key, &win->drawn, sizeof(key)) != 0)
 	{
-		term_render_line(b, line);
+		screen_blank(&SCREEN, win->row, win->col, win->text_rows,
+			win->cols);
+		term_render_lines(win);
+		win->drawn = key;
 	}
+
+	// the status line is one row and is drawn every frame
+	if (win->text_rows < win->rows)
+		term_render_win_status(win);
 }
 
-void term_render_line(struct str_t *b, int line)
+void term_render_lines(struct win_t *win)
 {
-	int line_index = line + OFFSET_ROW;
-	
-	// move cursor to the required index
-	char buffer[80];
-	snprintf(buffer, sizeof(buffer), "\x1b[%d;1H", line + 1);
-	str_appends(b, buffer, strlen(buffer));
+	// the highlighting catches up with the edits up to the last row
+	struct ve_t *ve = win->ve;
+	syntax_update(&ve->syntax, &ve->text,
+		win->offset_row + win->text_rows - 1);
+
+	// one lookup for the first row; the rest of the rows are walked
+	struct text_iter_t it;
+	text_iter_row(&ve->text, win->offset_row, &it);
+	for (int line = 0; line < win->text_rows; line++)
+	{
+		term_render_line(win, line, &it);
+	}
+}
+
+void term_render_line(struct win_t *win, int line, struct text_iter_t *it)
+{
+	struct ve_t *ve = win->ve;
+	int line_index = line + win->offset_row;
+	int row = win->row + line;
 
 	// print ~ if there is no more text to print
-	if (line_index >= GLOBAL.sz)
+	int lines = 0;
+	text_lines(&ve->text, &lines);
+	if (line_index >= lines)
 	{
-		str_appends(b, "\x1b[35m~\x1b[m", 9);
+		screen_put(&SCREEN, row, win->col, "~", 1, SCREEN_MAGENTA);
 
-		if (line == WS_ROWS / 3 && GLOBAL.intro)
+		if (line == win->text_rows / 3 && ve->intro)
 		{
+			char buffer[80];
 			snprintf(buffer, sizeof(buffer), "ve - a visual text editor");
 			int len = strlen(buffer);
-			if (len >= WS_COLS) len = WS_COLS;
-			int padding = WS_COLS - len;
-			for (int i = 0; i < padding / 2; i++)
-				str_appendc(b, ' ');
-			str_appends(b, buffer, len);
+			if (len >= win->cols) len = win->cols;
+			int padding = win->cols - len;
+			screen_put(&SCREEN, row, win->col + padding / 2, buffer, len,
+				0);
 		}
 	}
 	else
 	{
-		struct str_t line_str = GLOBAL.lines[line_index];
-		if (line_str.len < OFFSET_COL)
+		// move the iterator to the next row; the gap is the line length
+		struct text_iter_t cur = *it;
+		int last = text_iter_next_line(it);
+		long len = it->pos - cur.pos - (last ? 0 : 1);
+
+		// past ascii or with tabs a byte is no longer a column; the first
+		// visible character is looked up in the index of the cursor line
+		// and scanned for on the other lines
+		int flags = 0;
+		text_flags(&ve->text, &flags);
+		if (flags & (SCAN_NONASCII | SCAN_TAB))
+		{
+			term_render_wide(win, row, line_index, &cur, len);
+			return;
+		}
+		if (len < win->offset_col)
 			return;
 
-		char *start = line_str.text + OFFSET_COL;
-		int upto = line_str.len - OFFSET_COL;
-		if (upto >= WS_COLS)
-			upto = WS_COLS;
-		str_appends(b, start, upto);
+		long upto = len - win->offset_col;
+		if (upto >= win->cols)
+			upto = win->cols;
+
+		// a highlighted line is coloured whole from its start
+		if (ve->syntax.lang != SYNTAX_NONE && len <= SYNTAX_LINE)
+		{
+			struct text_iter_t at = cur;
+			const char *src = NULL;
+			const unsigned char *attr = NULL;
+			if (syntax_line(&ve->syntax, &at, line_index, &src, &len,
+				&attr) == NO_ERR)
+			{
+				term_render_text(row, win->col, win->cols,
+					src + win->offset_col, upto, attr + win->offset_col, 0,
+					win->offset_col);
+				return;
+			}
+		}
+		// one lookup for the first column however many pieces it skips
+		text_iter_at(&ve->text, cur.pos + win->offset_col, &cur);
+
+		// the visible part of the line may cross several pieces; plain
+		// text needs no escaping
+		int col = win->col;
+		while (upto > 0)
+		{
+			const char *span = NULL;
+			long span_len = 0;
+			text_iter_span(&cur, &span, &span_len);
+			if (span_len > upto)
+				span_len = upto;
+			if (flags)
+				term_render_text(row, col, span_len, span, span_len, NULL,
+					0, win->offset_col + col - win->col);
+			else
+				screen_put(&SCREEN, row, col, span, span_len, 0);
+			text_iter_advance(&cur, span_len);
+			upto -= span_len;
+			col += span_len;
+		}
 	}
 }
 
-void term_render_status_bar(struct str_t *b)
+void term_render_wide(struct win_t *win, int row, int line_index,
+	struct text_iter_t *cur, long len)
 {
-	str_appends(b, "\r\n", 2);
+	struct ve_t *ve = win->ve;
+	long skip = 0, at = 0;
+	if (win->offset_col > 0)
+	{
+		if (line_index == ve->crow)
+			cols_off(&ve->cols, &ve->text, line_index, win->offset_col,
+				&skip, &at);
+		else
+			cols_seek(&ve->text, line_index, win->offset_col, &skip, &at);
 
-	// Add the mode info
-	char buffer[80];
-	if (GLOBAL.msg.len == 0)
+		// a wide character or a tab cut by the left edge isn't shown
+		if (at < win->offset_col)
+		{
+			long next = 0;
+			int width = 0;
+			cols_char(&ve->text, cur->pos + skip, at, &next, &width);
+			skip = next - cur->pos;
+			at += width;
+		}
+	}
+	if (skip >= len)
+		return;
+
+	// no character takes more than UTF8_MAX bytes a column; a few more
+	// bytes leave room for marks
+	long upto = len - skip;
+	if (upto > (long) win->cols * UTF8_MAX + 64)
+		upto = (long) win->cols * UTF8_MAX + 64;
+	int col = win->col + at - win->offset_col;
+	int cols = win->cols - (at - win->offset_col);
+
+	if (ve->syntax.lang != SYNTAX_NONE && len <= SYNTAX_LINE)
 	{
-		// get filename
-		static char *null_filename = "<NULL>";
-		char *filename = NULL;
-		if (GLOBAL.filename.len != 0)
+		struct text_iter_t from = *cur;
+		const char *src = NULL;
+		const unsigned char *attr = NULL;
+		if (syntax_line(&ve->syntax, &from, line_index, &src, &len,
+			&attr) == NO_ERR)
 		{
-			str_build(&GLOBAL.filename, &filename);
+			term_render_text(row, col, cols, src + skip, upto, attr + skip,
+				0, at);
+			return;
 		}
-		else
-			filename = null_filename;
-	
-		if (GLOBAL.mode == INSERT_MODE)
-			snprintf(buffer, sizeof(buffer), "[INSERT] - %s", filename);
-		else if (GLOBAL.mode == NORMAL_MODE)
-			snprintf(buffer, sizeof(buffer), "[NORMAL] - %s", filename);
-		else
+	}
+
+	// a character may cross pieces, so the visible bytes are copied
+	struct text_iter_t from;
+	text_iter_at(&ve->text, cur->pos + skip, &from);
+	str_clear(&LINE);
+	while (LINE.len < upto)
+	{
+		const char *span = NULL;
+		long span_len = 0;
+		if (text_iter_span(&from, &span, &span_len))
+			break;
+		if (span_len > upto - LINE.len)
+			span_len = upto - LINE.len;
+		if (str_appends(&LINE, span, span_len))
+			panic("str_appends");
+		text_iter_advance(&from, span_len);
+	}
+	term_render_text(row, col, cols, str_cstr(&LINE), LINE.len, NULL, 0,
+		at);
+}
+
+int term_render_text(int line, int col, int cols, const char *src, long len,
+	const unsigned char *attr, int base, long at)
+{
+	// printable ascii runs of one colour are copied as they are; other
+	// characters are decoded and take their display width, marks are
+	// not drawn, a tab is blank up to the next tab stop and every other
+	// byte takes one column in reverse video so that it can't move the
+	// terminal cursor
+	int c = col, end = col + cols;
+	long i = 0;
+	while (i < len && c < end)
+	{
+		unsigned char ch = src[i];
+		int a = attr ? attr[i] : base;
+		if (32 <= ch && ch <= 126)
+		{
+			long j = i + 1;
+			while (j < len && j - i < end - c && 32 <= (unsigned char) src[j]
+				&& (unsigned char) src[j] <= 126 &&
+				(attr == NULL || attr[j] == a))
+				j++;
+			screen_put(&SCREEN, line, c, src + i, j - i, a);
+			c += j - i;
+			i = j;
+			continue;
+		}
+
+		if (ch == '\t')
 		{
-			char *prompt = NULL;
-			str_build(&GLOBAL.prompt, &prompt);
-			snprintf(buffer, sizeof(buffer), "%s", prompt);
-			free(prompt);
+			int stop = c + COLS_TAB - (at + c - col) % COLS_TAB;
+			for (; c < stop && c < end; c++)
+				screen_put(&SCREEN, line, c, " ", 1, a);
+			i++;
+			continue;
 		}
 
-		// free filename
-		if (GLOBAL.filename.len != 0)
-			free(filename);
+		int cp = ch, n = 1;
+		if (ch >= 0x80)
+			n = utf8_decode(src + i, len - i, &cp);
+		int width = utf8_width(cp);
+		i += n;
+		if (cp < 0xa0)
+		{
+			char shown = ch < 32 ? '@' + ch : '?';
+			screen_put(&SCREEN, line, c, &shown, 1, SCREEN_REVERSE);
+		}
+		else if (width > 0 && c + width <= end)
+			screen_put_char(&SCREEN, line, c, cp, width, a);
+		c += width;
+	}
+	return (c < end ? c : end) - col;
+}
+
+void term_render_win_status(struct win_t *win)
+{
+	// name of the buffer; the focused window stands out
+	struct ve_t *ve = win->ve;
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer), "%s%s", ve->filename.len != 0 ?
+		str_cstr(&ve->filename) : "<NULL>", ve->dirty ? " [+]" : "");
+	int attr = SCREEN_REVERSE | (win == WINS.cur ? SCREEN_BOLD : 0);
+
+	int row = win->row + win->rows - 1;
+	int len = term_render_text(row, win->col, win->cols, buffer,
+		strlen(buffer), NULL, attr, 0);
+	memset(buffer, ' ', sizeof(buffer));
+	for (int col = len; col < win->cols; col += sizeof(buffer))
+	{
+		int n = win->cols - col;
+		if (n > (int) sizeof(buffer))
+			n = sizeof(buffer);
+		screen_put(&SCREEN, row, win->col + col, buffer, n, attr);
+	}
+}
+
+void term_render_splits(struct win_t *win)
+{
+	if (win->split == WIN_LEAF)
+		return;
+
+	// side by side windows are kept apart by a column of their own
+	if (win->split == WIN_COLS)
+	{
+		struct win_t *left = win->child[0];
+		for (int row = 0; row < win->rows; row++)
+			screen_put(&SCREEN, win->row + row, left->col + left->cols, "|",
+				1, SCREEN_REVERSE);
+	}
+	term_render_splits(win->child[0]);
+	term_render_splits(win->child[1]);
+}
+
+void term_render_status_bar()
+{
+	// Add the mode info
+	char buffer[256];
+	if (VE->msg.len == 0)
+	{
+		// get filename
+		const char *filename = VE->filename.len != 0 ?
+			str_cstr(&VE->filename) : "<NULL>";
+	
+		// a file loading in the background shows how far it got
+		char loading[32] = "";
+		long done = 0, total = 0;
+		text_load_progress(&VE->text, &done, &total);
+		if (total > 0)
+			snprintf(loading, sizeof(loading), " [loading %ld%%]",
+				done * 100 / total);
+
+		if (VE->mode == INSERT_MODE)
+			snprintf(buffer, sizeof(buffer), "[INSERT] - %s%s", filename,
+				loading);
+		else if (VE->mode == NORMAL_MODE)
+			snprintf(buffer, sizeof(buffer), "[NORMAL] - %s%s", filename,
+				loading);
+		else
+			term_copy(&VE->prompt, buffer, sizeof(buffer));
 	}
 	else
+		snprintf(buffer, sizeof(buffer), "%s", str_cstr(&VE->msg));
+	term_render_text(WS_ROWS, 0, WS_COLS, buffer, strlen(buffer), NULL,
+		SCREEN_BOLD | (VE->is_error ? SCREEN_RED_BG : 0), 0);
+}
+
+void term_copy(struct str_t *src, char *dest, int size)
+{
+	// the gap of the prompt is its cursor, so it is copied around the gap
+	// instead of being moved
+	int n = 0;
+	while (n < src->len && n < size - 1)
 	{
-		char *msg = NULL;
-		str_build(&GLOBAL.msg, &msg);
-		snprintf(buffer, sizeof(buffer), "%s", msg);
-		free(msg);
+		const char *span = NULL;
+		int span_len = 0;
+		str_span(src, n, &span, &span_len);
+		if (span_len > size - 1 - n)
+			span_len = size - 1 - n;
+		memcpy(dest + n, span, span_len);
+		n += span_len;
 	}
-	int len = strlen(buffer);
-	if (len > WS_COLS)
-		len = WS_COLS;
-
-	str_appends(b, "\x1b[1m", 4);
-	if (GLOBAL.is_error)
-		str_appends(b, "\x1b[41m", 5);
-	str_appends(b, buffer, len);
-	str_appends(b, "\x1b[m", 3);
+	dest[n] = 0;
 }
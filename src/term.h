@@ -3,7 +3,10 @@
 
 /**
  * run the terminal editor
+ *
+ * params:
+ *	filename	file to open; NULL for an empty document
  */
-void term_run();
+void term_run(const char *filename);
 
 #endif // TERM_H
@@ -0,0 +1,1792 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "pool.h"
+#include "text.h"
+#include "util.h"
+
+// ========================================
+// helper declaration
+// ========================================
+
+/**
+ * append a string to the add buffer and index its newlines
+ *
+ * params:
+ *	self	self pointer
+ *	src	string that will be appended
+ *	len	length of the string
+ */
+int text_buf_append(struct text_buf_t *self, const char *src, long len);
+
+/**
+ * read a whole file into a buffer
+ * regular files are memory mapped; pipes and the like are read
+ *
+ * params:
+ *	self	buffer that will be filled
+ *	fd	file descriptor of the file
+ */
+int text_buf_read(struct text_buf_t *self, int fd);
+
+/**
+ * find every newline of a buffer in one pass
+ *
+ * params:
+ *	self	self pointer
+ */
+int text_buf_index(struct text_buf_t *self);
+
+/**
+ * add a buffer after the others; the text owns it afterwards
+ *
+ * params:
+ *	self	self pointer
+ *	buf	buffer that will be added
+ */
+int text_buf_push(struct text_t *self, struct text_buf_t *buf);
+
+/**
+ * free the content and the newline index of a buffer
+ *
+ * params:
+ *	self	self pointer
+ */
+void text_buf_free(struct text_buf_t *self);
+
+/**
+ * number of newlines in the buffer before the given offset
+ *
+ * params:
+ *	self	self pointer
+ *	off	offset in the buffer
+ */
+long text_buf_rank(struct text_buf_t *self, long off);
+
+/**
+ * create a piece and count its newlines
+ *
+ * params:
+ *	self	text the piece belongs to
+ *	buf	buffer of the piece
+ *	start	starting offset in the buffer
+ *	len	length of the piece
+ *	res	where the piece is given
+ */
+void text_piece(struct text_t *self, int buf, long start, long len,
+	struct piece_t *res);
+
+/**
+ * find the piece containing the given offset
+ * the end of the document gives the end of the last piece
+ *
+ * params:
+ *	self	self pointer
+ *	off	byte offset; 0 <= off <= length
+ *	leaf	where the leaf of the piece is given
+ *	idx	where the index of the piece in the leaf is given
+ *	k	where the offset inside the piece is given
+ */
+void text_find(struct text_t *self, long off, struct text_node_t **leaf,
+	int *idx, long *k);
+
+/**
+ * insert a piece at the given offset
+ * a piece containing the offset is cut into two
+ *
+ * params:
+ *	self	self pointer
+ *	off	byte offset; 0 <= off <= length
+ *	piece	piece that will be inserted
+ */
+int text_insert_piece(struct text_t *self, long off, struct piece_t *piece);
+
+/**
+ * append bytes of a buffer to the end of the document
+ * the last piece is extended when the bytes follow it in the buffer
+ *
+ * params:
+ *	self	self pointer
+ *	buf	index of the buffer
+ *	start	offset of the bytes in the buffer
+ *	len	number of bytes
+ */
+int text_extend(struct text_t *self, int buf, long start, long len);
+
+/**
+ * number of newlines before a byte offset
+ *
+ * params:
+ *	self	self pointer
+ *	off	byte offset; 0 <= off <= length
+ */
+long text_rank(struct text_t *self, long off);
+
+/**
+ * merge a change of lines into the damage
+ * lines [row, row + old) became the lines [row, row + new)
+ *
+ * params:
+ *	self	self pointer
+ *	row	first changed line
+ *	old	number of lines before the change
+ *	new	number of lines after the change
+ */
+void text_damage_add(struct text_t *self, long row, long old, long new);
+
+/**
+ * write every byte of a batch of vectors; writev may stop early
+ *
+ * params:
+ *	fd	file descriptor open for writing
+ *	iov	vectors; changed while writing
+ *	n	number of vectors
+ *	res	where the number of written bytes is added
+ */
+int text_writev(int fd, struct iovec *iov, int n, long *res);
+
+/**
+ * index the blocks of a file after the first one; the loader thread
+ *
+ * params:
+ *	arg	loader
+ */
+void *text_loader_run(void *arg);
+
+/**
+ * stop the loader thread and free the loader
+ *
+ * params:
+ *	self	text being loaded
+ */
+void text_loader_stop(struct text_t *self);
+
+/**
+ * create an empty node
+ *
+ * params:
+ *	self	text owning the node
+ *	leaf	is the node a leaf
+ *	res	where the node is given
+ */
+int node_new(struct text_t *self, int leaf, struct text_node_t **res);
+
+/**
+ * recalculate the sums of a node and of every ancestor
+ *
+ * params:
+ *	node	node that was changed
+ */
+void node_fix(struct text_node_t *node);
+
+/**
+ * recalculate the sums of a node from its entries
+ *
+ * params:
+ *	node	node that was changed
+ */
+void node_sum(struct text_node_t *node);
+
+/**
+ * index of a child in its parent
+ *
+ * params:
+ *	node	child node; must not be the root
+ */
+int node_index(struct text_node_t *node);
+
+/**
+ * insert a piece into a leaf; splits the leaf when it is full
+ *
+ * params:
+ *	self	text the leaf belongs to
+ *	leaf	leaf node
+ *	idx	index where the piece is inserted
+ *	piece	piece that will be inserted
+ */
+int node_insert(struct text_t *self, struct text_node_t *leaf, int idx,
+	struct piece_t *piece);
+
+/**
+ * split a full node into two siblings
+ *
+ * params:
+ *	self	text the node belongs to
+ *	node	full node
+ */
+int node_split(struct text_t *self, struct text_node_t *node);
+
+/**
+ * remove an entry from a node and rebalance the tree
+ *
+ * params:
+ *	self	text the node belongs to
+ *	node	node that holds the entry
+ *	idx	index of the entry
+ */
+void node_remove(struct text_t *self, struct text_node_t *node, int idx);
+
+/**
+ * merge or refill a node with too few entries
+ *
+ * params:
+ *	self	text the node belongs to
+ *	node	node that lost an entry
+ */
+void node_rebalance(struct text_t *self, struct text_node_t *node);
+
+/**
+ * move entries between two neighbouring nodes
+ * the first count entries of b go to the end of a if count > 0
+ * the last -count entries of a go to the start of b otherwise
+ *
+ * params:
+ *	a	left node
+ *	b	right node
+ *	count	number of entries moved
+ */
+void node_move(struct text_node_t *a, struct text_node_t *b, int count);
+
+/**
+ * move the iterator to the start of the next piece
+ * returns 0 and leaves the iterator untouched on the last piece
+ *
+ * params:
+ *	it	self pointer
+ */
+int text_iter_step(struct text_iter_t *it);
+
+/**
+ * move the iterator to the end of the previous piece
+ * gives 0 if there is no previous piece
+ *
+ * params:
+ *	it	self pointer
+ */
+int text_iter_step_back(struct text_iter_t *it);
+
+/**
+ * first or last match of a pattern that starts in [from, to) in one pass
+ * over the bytes
+ *
+ * params:
+ *	self	self pointer
+ *	pat	pattern
+ *	plen	length of the pattern; at least 1
+ *	from	first offset a match may start at; 0 <= from < to
+ *	to	offset where matches stop starting; to <= length
+ *	last	give the last match instead of the first
+ *	win	scratch space of 2 * plen bytes
+ *	res	where the offset of the match is given; -1 if there is none
+ */
+void text_match(struct text_t *self, const char *pat, long plen, long from,
+	long to, int last, char *win, long *res);
+
+// ========================================
+// text.h - definition
+// ========================================
+
+int text_init(struct text_t *self)
+{
+	self->root = NULL;
+	pool_init(&self->nodes, sizeof(struct text_node_t), TEXT_POOL);
+	self->loader = NULL;
+	self->version = 0;
+	self->dmg_row = -1;
+	self->dmg_old = 0;
+	self->dmg_new = 0;
+	self->nbufs = 0;
+	self->bufs = (struct text_buf_t *) calloc(1, sizeof(struct text_buf_t));
+	if (self->bufs == NULL)
+		return MALLOC_ERR;
+	self->nbufs = 1;
+	return NO_ERR;
+}
+
+int text_free(struct text_t *self)
+{
+	// the thread reads the buffers until it is stopped
+	text_loader_stop(self);
+	pool_free(&self->nodes);
+	for (int i = 0; i < self->nbufs; i++)
+		text_buf_free(self->bufs + i);
+	free(self->bufs);
+	self->bufs = NULL;
+	self->nbufs = 0;
+	self->root = NULL;
+	return NO_ERR;
+}
+
+int text_insert(struct text_t *self, long off, const char *src, long len)
+{
+	if (len <= 0)
+		return NO_ERR;
+	self->version++;
+
+	struct text_buf_t *add = self->bufs + ADD_BUF;
+	long start = add->len;
+	int err = text_buf_append(add, src, len);
+	if (err)
+		return err;
+
+	// typing extends the last piece instead of adding a new one
+	if (off > 0)
+	{
+		struct text_node_t *leaf = NULL;
+		int idx = 0;
+		long k = 0;
+		text_find(self, off - 1, &leaf, &idx, &k);
+
+		struct piece_t *piece = leaf->piece + idx;
+		if (k == piece->len - 1 && piece->buf == ADD_BUF &&
+			piece->start + piece->len == start)
+		{
+			text_damage_add(self, text_rank(self, off), 1,
+				1 + text_buf_rank(add, start + len) -
+				text_buf_rank(add, start));
+			text_piece(self, ADD_BUF, piece->start, piece->len + len, piece);
+			leaf->len[idx] = piece->len;
+			leaf->lf[idx] = piece->lf;
+			node_fix(leaf);
+			return NO_ERR;
+		}
+	}
+
+	struct piece_t piece;
+	text_piece(self, ADD_BUF, start, len, &piece);
+	return text_insert_piece(self, off, &piece);
+}
+
+int text_insert_ref(struct text_t *self, long off, int buf, long start,
+	long len)
+{
+	if (len <= 0)
+		return NO_ERR;
+	if (buf < 0 || buf >= self->nbufs || start < 0 ||
+		start + len > self->bufs[buf].len)
+		return RANGE_ERR;
+
+	struct piece_t piece;
+	text_piece(self, buf, start, len, &piece);
+	return text_insert_piece(self, off, &piece);
+}
+
+int text_load(struct text_t *self, long off, const char *path, long *len,
+	long *lf)
+{
+	*len = 0;
+	*lf = 0;
+
+	int fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return IO_ERR;
+
+	struct text_buf_t buf;
+	memset(&buf, 0, sizeof(buf));
+	int err = text_buf_read(&buf, fd);
+	close(fd);
+	if (err == NO_ERR && buf.len > 0)
+		err = text_buf_index(&buf);
+	if (err || buf.len == 0)
+	{
+		text_buf_free(&buf);
+		return err;
+	}
+
+	// the file becomes a new read-only buffer
+	err = text_buf_push(self, &buf);
+	if (err)
+		return err;
+
+	// and a single piece of the document
+	struct piece_t piece;
+	text_piece(self, self->nbufs - 1, 0, buf.len, &piece);
+	err = text_insert_piece(self, off, &piece);
+	if (err)
+		return err;
+
+	*len = buf.len;
+	*lf = buf.nl.len;
+	return NO_ERR;
+}
+
+int text_load_lazy(struct text_t *self, const char *path, long *len,
+	long *lf)
+{
+	*len = 0;
+	*lf = 0;
+	long total = 0;
+	text_len(self, &total);
+
+	// small files and files other than regular ones load in one go; only
+	// one file loads in the background at a time
+	struct stat st;
+	if (self->loader || stat(path, &st) == -1 || !S_ISREG(st.st_mode) ||
+		st.st_size < TEXT_LAZY)
+		return text_load(self, total, path, len, lf);
+
+	int fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return IO_ERR;
+	struct text_buf_t buf;
+	memset(&buf, 0, sizeof(buf));
+	int err = text_buf_read(&buf, fd);
+	close(fd);
+	if (err || !buf.mapped)
+	{
+		// a file that couldn't be mapped is read again by text_load
+		text_buf_free(&buf);
+		return err ? err : text_load(self, total, path, len, lf);
+	}
+	madvise(buf.text, buf.len, MADV_SEQUENTIAL);
+	lines_init(&buf.nl, buf.len);
+
+	struct text_loader_t *loader =
+		(struct text_loader_t *) calloc(1, sizeof(struct text_loader_t));
+	if (loader)
+	{
+		loader->nblocks = (buf.len + TEXT_LOAD_BLOCK - 1) / TEXT_LOAD_BLOCK;
+		loader->blocks = (struct lines_t *) calloc(loader->nblocks,
+			sizeof(struct lines_t));
+	}
+	if (loader == NULL || loader->blocks == NULL)
+	{
+		free(loader);
+		text_buf_free(&buf);
+		return MALLOC_ERR;
+	}
+	loader->buf = self->nbufs;
+	loader->src = buf.text;
+	loader->len = buf.len;
+
+	// the first block is indexed right away so the first screen shows
+	lines_init(loader->blocks, buf.len);
+	err = lines_scan(loader->blocks, buf.text,
+		buf.len < TEXT_LOAD_BLOCK ? buf.len : TEXT_LOAD_BLOCK, 0);
+	if (err == NO_ERR)
+		err = text_buf_push(self, &buf);
+	if (err)
+	{
+		lines_free(loader->blocks);
+		free(loader->blocks);
+		free(loader);
+		text_buf_free(&buf);
+		return err;
+	}
+	loader->ready = 1;
+	pthread_mutex_init(&loader->lock, NULL);
+	pthread_cond_init(&loader->cond, NULL);
+	self->loader = loader;
+
+	// without a thread the rest is indexed before returning
+	loader->started = pthread_create(&loader->thread, NULL,
+		text_loader_run, loader) == 0;
+	if (!loader->started)
+		text_loader_run(loader);
+
+	err = text_load_poll(self, 0);
+	text_len(self, len);
+	*len -= total;
+	*lf = self->bufs[self->nbufs - 1].nl.len;
+	return err;
+}
+
+int text_load_poll(struct text_t *self, int wait)
+{
+	struct text_loader_t *loader = self->loader;
+	if (loader == NULL)
+		return NO_ERR;
+
+	pthread_mutex_lock(&loader->lock);
+	while (wait && loader->ready == loader->used && !loader->stop)
+		pthread_cond_wait(&loader->cond, &loader->lock);
+	long ready = loader->ready;
+	int err = loader->err;
+	pthread_mutex_unlock(&loader->lock);
+
+	// merge the indexes of the new blocks into the buffer
+	struct text_buf_t *buf = self->bufs + loader->buf;
+	long from = loader->used * TEXT_LOAD_BLOCK;
+	while (loader->used < ready && err == NO_ERR)
+	{
+		err = lines_append(&buf->nl, loader->blocks + loader->used);
+		if (err)
+			break;
+		lines_free(loader->blocks + loader->used);
+		loader->used++;
+	}
+
+	// and append their bytes to the document
+	long to = loader->used * TEXT_LOAD_BLOCK;
+	if (to > loader->len)
+		to = loader->len;
+	if (to > from)
+	{
+		int err2 = text_extend(self, loader->buf, from, to - from);
+		if (err == NO_ERR)
+			err = err2;
+	}
+
+	if (err || loader->used == loader->nblocks)
+		text_loader_stop(self);
+	return err;
+}
+
+int text_load_wait(struct text_t *self, long row)
+{
+	int err = NO_ERR;
+	while (self->loader && err == NO_ERR)
+	{
+		int lines = 0;
+		text_lines(self, &lines);
+		if (row >= 0 && row < lines - 1)
+			break;
+		err = text_load_poll(self, 1);
+	}
+	return err;
+}
+
+int text_load_progress(struct text_t *self, long *done, long *total)
+{
+	*done = 0;
+	*total = 0;
+	struct text_loader_t *loader = self->loader;
+	if (loader == NULL)
+		return NO_ERR;
+
+	*done = loader->used * TEXT_LOAD_BLOCK;
+	*total = loader->len;
+	if (*done > *total)
+		*done = *total;
+	return NO_ERR;
+}
+
+int text_delete(struct text_t *self, long off, long len)
+{
+	long total = 0;
+	text_len(self, &total);
+	if (off < 0 || off + len > total)
+		return RANGE_ERR;
+	self->version++;
+	long row = text_rank(self, off);
+	text_damage_add(self, row, 1 + text_rank(self, off + len) - row, 1);
+
+	while (len > 0)
+	{
+		struct text_node_t *leaf = NULL;
+		int idx = 0;
+		long k = 0;
+		text_find(self, off, &leaf, &idx, &k);
+
+		struct piece_t *piece = leaf->piece + idx;
+		if (k == 0 && len >= piece->len)
+		{
+			// the whole piece goes away
+			len -= piece->len;
+			node_remove(self, leaf, idx);
+			continue;
+		}
+
+		struct piece_t head, tail;
+		text_piece(self, piece->buf, piece->start, k, &head);
+		if (k + len < piece->len)
+		{
+			long skip = k + len;
+			text_piece(self, piece->buf, piece->start + skip,
+				piece->len - skip, &tail);
+			len = 0;
+		}
+		else
+		{
+			len -= piece->len - k;
+			tail.len = 0;
+		}
+
+		if (head.len == 0)
+			*piece = tail;
+		else
+			*piece = head;
+		leaf->len[idx] = piece->len;
+		leaf->lf[idx] = piece->lf;
+		node_fix(leaf);
+
+		// the deleted range was in the middle of the piece
+		if (head.len > 0 && tail.len > 0)
+			return node_insert(self, leaf, idx + 1, &tail);
+	}
+	return NO_ERR;
+}
+
+int text_write(struct text_t *self, int fd, long *res)
+{
+	*res = 0;
+	if (self->root == NULL)
+		return NO_ERR;
+
+	// leftmost leaf
+	struct text_node_t *leaf = self->root;
+	while (!leaf->leaf)
+		leaf = leaf->child[0];
+
+	struct iovec iov[TEXT_IOV];
+	int idx = 0;
+	while (leaf)
+	{
+		// gather as many pieces as fit
+		int n = 0;
+		for (; leaf && n < TEXT_IOV; idx++)
+		{
+			if (idx == leaf->n)
+			{
+				leaf = leaf->next;
+				idx = -1;
+				continue;
+			}
+			struct piece_t *piece = leaf->piece + idx;
+			iov[n].iov_base = self->bufs[piece->buf].text + piece->start;
+			iov[n].iov_len = piece->len;
+			n++;
+		}
+
+		int err = text_writev(fd, iov, n, res);
+		if (err)
+			return err;
+	}
+	return NO_ERR;
+}
+
+int text_snap(struct text_t *self, struct text_snap_t *res)
+{
+	memset(res, 0, sizeof(*res));
+	if (self->root == NULL)
+		return NO_ERR;
+
+	// leftmost leaf
+	struct text_node_t *first = self->root;
+	while (!first->leaf)
+		first = first->child[0];
+
+	// count the pieces and the bytes to copy first
+	long copy = 0;
+	for (struct text_node_t *leaf = first; leaf; leaf = leaf->next)
+	{
+		for (int i = 0; i < leaf->n; i++)
+			if (leaf->piece[i].buf == ADD_BUF)
+				copy += leaf->piece[i].len;
+		res->nspans += leaf->n;
+	}
+	res->spans = (struct text_span_t *) malloc(res->nspans *
+		sizeof(struct text_span_t) + 1);
+	res->copy = (char *) malloc(copy + 1);
+	if (res->spans == NULL || res->copy == NULL)
+	{
+		text_snap_free(res);
+		return MALLOC_ERR;
+	}
+
+	long n = 0;
+	copy = 0;
+	for (struct text_node_t *leaf = first; leaf; leaf = leaf->next)
+	{
+		for (int i = 0; i < leaf->n; i++)
+		{
+			struct piece_t *piece = leaf->piece + i;
+			const char *src = self->bufs[piece->buf].text + piece->start;
+			if (piece->buf == ADD_BUF)
+			{
+				memcpy(res->copy + copy, src, piece->len);
+				src = res->copy + copy;
+				copy += piece->len;
+			}
+			res->spans[n].ptr = src;
+			res->spans[n].len = piece->len;
+			res->len += piece->len;
+			n++;
+		}
+	}
+	return NO_ERR;
+}
+
+int text_snap_write(struct text_snap_t *self, int fd, long *res)
+{
+	*res = 0;
+	struct iovec iov[TEXT_IOV];
+	for (long i = 0; i < self->nspans;)
+	{
+		int n = 0;
+		for (; i < self->nspans && n < TEXT_IOV; i++, n++)
+		{
+			iov[n].iov_base = (void *) self->spans[i].ptr;
+			iov[n].iov_len = self->spans[i].len;
+		}
+		int err = text_writev(fd, iov, n, res);
+		if (err)
+			return err;
+	}
+	return NO_ERR;
+}
+
+int text_snap_free(struct text_snap_t *self)
+{
+	free(self->spans);
+	free(self->copy);
+	memset(self, 0, sizeof(*self));
+	return NO_ERR;
+}
+
+int text_len(struct text_t *self, long *res)
+{
+	*res = self->root ? self->root->sum_len : 0;
+	return NO_ERR;
+}
+
+int text_flags(struct text_t *self, int *res)
+{
+	*res = 0;
+	for (int i = 0; i < self->nbufs; i++)
+		*res |= self->bufs[i].nl.flags;
+	return NO_ERR;
+}
+
+int text_lines(struct text_t *self, int *res)
+{
+	*res = (self->root ? self->root->sum_lf : 0) + 1;
+	return NO_ERR;
+}
+
+int text_pos(struct text_t *self, long off, int *row, int *col)
+{
+	long total = 0;
+	text_len(self, &total);
+	if (off < 0 || off > total)
+		return RANGE_ERR;
+
+	long lf = text_rank(self, off);
+	long start = 0;
+	text_line_start(self, lf, &start);
+	*row = lf;
+	*col = off - start;
+	return NO_ERR;
+}
+
+int text_damage(struct text_t *self, long *row, long *old, long *new)
+{
+	*row = self->dmg_row;
+	*old = self->dmg_old;
+	*new = self->dmg_new;
+	self->dmg_row = -1;
+	self->dmg_old = 0;
+	self->dmg_new = 0;
+	return NO_ERR;
+}
+
+int text_locate(struct text_t *self, long off, int *buf, long *start)
+{
+	long total = 0;
+	text_len(self, &total);
+	if (off < 0 || off >= total)
+		return RANGE_ERR;
+
+	struct text_node_t *leaf = NULL;
+	int idx = 0;
+	long k = 0;
+	text_find(self, off, &leaf, &idx, &k);
+	*buf = leaf->piece[idx].buf;
+	*start = leaf->piece[idx].start + k;
+	return NO_ERR;
+}
+
+int text_line_start(struct text_t *self, int row, long *res)
+{
+	struct text_iter_t it;
+	int err = text_iter_row(self, row, &it);
+	if (err)
+		return err;
+	*res = it.pos;
+	return NO_ERR;
+}
+
+int text_line_len(struct text_t *self, int row, int *res)
+{
+	int lines = 0;
+	text_lines(self, &lines);
+
+	long start = 0;
+	int err = text_line_start(self, row, &start);
+	if (err)
+		return err;
+
+	long end = 0;
+	if (row == lines - 1)
+		text_len(self, &end);
+	else
+	{
+		text_line_start(self, row + 1, &end);
+		end--;
+	}
+	*res = end - start;
+	return NO_ERR;
+}
+
+int text_at(struct text_t *self, long off, char *res)
+{
+	const char *ptr = NULL;
+	long len = 0;
+	int err = text_span(self, off, &ptr, &len);
+	if (err)
+		return err;
+	*res = *ptr;
+	return NO_ERR;
+}
+
+int text_span(struct text_t *self, long off, const char **ptr, long *len)
+{
+	struct text_iter_t it;
+	int err = text_iter_at(self, off, &it);
+	if (err)
+		return err;
+	return text_iter_span(&it, ptr, len);
+}
+
+int text_search(struct text_t *self, const char *pat, long plen, long from,
+	long to, long *res)
+{
+	*res = -1;
+	long total = 0;
+	text_len(self, &total);
+	if (plen <= 0)
+		return RANGE_ERR;
+	if (from < 0)
+		from = 0;
+	if (to > total)
+		to = total;
+	if (from >= to)
+		return NO_ERR;
+
+	// short patterns keep the window on the stack
+	char buffer[256];
+	char *win = 2 * plen <= (long) sizeof(buffer) ? buffer :
+		(char *) malloc(2 * plen);
+	if (win == NULL)
+		return MALLOC_ERR;
+	text_match(self, pat, plen, from, to, 0, win, res);
+	if (win != buffer)
+		free(win);
+	return NO_ERR;
+}
+
+int text_search_back(struct text_t *self, const char *pat, long plen,
+	long from, long to, long *res)
+{
+	*res = -1;
+	if (from < 0)
+		from = 0;
+
+	long total = 0;
+	text_len(self, &total);
+	if (plen <= 0)
+		return RANGE_ERR;
+	if (to > total)
+		to = total;
+	if (from >= to)
+		return NO_ERR;
+
+	char buffer[256];
+	char *win = 2 * plen <= (long) sizeof(buffer) ? buffer :
+		(char *) malloc(2 * plen);
+	if (win == NULL)
+		return MALLOC_ERR;
+
+	// search blocks from the end; the last match of a block wins
+	// the blocks start small so that a match close by is found quickly
+	long block = 4096;
+	for (long end = to; end > from && *res < 0;)
+	{
+		long start = end - block > from ? end - block : from;
+		text_match(self, pat, plen, start, end, 1, win, res);
+		end = start;
+		if (block < TEXT_SEARCH_BLOCK)
+			block *= 2;
+	}
+	if (win != buffer)
+		free(win);
+	return NO_ERR;
+}
+
+int text_iter_at(struct text_t *self, long pos, struct text_iter_t *it)
+{
+	long total = 0;
+	text_len(self, &total);
+	if (pos < 0 || pos > total)
+		return RANGE_ERR;
+
+	it->text = self;
+	it->pos = pos;
+	text_find(self, pos, &it->leaf, &it->idx, &it->off);
+	return NO_ERR;
+}
+
+int text_iter_row(struct text_t *self, int row, struct text_iter_t *it)
+{
+	int lines = 0;
+	text_lines(self, &lines);
+	if (row < 0 || row >= lines)
+		return RANGE_ERR;
+	if (row == 0)
+		return text_iter_at(self, 0, it);
+
+	// walk down to the piece holding the row-th newline
+	long base = 0;
+	long r = row;
+	struct text_node_t *node = self->root;
+	int i = 0;
+	while (1)
+	{
+		for (i = 0; i < node->n - 1 && r > node->lf[i]; i++)
+		{
+			r -= node->lf[i];
+			base += node->len[i];
+		}
+		if (node->leaf)
+			break;
+		node = node->child[i];
+	}
+
+	struct piece_t *piece = node->piece + i;
+	struct text_buf_t *buf = self->bufs + piece->buf;
+	long nl = lines_get(&buf->nl, text_buf_rank(buf, piece->start) + r - 1);
+
+	it->text = self;
+	it->leaf = node;
+	it->idx = i;
+	it->off = nl - piece->start + 1;
+	it->pos = base + it->off;
+
+	// the line starts at the beginning of the next piece
+	if (it->off == piece->len)
+		text_iter_step(it);
+	return NO_ERR;
+}
+
+int text_iter_span(struct text_iter_t *it, const char **ptr, long *len)
+{
+	if (it->leaf == NULL || it->leaf->n == 0)
+		return RANGE_ERR;
+
+	struct piece_t *piece = it->leaf->piece + it->idx;
+	if (it->off >= piece->len)
+		return RANGE_ERR;
+
+	*ptr = it->text->bufs[piece->buf].text + piece->start + it->off;
+	*len = piece->len - it->off;
+	return NO_ERR;
+}
+
+int text_iter_advance(struct text_iter_t *it, long n)
+{
+	if (it->leaf == NULL || it->leaf->n == 0)
+		return RANGE_ERR;
+
+	while (n > 0)
+	{
+		long left = it->leaf->piece[it->idx].len - it->off;
+		if (n < left)
+		{
+			it->off += n;
+			it->pos += n;
+			return NO_ERR;
+		}
+
+		n -= left;
+		it->off += left;
+		it->pos += left;
+		if (!text_iter_step(it))
+			return n ? RANGE_ERR : NO_ERR;
+	}
+	return NO_ERR;
+}
+
+int text_iter_span_back(struct text_iter_t *it, const char **ptr, long *len)
+{
+	if (it->leaf == NULL || it->leaf->n == 0)
+		return RANGE_ERR;
+
+	// at the start of a piece the span is the whole previous piece
+	struct text_iter_t prev = *it;
+	if (prev.off == 0 && !text_iter_step_back(&prev))
+		return RANGE_ERR;
+
+	struct piece_t *piece = prev.leaf->piece + prev.idx;
+	*ptr = it->text->bufs[piece->buf].text + piece->start;
+	*len = prev.off;
+	return NO_ERR;
+}
+
+int text_iter_retreat(struct text_iter_t *it, long n)
+{
+	if (it->leaf == NULL || it->leaf->n == 0)
+		return RANGE_ERR;
+
+	while (n > 0)
+	{
+		if (n <= it->off)
+		{
+			it->off -= n;
+			it->pos -= n;
+			return NO_ERR;
+		}
+
+		n -= it->off;
+		it->pos -= it->off;
+		it->off = 0;
+		if (!text_iter_step_back(it))
+			return RANGE_ERR;
+	}
+	return NO_ERR;
+}
+
+int text_iter_line(struct text_iter_t *it, struct str_t *buf, long max,
+	const char **ptr, long *len)
+{
+	// most lines end inside the piece they start in
+	const char *span = "";
+	long span_len = 0;
+	text_iter_span(it, &span, &span_len);
+	long look = span_len <= max ? span_len : max + 1;
+	const char *nl = memchr(span, '\n', look);
+	if (nl)
+	{
+		*ptr = span;
+		*len = nl - span;
+		return text_iter_advance(it, *len + 1);
+	}
+
+	struct text_iter_t cur = *it;
+	int err = text_iter_next_line(it);
+	*len = it->pos - cur.pos - (err ? 0 : 1);
+	*ptr = *len > max ? NULL : span;
+	if (*len > max || span_len >= *len)
+		return err;
+
+	// the line crosses pieces
+	str_clear(buf);
+	for (long done = 0; done < *len; done += span_len)
+	{
+		text_iter_span(&cur, &span, &span_len);
+		if (span_len > *len - done)
+			span_len = *len - done;
+		if (str_appends(buf, span, span_len))
+			return MALLOC_ERR;
+		text_iter_advance(&cur, span_len);
+	}
+	*ptr = str_cstr(buf);
+	return err;
+}
+
+int text_iter_next_line(struct text_iter_t *it)
+{
+	if (it->leaf == NULL || it->leaf->n == 0)
+		return RANGE_ERR;
+
+	for (int steps = 0; steps < TEXT_LINE_STEPS; steps++)
+	{
+		struct piece_t *piece = it->leaf->piece + it->idx;
+		if (piece->lf > 0)
+		{
+			struct text_buf_t *buf = it->text->bufs + piece->buf;
+			long r = text_buf_rank(buf, piece->start + it->off);
+			long nl = r < buf->nl.len ? lines_get(&buf->nl, r) : -1;
+			if (nl != -1 && nl < piece->start + piece->len)
+				return text_iter_advance(it, nl - piece->start - it->off + 1);
+		}
+
+		// no newline in the rest of the piece
+		it->pos += piece->len - it->off;
+		it->off = piece->len;
+		if (!text_iter_step(it))
+			return RANGE_ERR;
+	}
+
+	// a long line made of many pieces ends at the start of the next row
+	long row = text_rank(it->text, it->pos);
+	int lines = 0;
+	text_lines(it->text, &lines);
+	if (row + 1 < lines)
+		return text_iter_row(it->text, row + 1, it);
+	long total = 0;
+	text_len(it->text, &total);
+	text_iter_at(it->text, total, it);
+	return RANGE_ERR;
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+void text_match(struct text_t *self, const char *pat, long plen, long from,
+	long to, int last, char *win, long *res)
+{
+	*res = -1;
+	long total = 0;
+	text_len(self, &total);
+
+	// a match starting before to may end plen - 1 bytes after it
+	long limit = to + plen - 1 < total ? to + plen - 1 : total;
+
+	// the last plen - 1 bytes of the previous spans and the first plen - 1
+	// bytes of the next span hold the matches crossing a piece boundary
+	long carry = 0;
+
+	struct text_iter_t it;
+	text_iter_at(self, from, &it);
+	long pos = from;
+	while (pos < limit)
+	{
+		const char *span = NULL;
+		long span_len = 0;
+		text_iter_span(&it, &span, &span_len);
+		if (span_len > limit - pos)
+			span_len = limit - pos;
+
+		// the matches come in order, so a later one replaces an earlier
+		// one; mem_find goes on from after the last hit
+		if (carry > 0)
+		{
+			long n = span_len < plen - 1 ? span_len : plen - 1;
+			memcpy(win + carry, span, n);
+			for (long at = 0; at < carry;)
+			{
+				long r = mem_find(win + at, carry + n - at, pat, plen);
+				if (r < 0 || at + r >= carry)
+					break;
+				*res = pos - carry + at + r;
+				if (!last)
+					return;
+				at += r + 1;
+			}
+		}
+
+		for (long at = 0; at < span_len;)
+		{
+			long r = mem_find(span + at, span_len - at, pat, plen);
+			if (r < 0)
+				break;
+			*res = pos + at + r;
+			if (!last)
+				return;
+			at += r + 1;
+		}
+
+		// keep the last plen - 1 bytes
+		if (span_len >= plen - 1)
+		{
+			carry = plen - 1;
+			memcpy(win, span + span_len - carry, carry);
+		}
+		else
+		{
+			long keep = carry + span_len > plen - 1 ?
+				plen - 1 - span_len : carry;
+			memmove(win, win + carry - keep, keep);
+			memcpy(win + keep, span, span_len);
+			carry = keep + span_len;
+		}
+
+		pos += span_len;
+		text_iter_advance(&it, span_len);
+	}
+}
+
+int text_buf_append(struct text_buf_t *self, const char *src, long len)
+{
+	if (self->len + len > self->cap)
+	{
+		long new_cap = (self->cap + 1) * 2;
+		if (new_cap < self->len + len)
+			new_cap = self->len + len;
+		char *text = (char *) realloc(self->text, new_cap * sizeof(char));
+		if (text == NULL)
+			return MALLOC_ERR;
+		self->text = text;
+		self->cap = new_cap;
+	}
+
+	int err = lines_scan(&self->nl, src, len, self->len);
+	if (err)
+		return err;
+
+	memcpy(self->text + self->len, src, len);
+	self->len += len;
+	return NO_ERR;
+}
+
+int text_buf_read(struct text_buf_t *self, int fd)
+{
+	struct stat st;
+	if (fstat(fd, &st) == -1)
+		return IO_ERR;
+
+	if (S_ISREG(st.st_mode) && st.st_size > 0)
+	{
+		void *text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (text != MAP_FAILED)
+		{
+			self->text = (char *) text;
+			self->len = st.st_size;
+			self->cap = st.st_size;
+			self->mapped = 1;
+			return NO_ERR;
+		}
+	}
+
+	// fall back to reading large blocks
+	while (1)
+	{
+		if (self->len == self->cap)
+		{
+			long new_cap = self->cap ? self->cap * 2 : (1 << 20);
+			char *text = (char *) realloc(self->text, new_cap);
+			if (text == NULL)
+				return MALLOC_ERR;
+			self->text = text;
+			self->cap = new_cap;
+		}
+
+		ssize_t n = read(fd, self->text + self->len, self->cap - self->len);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n == -1)
+			return IO_ERR;
+		if (n == 0)
+			break;
+		self->len += n;
+	}
+	return NO_ERR;
+}
+
+int text_buf_index(struct text_buf_t *self)
+{
+	if (self->mapped)
+		madvise(self->text, self->len, MADV_SEQUENTIAL);
+
+	lines_init(&self->nl, self->len);
+	return lines_scan(&self->nl, self->text, self->len, 0);
+}
+
+int text_buf_push(struct text_t *self, struct text_buf_t *buf)
+{
+	struct text_buf_t *bufs = (struct text_buf_t *) realloc(self->bufs,
+		(self->nbufs + 1) * sizeof(struct text_buf_t));
+	if (bufs == NULL)
+	{
+		text_buf_free(buf);
+		return MALLOC_ERR;
+	}
+	self->bufs = bufs;
+	self->bufs[self->nbufs] = *buf;
+	self->nbufs++;
+	return NO_ERR;
+}
+
+void text_buf_free(struct text_buf_t *self)
+{
+	if (self->mapped)
+		munmap(self->text, self->len);
+	else
+		free(self->text);
+	lines_free(&self->nl);
+	memset(self, 0, sizeof(*self));
+}
+
+long text_buf_rank(struct text_buf_t *self, long off)
+{
+	return lines_rank(&self->nl, off);
+}
+
+void text_piece(struct text_t *self, int buf, long start, long len,
+	struct piece_t *res)
+{
+	struct text_buf_t *b = self->bufs + buf;
+	res->buf = buf;
+	res->start = start;
+	res->len = len;
+	res->lf = len ? text_buf_rank(b, start + len) - text_buf_rank(b, start) : 0;
+}
+
+void text_find(struct text_t *self, long off, struct text_node_t **leaf,
+	int *idx, long *k)
+{
+	struct text_node_t *node = self->root;
+	int i = 0;
+	while (node)
+	{
+		for (i = 0; i < node->n - 1 && off >= node->len[i]; i++)
+			off -= node->len[i];
+		if (node->leaf)
+			break;
+		node = node->child[i];
+	}
+	*leaf = node;
+	*idx = i;
+	*k = off;
+}
+
+int text_insert_piece(struct text_t *self, long off, struct piece_t *piece)
+{
+	self->version++;
+	text_damage_add(self, text_rank(self, off), 1, 1 + piece->lf);
+	if (self->root == NULL)
+	{
+		int err = node_new(self, 1, &self->root);
+		if (err)
+			return err;
+	}
+
+	struct text_node_t *leaf = NULL;
+	int idx = 0;
+	long k = 0;
+	text_find(self, off, &leaf, &idx, &k);
+	if (leaf->n == 0)
+		return node_insert(self, leaf, 0, piece);
+
+	struct piece_t *cur = leaf->piece + idx;
+	if (k == 0)
+		return node_insert(self, leaf, idx, piece);
+	if (k == cur->len)
+		return node_insert(self, leaf, idx + 1, piece);
+
+	// cut the piece and insert between the two halves
+	struct piece_t head, tail;
+	text_piece(self, cur->buf, cur->start, k, &head);
+	text_piece(self, cur->buf, cur->start + k, cur->len - k, &tail);
+	*cur = head;
+	leaf->len[idx] = head.len;
+	leaf->lf[idx] = head.lf;
+	node_fix(leaf);
+	int err = node_insert(self, leaf, idx + 1, &tail);
+	if (err)
+		return err;
+
+	// the leaf may have been split; look the offset up again
+	text_find(self, off, &leaf, &idx, &k);
+	return node_insert(self, leaf, k == 0 ? idx : idx + 1, piece);
+}
+
+int text_extend(struct text_t *self, int buf, long start, long len)
+{
+	self->version++;
+	long total = 0;
+	text_len(self, &total);
+	if (total > 0)
+	{
+		struct text_node_t *leaf = NULL;
+		int idx = 0;
+		long k = 0;
+		text_find(self, total - 1, &leaf, &idx, &k);
+
+		struct piece_t *piece = leaf->piece + idx;
+		if (piece->buf == buf && piece->start + piece->len == start)
+		{
+			struct text_buf_t *b = self->bufs + buf;
+			text_damage_add(self, text_rank(self, total), 1,
+				1 + text_buf_rank(b, start + len) - text_buf_rank(b, start));
+			text_piece(self, buf, piece->start, piece->len + len, piece);
+			leaf->len[idx] = piece->len;
+			leaf->lf[idx] = piece->lf;
+			node_fix(leaf);
+			return NO_ERR;
+		}
+	}
+	return text_insert_ref(self, total, buf, start, len);
+}
+
+long text_rank(struct text_t *self, long off)
+{
+	// newlines of every entry before the offset
+	long lf = 0, rest = off;
+	struct text_node_t *node = self->root;
+	int i = 0;
+	while (node)
+	{
+		for (i = 0; i < node->n - 1 && rest >= node->len[i]; i++)
+		{
+			rest -= node->len[i];
+			lf += node->lf[i];
+		}
+		if (node->leaf)
+			break;
+		node = node->child[i];
+	}
+	if (node && node->n > 0)
+	{
+		struct piece_t *piece = node->piece + i;
+		struct text_buf_t *b = self->bufs + piece->buf;
+		lf += text_buf_rank(b, piece->start + rest) -
+			text_buf_rank(b, piece->start);
+	}
+	return lf;
+}
+
+void text_damage_add(struct text_t *self, long row, long old, long new)
+{
+	if (self->dmg_row < 0)
+	{
+		self->dmg_row = row;
+		self->dmg_old = old;
+		self->dmg_new = new;
+		return;
+	}
+
+	// union of both ranges in the current numbering; the part of it that
+	// wasn't damaged yet maps one to one
+	long start = row < self->dmg_row ? row : self->dmg_row;
+	long end = self->dmg_row + self->dmg_new;
+	if (row + old > end)
+		end = row + old;
+	self->dmg_old = end - start - (self->dmg_new - self->dmg_old);
+	self->dmg_new = end - start + (new - old);
+	self->dmg_row = start;
+}
+
+int text_writev(int fd, struct iovec *iov, int n, long *res)
+{
+	// resume from where writev stopped
+	struct iovec *cur = iov;
+	while (n > 0)
+	{
+		ssize_t written = writev(fd, cur, n);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return IO_ERR;
+		*res += written;
+		while (n > 0 && (size_t) written >= cur->iov_len)
+		{
+			written -= cur->iov_len;
+			cur++;
+			n--;
+		}
+		if (n > 0)
+		{
+			cur->iov_base = (char *) cur->iov_base + written;
+			cur->iov_len -= written;
+		}
+	}
+	return NO_ERR;
+}
+
+void *text_loader_run(void *arg)
+{
+	struct text_loader_t *self = (struct text_loader_t *) arg;
+	for (long i = 1; i < self->nblocks; i++)
+	{
+		long start = i * TEXT_LOAD_BLOCK;
+		long len = self->len - start;
+		if (len > TEXT_LOAD_BLOCK)
+			len = TEXT_LOAD_BLOCK;
+
+		// the page faults of the mapping are taken here, not in the ui
+		lines_init(self->blocks + i, self->len);
+		int err = lines_scan(self->blocks + i, self->src + start, len, start);
+
+		pthread_mutex_lock(&self->lock);
+		if (err)
+		{
+			self->err = err;
+			self->stop = 1;
+		}
+		else
+			self->ready = i + 1;
+		int stop = self->stop;
+		pthread_cond_signal(&self->cond);
+		pthread_mutex_unlock(&self->lock);
+		if (stop)
+			break;
+	}
+	return NULL;
+}
+
+void text_loader_stop(struct text_t *self)
+{
+	struct text_loader_t *loader = self->loader;
+	if (loader == NULL)
+		return;
+
+	pthread_mutex_lock(&loader->lock);
+	loader->stop = 1;
+	pthread_mutex_unlock(&loader->lock);
+	if (loader->started)
+		pthread_join(loader->thread, NULL);
+
+	for (long i = loader->used; i < loader->nblocks; i++)
+		lines_free(loader->blocks + i);
+	pthread_mutex_destroy(&loader->lock);
+	pthread_cond_destroy(&loader->cond);
+	free(loader->blocks);
+	free(loader);
+	self->loader = NULL;
+}
+
+int node_new(struct text_t *self, int leaf, struct text_node_t **res)
+{
+	struct text_node_t *node = NULL;
+	int err = pool_get(&self->nodes, (void **) &node);
+	if (err)
+		return err;
+	node->leaf = leaf;
+	*res = node;
+	return NO_ERR;
+}
+
+void node_fix(struct text_node_t *node)
+{
+	while (node)
+	{
+		node_sum(node);
+		struct text_node_t *parent = node->parent;
+		if (parent)
+		{
+			int i = node_index(node);
+			parent->len[i] = node->sum_len;
+			parent->lf[i] = node->sum_lf;
+		}
+		node = parent;
+	}
+}
+
+void node_sum(struct text_node_t *node)
+{
+	node->sum_len = 0;
+	node->sum_lf = 0;
+	for (int i = 0; i < node->n; i++)
+	{
+		node->sum_len += node->len[i];
+		node->sum_lf += node->lf[i];
+	}
+}
+
+int node_index(struct text_node_t *node)
+{
+	struct text_node_t *parent = node->parent;
+	int i = 0;
+	while (parent->child[i] != node)
+		i++;
+	return i;
+}
+
+int node_insert(struct text_t *self, struct text_node_t *leaf, int idx,
+	struct piece_t *piece)
+{
+	int n = leaf->n - idx;
+	memmove(leaf->piece + idx + 1, leaf->piece + idx, n * sizeof(*piece));
+	memmove(leaf->len + idx + 1, leaf->len + idx, n * sizeof(long));
+	memmove(leaf->lf + idx + 1, leaf->lf + idx, n * sizeof(long));
+	leaf->piece[idx] = *piece;
+	leaf->len[idx] = piece->len;
+	leaf->lf[idx] = piece->lf;
+	leaf->n++;
+	node_fix(leaf);
+
+	if (leaf->n == TEXT_ORDER)
+		return node_split(self, leaf);
+	return NO_ERR;
+}
+
+int node_split(struct text_t *self, struct text_node_t *node)
+{
+	struct text_node_t *sib = NULL;
+	int err = node_new(self, node->leaf, &sib);
+	if (err)
+		return err;
+
+	// the new sibling takes the upper half of the entries
+	node_move(node, sib, -(node->n / 2));
+	if (node->leaf)
+	{
+		sib->prev = node;
+		sib->next = node->next;
+		if (node->next)
+			node->next->prev = sib;
+		node->next = sib;
+	}
+
+	struct text_node_t *parent = node->parent;
+	if (parent == NULL)
+	{
+		// grow the tree by one level
+		err = node_new(self, 0, &parent);
+		if (err)
+			return err;
+		parent->n = 1;
+		parent->child[0] = node;
+		node->parent = parent;
+		self->root = parent;
+	}
+
+	int i = node_index(node) + 1;
+	int n = parent->n - i;
+	memmove(parent->child + i + 1, parent->child + i, n * sizeof(sib));
+	memmove(parent->len + i + 1, parent->len + i, n * sizeof(long));
+	memmove(parent->lf + i + 1, parent->lf + i, n * sizeof(long));
+	parent->child[i] = sib;
+	parent->len[i - 1] = node->sum_len;
+	parent->lf[i - 1] = node->sum_lf;
+	parent->len[i] = sib->sum_len;
+	parent->lf[i] = sib->sum_lf;
+	parent->n++;
+	sib->parent = parent;
+	node_sum(parent);
+
+	if (parent->n == TEXT_ORDER)
+		return node_split(self, parent);
+	return NO_ERR;
+}
+
+void node_remove(struct text_t *self, struct text_node_t *node, int idx)
+{
+	int n = node->n - idx - 1;
+	memmove(node->piece + idx, node->piece + idx + 1,
+		n * sizeof(struct piece_t));
+	memmove(node->child + idx, node->child + idx + 1, n * sizeof(node));
+	memmove(node->len + idx, node->len + idx + 1, n * sizeof(long));
+	memmove(node->lf + idx, node->lf + idx + 1, n * sizeof(long));
+	node->n--;
+	node_fix(node);
+	node_rebalance(self, node);
+}
+
+void node_rebalance(struct text_t *self, struct text_node_t *node)
+{
+	struct text_node_t *parent = node->parent;
+	if (parent == NULL)
+	{
+		// drop a root that has a single child
+		if (!node->leaf && node->n == 1)
+		{
+			self->root = node->child[0];
+			self->root->parent = NULL;
+			pool_put(&self->nodes, node);
+		}
+		return;
+	}
+	if (node->n >= TEXT_ORDER / 4 || parent->n < 2)
+		return;
+
+	// pair the node with a neighbour under the same parent
+	int i = node_index(node);
+	if (i == parent->n - 1)
+		i--;
+	struct text_node_t *a = parent->child[i];
+	struct text_node_t *b = parent->child[i + 1];
+
+	if (a->n + b->n < TEXT_ORDER)
+	{
+		// merge b into a
+		node_move(a, b, b->n);
+		if (a->leaf)
+		{
+			a->next = b->next;
+			if (b->next)
+				b->next->prev = a;
+		}
+		pool_put(&self->nodes, b);
+		parent->len[i] = a->sum_len;
+		parent->lf[i] = a->sum_lf;
+		parent->child[i + 1] = NULL;
+		node_remove(self, parent, i + 1);
+		return;
+	}
+
+	// refill the smaller node from the bigger one
+	int count = (b->n - a->n) / 2;
+	node_move(a, b, count);
+	parent->len[i] = a->sum_len;
+	parent->lf[i] = a->sum_lf;
+	parent->len[i + 1] = b->sum_len;
+	parent->lf[i + 1] = b->sum_lf;
+}
+
+void node_move(struct text_node_t *a, struct text_node_t *b, int count)
+{
+	if (count > 0)
+	{
+		int rest = b->n - count;
+		memcpy(a->piece + a->n, b->piece, count * sizeof(struct piece_t));
+		memcpy(a->child + a->n, b->child, count * sizeof(a));
+		memcpy(a->len + a->n, b->len, count * sizeof(long));
+		memcpy(a->lf + a->n, b->lf, count * sizeof(long));
+		memmove(b->piece, b->piece + count, rest * sizeof(struct piece_t));
+		memmove(b->child, b->child + count, rest * sizeof(a));
+		memmove(b->len, b->len + count, rest * sizeof(long));
+		memmove(b->lf, b->lf + count, rest * sizeof(long));
+		a->n += count;
+		b->n = rest;
+	}
+	else if (count < 0)
+	{
+		count = -count;
+		int from = a->n - count;
+		memmove(b->piece + count, b->piece, b->n * sizeof(struct piece_t));
+		memmove(b->child + count, b->child, b->n * sizeof(a));
+		memmove(b->len + count, b->len, b->n * sizeof(long));
+		memmove(b->lf + count, b->lf, b->n * sizeof(long));
+		memcpy(b->piece, a->piece + from, count * sizeof(struct piece_t));
+		memcpy(b->child, a->child + from, count * sizeof(a));
+		memcpy(b->len, a->len + from, count * sizeof(long));
+		memcpy(b->lf, a->lf + from, count * sizeof(long));
+		a->n = from;
+		b->n += count;
+	}
+
+	// children that moved get a new parent
+	if (!a->leaf)
+	{
+		for (int i = 0; i < a->n; i++)
+			a->child[i]->parent = a;
+		for (int i = 0; i < b->n; i++)
+			b->child[i]->parent = b;
+	}
+	node_sum(a);
+	node_sum(b);
+}
+
+int text_iter_step(struct text_iter_t *it)
+{
+	struct text_node_t *leaf = it->leaf;
+	int idx = it->idx + 1;
+	if (idx == leaf->n)
+	{
+		leaf = leaf->next;
+		idx = 0;
+		if (leaf == NULL)
+			return 0;
+	}
+	it->leaf = leaf;
+	it->idx = idx;
+	it->off = 0;
+	return 1;
+}
+
+int text_iter_step_back(struct text_iter_t *it)
+{
+	struct text_node_t *leaf = it->leaf;
+	int idx = it->idx - 1;
+	if (idx < 0)
+	{
+		leaf = leaf->prev;
+		if (leaf == NULL)
+			return 0;
+		idx = leaf->n - 1;
+	}
+	it->leaf = leaf;
+	it->idx = idx;
+	it->off = leaf->piece[idx].len;
+	return 1;
+}
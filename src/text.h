@@ -0,0 +1,621 @@
+#ifndef TEXT_H
+#define TEXT_H
+
+#include <pthread.h>
+
+#include "pool.h"
+#include "util.h"
+
+// ========================================
+// piece table
+// ========================================
+
+/**
+ * index of the add buffer; every other buffer is a loaded file
+ */
+#define ADD_BUF 0
+
+/**
+ * buffer referenced by the pieces
+ * the add buffer is append-only, loaded files are read-only
+ *
+ * members:
+ *	text	content of the buffer
+ *	len	length of the content
+ *	cap	capacity of the content
+ *	mapped	is the content a memory mapped file
+ *	nl	offsets of every '\n' and the kinds of bytes in the content
+ */
+struct text_buf_t
+{
+	char *text;
+	long len;
+	long cap;
+	int mapped;
+
+	struct lines_t nl;
+};
+
+/**
+ * maximum number of entries in a node of the piece tree
+ */
+#define TEXT_ORDER 32
+
+/**
+ * number of nodes of the piece tree allocated together
+ */
+#define TEXT_POOL 64
+
+/**
+ * piece of the document
+ *
+ * members:
+ *	buf	index of the buffer of the piece
+ *	start	starting offset of the piece in the buffer
+ *	len	length of the piece
+ *	lf	number of newlines in the piece
+ */
+struct piece_t
+{
+	int buf;
+	long start;
+	long len;
+	long lf;
+};
+
+/**
+ * node of the counted b-tree of pieces
+ * entry i of a node is piece[i] in a leaf and child[i] otherwise
+ *
+ * members:
+ *	leaf	is the node a leaf
+ *	n	number of entries
+ *	len	number of bytes under each entry
+ *	lf	number of newlines under each entry
+ *	sum_len	number of bytes under the node
+ *	sum_lf	number of newlines under the node
+ *	parent	parent node; NULL for the root
+ *	prev	previous leaf; leaves only
+ *	next	next leaf; leaves only
+ *	child	children; inner nodes only
+ *	piece	pieces in document order; leaves only
+ */
+struct text_node_t
+{
+	int leaf;
+	int n;
+	long len[TEXT_ORDER];
+	long lf[TEXT_ORDER];
+	long sum_len;
+	long sum_lf;
+
+	struct text_node_t *parent;
+	struct text_node_t *prev;
+	struct text_node_t *next;
+	struct text_node_t *child[TEXT_ORDER];
+	struct piece_t piece[TEXT_ORDER];
+};
+
+/**
+ * files at least this big are indexed in the background by text_load_lazy
+ */
+#define TEXT_LAZY (64L << 20)
+
+/**
+ * size of the blocks indexed by the loader thread
+ */
+#define TEXT_LOAD_BLOCK (4L << 20)
+
+/**
+ * background indexing of a loaded file
+ * the thread scans the blocks of the file into indexes of their own; the
+ * main thread merges the finished blocks into the buffer and appends them
+ * to the document, so only the main thread ever touches the text
+ *
+ * members:
+ *	thread	loader thread
+ *	started	was the thread started; the blocks are indexed in the
+ *		foreground if it couldn't be
+ *	lock	guards ready, stop and err
+ *	cond	signaled when a block is ready or the thread stops
+ *	buf	index of the buffer being loaded
+ *	src	content of the buffer
+ *	len	length of the content
+ *	blocks	newline indexes of the blocks
+ *	nblocks	number of blocks
+ *	ready	number of blocks indexed by the thread
+ *	used	number of blocks appended to the document
+ *	stop	should the thread stop; set by the thread when it fails
+ *	err	error of the thread
+ */
+struct text_loader_t
+{
+	pthread_t thread;
+	int started;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	int buf;
+	const char *src;
+	long len;
+
+	struct lines_t *blocks;
+	long nblocks;
+	long ready;
+	long used;
+
+	int stop;
+	int err;
+};
+
+/**
+ * piece table text store
+ *
+ * members:
+ *	bufs	add buffer followed by the loaded files
+ *	nbufs	number of buffers
+ *	root	root of the piece tree; NULL for an empty text
+ *	nodes	allocator of the nodes of the tree; nodes made one after
+ *		another share chunks and the tree is freed a chunk at a time
+ *	loader	file still being indexed; NULL if none
+ *	version	number of changes made to the document
+ *	dmg_row	first line changed since text_damage; -1 if none
+ *	dmg_old	number of lines the changed lines were
+ *	dmg_new	number of lines the changed lines are now
+ */
+struct text_t
+{
+	struct text_buf_t *bufs;
+	int nbufs;
+	struct text_node_t *root;
+	struct pool_t nodes;
+	struct text_loader_t *loader;
+	long version;
+
+	long dmg_row;
+	long dmg_old;
+	long dmg_new;
+};
+
+/**
+ * contiguous bytes of a snapshot
+ *
+ * members:
+ *	ptr	start of the bytes
+ *	len	number of bytes
+ */
+struct text_span_t
+{
+	const char *ptr;
+	long len;
+};
+
+/**
+ * immutable copy of the document that another thread may read
+ * the bytes of loaded files are referenced since they never change or
+ * move; the bytes of the add buffer are copied since the buffer moves
+ * when it grows
+ *
+ * members:
+ *	spans	content of the document in order
+ *	nspans	number of spans
+ *	copy	copied bytes of the add buffer
+ *	len	length of the document
+ */
+struct text_snap_t
+{
+	struct text_span_t *spans;
+	long nspans;
+	char *copy;
+	long len;
+};
+
+/**
+ * position inside the text used to walk it without new lookups
+ * the iterator is valid until the next modification
+ *
+ * members:
+ *	text	text being walked
+ *	leaf	leaf of the current piece
+ *	idx	index of the current piece in the leaf
+ *	off	offset inside the current piece
+ *	pos	byte offset in the document
+ */
+struct text_iter_t
+{
+	struct text_t *text;
+	struct text_node_t *leaf;
+	int idx;
+	long off;
+	long pos;
+};
+
+/**
+ * initialize an empty text
+ *
+ * params:
+ *	self	self pointer
+ */
+int text_init(struct text_t *self);
+
+/**
+ * free the text
+ *
+ * params:
+ *	self	self pointer
+ */
+int text_free(struct text_t *self);
+
+/**
+ * insert a string at the given offset
+ *
+ * params:
+ *	self	self pointer
+ *	off	byte offset in the document; 0 <= off <= length
+ *	src	string that will be inserted
+ *	len	length of the string
+ */
+int text_insert(struct text_t *self, long off, const char *src, long len);
+
+/**
+ * insert bytes that already are in one of the buffers without copying
+ *
+ * params:
+ *	self	self pointer
+ *	off	byte offset in the document; 0 <= off <= length
+ *	buf	index of the buffer
+ *	start	offset of the bytes in the buffer
+ *	len	number of bytes
+ */
+int text_insert_ref(struct text_t *self, long off, int buf, long start,
+	long len);
+
+/**
+ * insert the content of a file at the given offset
+ * regular files are memory mapped, anything else is read in large
+ * blocks; the whole file becomes a single piece
+ *
+ * params:
+ *	self	self pointer
+ *	off	byte offset in the document; 0 <= off <= length
+ *	path	path of the file
+ *	len	where the number of inserted bytes is given
+ *	lf	where the number of inserted newlines is given
+ */
+int text_load(struct text_t *self, long off, const char *path, long *len,
+	long *lf);
+
+/**
+ * append the content of a file to the end of the document
+ * a regular file of at least TEXT_LAZY bytes is mapped, its first block
+ * is indexed right away and a thread indexes the rest; text_load_poll
+ * appends the indexed blocks, so until then the document ends early
+ * text inserted at the end of the document goes before the rest of the
+ * file; any other file is loaded by text_load
+ *
+ * params:
+ *	self	self pointer
+ *	path	path of the file
+ *	len	where the number of bytes appended so far is given
+ *	lf	where the number of newlines appended so far is given
+ */
+int text_load_lazy(struct text_t *self, const char *path, long *len,
+	long *lf);
+
+/**
+ * append the blocks indexed by the loader thread to the document
+ * the loader is freed once the whole file is appended
+ *
+ * params:
+ *	self	self pointer
+ *	wait	wait for a block if none is ready
+ */
+int text_load_poll(struct text_t *self, int wait);
+
+/**
+ * wait until a line is complete or the whole file is loaded
+ *
+ * params:
+ *	self	self pointer
+ *	row	line number; negative to wait for the whole file
+ */
+int text_load_wait(struct text_t *self, long row);
+
+/**
+ * progress of the loader thread
+ *
+ * params:
+ *	self	self pointer
+ *	done	where the number of bytes appended is given
+ *	total	where the size of the file is given; 0 when nothing is loading
+ */
+int text_load_progress(struct text_t *self, long *done, long *total);
+
+/**
+ * delete a range of bytes
+ *
+ * params:
+ *	self	self pointer
+ *	off	byte offset of the first deleted byte
+ *	len	number of bytes to delete
+ */
+int text_delete(struct text_t *self, long off, long len);
+
+/**
+ * pieces without a newline walked by text_iter_next_line before the end
+ * of the line is looked up in the piece tree instead
+ */
+#define TEXT_LINE_STEPS 8
+
+/**
+ * maximum number of pieces gathered into a single writev
+ */
+#define TEXT_IOV 1024
+
+/**
+ * write the whole document to a file descriptor
+ * the pieces are gathered straight from the buffers without copying
+ *
+ * params:
+ *	self	self pointer
+ *	fd	file descriptor open for writing
+ *	res	where the number of written bytes is given
+ */
+int text_write(struct text_t *self, int fd, long *res);
+
+/**
+ * take a snapshot of the document
+ * costs the number of pieces and the bytes of the add buffer in use; the
+ * loaded files are not copied
+ * the snapshot is valid until the text is freed
+ *
+ * params:
+ *	self	self pointer
+ *	res	where the snapshot is given
+ */
+int text_snap(struct text_t *self, struct text_snap_t *res);
+
+/**
+ * write a snapshot to a file descriptor
+ * may be called from any thread
+ *
+ * params:
+ *	self	snapshot
+ *	fd	file descriptor open for writing
+ *	res	where the number of written bytes is given
+ */
+int text_snap_write(struct text_snap_t *self, int fd, long *res);
+
+/**
+ * free a snapshot
+ *
+ * params:
+ *	self	snapshot
+ */
+int text_snap_free(struct text_snap_t *self);
+
+/**
+ * lines changed since the last call, merged into one range
+ * lines [row, row + old) of the document as it was are now the lines
+ * [row, row + new); row is -1 if nothing changed
+ *
+ * params:
+ *	self	self pointer
+ *	row	where the first changed line is given
+ *	old	where the number of lines the range was is given
+ *	new	where the number of lines the range is now is given
+ */
+int text_damage(struct text_t *self, long *row, long *old, long *new);
+
+/**
+ * length of the document in bytes
+ *
+ * params:
+ *	self	self pointer
+ *	res	where the result is given
+ */
+int text_len(struct text_t *self, long *res);
+
+/**
+ * SCAN_* bits of every byte that was ever part of the document
+ * 0 means the text is plain printable ascii and newlines
+ *
+ * params:
+ *	self	self pointer
+ *	res	where the result is given
+ */
+int text_flags(struct text_t *self, int *res);
+
+/**
+ * number of lines in the document; always at least 1
+ *
+ * params:
+ *	self	self pointer
+ *	res	where the result is given
+ */
+int text_lines(struct text_t *self, int *res);
+
+/**
+ * line and column of a byte offset
+ *
+ * params:
+ *	self	self pointer
+ *	off	byte offset; 0 <= off <= length
+ *	row	where the line number is given
+ *	col	where the column is given
+ */
+int text_pos(struct text_t *self, long off, int *row, int *col);
+
+/**
+ * buffer holding the byte at the given offset
+ * bytes inserted together stay contiguous in their buffer
+ *
+ * params:
+ *	self	self pointer
+ *	off	byte offset; 0 <= off < length
+ *	buf	where the index of the buffer is given
+ *	start	where the offset in the buffer is given
+ */
+int text_locate(struct text_t *self, long off, int *buf, long *start);
+
+/**
+ * byte offset of the first character of a line
+ *
+ * params:
+ *	self	self pointer
+ *	row	line number; 0 <= row < lines
+ *	res	where the result is given
+ */
+int text_line_start(struct text_t *self, int row, long *res);
+
+/**
+ * length of a line without the '\n'
+ *
+ * params:
+ *	self	self pointer
+ *	row	line number; 0 <= row < lines
+ *	res	where the result is given
+ */
+int text_line_len(struct text_t *self, int row, int *res);
+
+/**
+ * character at the given offset
+ *
+ * params:
+ *	self	self pointer
+ *	off	byte offset; 0 <= off < length
+ *	res	where the result is given
+ */
+int text_at(struct text_t *self, long off, char *res);
+
+/**
+ * longest contiguous span starting at the given offset
+ * the span is valid until the next modification
+ *
+ * params:
+ *	self	self pointer
+ *	off	byte offset; 0 <= off < length
+ *	ptr	where the start of the span is given
+ *	len	where the length of the span is given
+ */
+int text_span(struct text_t *self, long off, const char **ptr, long *len);
+
+/**
+ * largest number of bytes searched backwards at once
+ */
+#define TEXT_SEARCH_BLOCK (1L << 20)
+
+/**
+ * first match of a pattern that starts in [from, to)
+ * matches may cross pieces
+ *
+ * params:
+ *	self	self pointer
+ *	pat	pattern
+ *	plen	length of the pattern; at least 1
+ *	from	first offset a match may start at
+ *	to	offset where matches stop starting
+ *	res	where the offset of the match is given; -1 if there is none
+ */
+int text_search(struct text_t *self, const char *pat, long plen, long from,
+	long to, long *res);
+
+/**
+ * last match of a pattern that starts in [from, to)
+ *
+ * params:
+ *	self	self pointer
+ *	pat	pattern
+ *	plen	length of the pattern; at least 1
+ *	from	first offset a match may start at
+ *	to	offset where matches stop starting
+ *	res	where the offset of the match is given; -1 if there is none
+ */
+int text_search_back(struct text_t *self, const char *pat, long plen,
+	long from, long to, long *res);
+
+/**
+ * place an iterator at the given byte offset
+ *
+ * params:
+ *	self	self pointer
+ *	pos	byte offset; 0 <= pos <= length
+ *	it	iterator that will be placed
+ */
+int text_iter_at(struct text_t *self, long pos, struct text_iter_t *it);
+
+/**
+ * place an iterator at the first character of a line
+ *
+ * params:
+ *	self	self pointer
+ *	row	line number; 0 <= row < lines
+ *	it	iterator that will be placed
+ */
+int text_iter_row(struct text_t *self, int row, struct text_iter_t *it);
+
+/**
+ * contiguous span starting at the iterator
+ *
+ * params:
+ *	it	self pointer
+ *	ptr	where the start of the span is given
+ *	len	where the length of the span is given
+ */
+int text_iter_span(struct text_iter_t *it, const char **ptr, long *len);
+
+/**
+ * move the iterator forward
+ * stops at the end of the document
+ *
+ * params:
+ *	it	self pointer
+ *	n	number of bytes to move
+ */
+int text_iter_advance(struct text_iter_t *it, long n);
+
+/**
+ * contiguous span ending right before the iterator
+ *
+ * params:
+ *	it	self pointer
+ *	ptr	where the start of the span is given
+ *	len	where the length of the span is given
+ */
+int text_iter_span_back(struct text_iter_t *it, const char **ptr, long *len);
+
+/**
+ * move the iterator backward
+ * stops at the start of the document
+ *
+ * params:
+ *	it	self pointer
+ *	n	number of bytes to move
+ */
+int text_iter_retreat(struct text_iter_t *it, long n);
+
+/**
+ * move the iterator to the first character of the next line
+ * gives RANGE_ERR and stops at the end of the document on the last line
+ *
+ * params:
+ *	it	self pointer
+ */
+int text_iter_next_line(struct text_iter_t *it);
+
+/**
+ * content of the line starting at the iterator without the '\n'; the
+ * iterator moves to the next line like text_iter_next_line
+ * the line is copied into buf only if it crosses pieces
+ *
+ * params:
+ *	it	self pointer; at the start of a line
+ *	buf	scratch space for the copy
+ *	max	longest line given; a longer line gives NULL and its length
+ *	ptr	where the content is given; valid until buf or the text change
+ *	len	where the length is given
+ */
+int text_iter_line(struct text_iter_t *it, struct str_t *buf, long max,
+	const char **ptr, long *len);
+
+#endif // TEXT_H
@@ -0,0 +1,295 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "text.h"
+#include "undo.h"
+#include "util.h"
+
+// ========================================
+// helper declaration
+// ========================================
+
+/**
+ * append an operation; forgets the undone operations first
+ * the caller trims the log once the operation is complete
+ *
+ * params:
+ *	self	self pointer
+ *	op	operation; its step is filled in
+ */
+int undo_push(struct undo_t *self, struct undo_op_t *op);
+
+/**
+ * drop the oldest steps while the log is over UNDO_CAP
+ * the last step is always kept
+ *
+ * params:
+ *	self	self pointer
+ */
+void undo_trim(struct undo_t *self);
+
+/**
+ * bytes used by the log
+ *
+ * params:
+ *	self	self pointer
+ */
+long undo_size(struct undo_t *self);
+
+// ========================================
+// undo.h - definition
+// ========================================
+
+int undo_init(struct undo_t *self)
+{
+	memset(self, 0, sizeof(*self));
+	return NO_ERR;
+}
+
+int undo_free(struct undo_t *self)
+{
+	free(self->ops);
+	free(self->arena);
+	memset(self, 0, sizeof(*self));
+	return NO_ERR;
+}
+
+int undo_insert(struct undo_t *self, struct text_t *text, long off, long len,
+	int crow, int ccol)
+{
+	if (len <= 0)
+		return NO_ERR;
+
+	struct undo_op_t op;
+	op.type = UNDO_INSERT;
+	op.off = off;
+	op.len = len;
+	op.crow = crow;
+	op.ccol = ccol;
+	int err = text_locate(text, off, &op.buf, &op.start);
+	if (err)
+		return err;
+
+	// typing continues the last insert of the step
+	if (self->open && self->cur == self->nops && self->nops > 0)
+	{
+		struct undo_op_t *last = self->ops + self->nops - 1;
+		if (last->type == UNDO_INSERT && last->buf == op.buf &&
+			last->start + last->len == op.start &&
+			last->off + last->len == off)
+		{
+			last->len += len;
+			return NO_ERR;
+		}
+	}
+
+	err = undo_push(self, &op);
+	if (err)
+		return err;
+	undo_trim(self);
+	return NO_ERR;
+}
+
+int undo_delete(struct undo_t *self, struct text_t *text, long off, long len,
+	int crow, int ccol)
+{
+	if (len <= 0)
+		return NO_ERR;
+
+	// forget the undone operations before their bytes are overwritten
+	struct undo_op_t op;
+	op.type = UNDO_DELETE;
+	op.off = off;
+	op.len = len;
+	op.buf = -1;
+	op.crow = crow;
+	op.ccol = ccol;
+	int err = undo_push(self, &op);
+	if (err)
+		return err;
+
+	if (self->len + len > self->cap)
+	{
+		long cap = self->cap * 2;
+		if (cap < self->len + len)
+			cap = self->len + len;
+		char *arena = (char *) realloc(self->arena, cap);
+		if (arena == NULL)
+		{
+			self->nops--;
+			self->cur--;
+			return MALLOC_ERR;
+		}
+		self->arena = arena;
+		self->cap = cap;
+	}
+
+	// copy the bytes piece by piece
+	struct undo_op_t *last = self->ops + self->nops - 1;
+	last->start = self->len;
+	for (long done = 0; done < len;)
+	{
+		const char *span = NULL;
+		long span_len = 0;
+		text_span(text, off + done, &span, &span_len);
+		if (span_len > len - done)
+			span_len = len - done;
+		memcpy(self->arena + self->len, span, span_len);
+		self->len += span_len;
+		done += span_len;
+	}
+
+	undo_trim(self);
+	return NO_ERR;
+}
+
+int undo_close(struct undo_t *self)
+{
+	self->open = 0;
+	return NO_ERR;
+}
+
+int undo_undo(struct undo_t *self, struct text_t *text, int *crow,
+	int *ccol)
+{
+	if (self->cur == 0)
+		return RANGE_ERR;
+
+	// revert the operations of the step in reverse order
+	int step = self->ops[self->cur - 1].step;
+	while (self->cur > 0 && self->ops[self->cur - 1].step == step)
+	{
+		struct undo_op_t *op = self->ops + self->cur - 1;
+		int err = op->type == UNDO_INSERT ?
+			text_delete(text, op->off, op->len) :
+			text_insert(text, op->off, self->arena + op->start, op->len);
+		if (err)
+			return err;
+		*crow = op->crow;
+		*ccol = op->ccol;
+		self->cur--;
+	}
+	self->open = 0;
+	return NO_ERR;
+}
+
+int undo_redo(struct undo_t *self, struct text_t *text, long *off)
+{
+	if (self->cur == self->nops)
+		return RANGE_ERR;
+
+	int step = self->ops[self->cur].step;
+	while (self->cur < self->nops && self->ops[self->cur].step == step)
+	{
+		struct undo_op_t *op = self->ops + self->cur;
+		int err = NO_ERR;
+		if (op->type == UNDO_INSERT)
+		{
+			err = text_insert_ref(text, op->off, op->buf, op->start,
+				op->len);
+			*off = op->off + op->len;
+		}
+		else
+		{
+			err = text_delete(text, op->off, op->len);
+			*off = op->off;
+		}
+		if (err)
+			return err;
+		self->cur++;
+	}
+	self->open = 0;
+	return NO_ERR;
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+int undo_push(struct undo_t *self, struct undo_op_t *op)
+{
+	// a new change makes the undone operations unreachable
+	if (self->cur < self->nops)
+	{
+		self->nops = self->cur;
+		self->len = 0;
+		for (long i = self->nops - 1; i >= 0; i--)
+		{
+			if (self->ops[i].type == UNDO_DELETE)
+			{
+				self->len = self->ops[i].start + self->ops[i].len;
+				break;
+			}
+		}
+		self->open = 0;
+	}
+
+	if (self->nops == self->cap_ops)
+	{
+		long cap = (self->cap_ops + 1) * 2;
+		struct undo_op_t *ops = (struct undo_op_t *) realloc(self->ops,
+			cap * sizeof(struct undo_op_t));
+		if (ops == NULL)
+			return MALLOC_ERR;
+		self->ops = ops;
+		self->cap_ops = cap;
+	}
+
+	if (!self->open || self->nops == 0)
+		self->step++;
+	self->open = 1;
+	op->step = self->step;
+	self->ops[self->nops++] = *op;
+	self->cur = self->nops;
+	return NO_ERR;
+}
+
+void undo_trim(struct undo_t *self)
+{
+	if (undo_size(self) <= UNDO_CAP)
+		return;
+
+	// drop whole steps from the front until half of the cap is left
+	int last = self->ops[self->nops - 1].step;
+	long drop = 0, size = undo_size(self);
+	while (drop < self->nops && self->ops[drop].step != last &&
+		size > UNDO_CAP / 2)
+	{
+		int step = self->ops[drop].step;
+		while (drop < self->nops && self->ops[drop].step == step)
+		{
+			size -= sizeof(struct undo_op_t);
+			if (self->ops[drop].type == UNDO_DELETE)
+				size -= self->ops[drop].len;
+			drop++;
+		}
+	}
+	if (drop == 0)
+		return;
+
+	// the arena holds the deleted bytes in operation order
+	long first = self->len;
+	for (long i = drop; i < self->nops; i++)
+	{
+		if (self->ops[i].type == UNDO_DELETE)
+		{
+			first = self->ops[i].start;
+			break;
+		}
+	}
+	memmove(self->arena, self->arena + first, self->len - first);
+	self->len -= first;
+
+	memmove(self->ops, self->ops + drop,
+		(self->nops - drop) * sizeof(struct undo_op_t));
+	self->nops -= drop;
+	self->cur -= drop;
+	for (long i = 0; i < self->nops; i++)
+		if (self->ops[i].type == UNDO_DELETE)
+			self->ops[i].start -= first;
+}
+
+long undo_size(struct undo_t *self)
+{
+	return self->nops * sizeof(struct undo_op_t) + self->len;
+}
@@ -0,0 +1,162 @@
+#ifndef UNDO_H
+#define UNDO_H
+
+#include "text.h"
+#include "util.h"
+
+// ========================================
+// undo log
+// ========================================
+
+/**
+ * bytes the log may use before the oldest steps are dropped
+ * build with -DUNDO_CAP=<bytes> to change it
+ */
+#ifndef UNDO_CAP
+#define UNDO_CAP (16L << 20)
+#endif
+
+/**
+ * kinds of operations
+ */
+enum
+{
+	UNDO_INSERT = 0,
+	UNDO_DELETE,
+};
+
+/**
+ * recorded change of the document
+ * inserted bytes stay in their read-only text buffer and are referenced
+ * by buf and start; deleted bytes are copied into the arena
+ *
+ * members:
+ *	type	UNDO_INSERT or UNDO_DELETE
+ *	step	undo step of the operation
+ *	off	byte offset of the change in the document
+ *	len	number of bytes
+ *	buf	text buffer of the inserted bytes; inserts only
+ *	start	offset of the bytes in the text buffer or the arena
+ *	crow	cursor row before the change
+ *	ccol	cursor column before the change
+ */
+struct undo_op_t
+{
+	int type;
+	int step;
+	long off;
+	long len;
+	int buf;
+	long start;
+	int crow;
+	int ccol;
+};
+
+/**
+ * append-only log of operations grouped into undo steps
+ * operations [0, cur) are applied; [cur, nops) can be redone
+ *
+ * members:
+ *	ops	recorded operations
+ *	nops	number of recorded operations
+ *	cap_ops	capacity of ops
+ *	cur	number of applied operations
+ *	arena	bytes of the deleted ranges
+ *	len	used bytes of the arena
+ *	cap	capacity of the arena
+ *	step	step of the last recorded operation
+ *	open	do new operations join the last step
+ */
+struct undo_t
+{
+	struct undo_op_t *ops;
+	long nops;
+	long cap_ops;
+	long cur;
+
+	char *arena;
+	long len;
+	long cap;
+
+	int step;
+	int open;
+};
+
+/**
+ * initialize an empty log
+ *
+ * params:
+ *	self	self pointer
+ */
+int undo_init(struct undo_t *self);
+
+/**
+ * free the log
+ *
+ * params:
+ *	self	self pointer
+ */
+int undo_free(struct undo_t *self);
+
+/**
+ * record bytes that were just inserted into the text
+ * typing right after the last insert extends it
+ *
+ * params:
+ *	self	self pointer
+ *	text	text after the insert
+ *	off	byte offset of the inserted bytes
+ *	len	number of bytes
+ *	crow	cursor row before the insert
+ *	ccol	cursor column before the insert
+ */
+int undo_insert(struct undo_t *self, struct text_t *text, long off, long len,
+	int crow, int ccol);
+
+/**
+ * record bytes that are about to be deleted from the text
+ *
+ * params:
+ *	self	self pointer
+ *	text	text before the delete
+ *	off	byte offset of the deleted bytes
+ *	len	number of bytes
+ *	crow	cursor row before the delete
+ *	ccol	cursor column before the delete
+ */
+int undo_delete(struct undo_t *self, struct text_t *text, long off, long len,
+	int crow, int ccol);
+
+/**
+ * end the current step; the next operation starts a new one
+ *
+ * params:
+ *	self	self pointer
+ */
+int undo_close(struct undo_t *self);
+
+/**
+ * revert the last applied step
+ * gives RANGE_ERR if there is nothing to undo
+ *
+ * params:
+ *	self	self pointer
+ *	text	text the operations were recorded on
+ *	crow	where the cursor row before the step is given
+ *	ccol	where the cursor column before the step is given
+ */
+int undo_undo(struct undo_t *self, struct text_t *text, int *crow,
+	int *ccol);
+
+/**
+ * apply the next undone step again
+ * gives RANGE_ERR if there is nothing to redo
+ *
+ * params:
+ *	self	self pointer
+ *	text	text the operations were recorded on
+ *	off	where the byte offset after the last change is given
+ */
+int undo_redo(struct undo_t *self, struct text_t *text, long *off);
+
+#endif // UNDO_H
@@ -0,0 +1,197 @@
+#include "utf8.h"
+#include "util.h"
+
+// ========================================
+// helper declaration
+// ========================================
+
+/**
+ * range of code points
+ */
+struct utf8_range_t
+{
+	int first;
+	int last;
+};
+
+/**
+ * is a code point in one of sorted ranges?
+ *
+ * params:
+ *	cp	code point
+ *	ranges	sorted ranges that don't overlap
+ *	n	number of ranges
+ */
+int utf8_in(int cp, const struct utf8_range_t *ranges, int n);
+
+/**
+ * combining marks and other characters drawn over the one before them
+ */
+static const struct utf8_range_t UTF8_ZERO[] = {
+	{0x0300, 0x036f}, {0x0483, 0x0489}, {0x0591, 0x05bd}, {0x05bf, 0x05bf},
+	{0x05c1, 0x05c2}, {0x05c4, 0x05c5}, {0x05c7, 0x05c7}, {0x0610, 0x061a},
+	{0x064b, 0x065f}, {0x0670, 0x0670}, {0x06d6, 0x06dc}, {0x06df, 0x06e4},
+	{0x06e7, 0x06e8}, {0x06ea, 0x06ed}, {0x0900, 0x0902}, {0x093a, 0x093a},
+	{0x093c, 0x093c}, {0x0941, 0x0948}, {0x094d, 0x094d}, {0x0951, 0x0957},
+	{0x0e31, 0x0e31}, {0x0e34, 0x0e3a}, {0x0e47, 0x0e4e}, {0x1ab0, 0x1aff},
+	{0x1dc0, 0x1dff}, {0x200b, 0x200f}, {0x202a, 0x202e}, {0x2060, 0x2064},
+	{0x20d0, 0x20ff}, {0x302a, 0x302d}, {0x3099, 0x309a}, {0xfe00, 0xfe0f},
+	{0xfe20, 0xfe2f}, {0xfeff, 0xfeff}, {0x1f3fb, 0x1f3ff},
+	{0xe0100, 0xe01ef},
+};
+
+/**
+ * east asian wide and fullwidth characters
+ */
+static const struct utf8_range_t UTF8_WIDE[] = {
+	{0x1100, 0x115f}, {0x231a, 0x231b}, {0x2329, 0x232a}, {0x23e9, 0x23ec},
+	{0x23f0, 0x23f0}, {0x23f3, 0x23f3}, {0x25fd, 0x25fe}, {0x2614, 0x2615},
+	{0x2648, 0x2653}, {0x267f, 0x267f}, {0x2693, 0x2693}, {0x26a1, 0x26a1},
+	{0x26aa, 0x26ab}, {0x26bd, 0x26be}, {0x26c4, 0x26c5}, {0x26ce, 0x26ce},
+	{0x26d4, 0x26d4}, {0x26ea, 0x26ea}, {0x26f2, 0x26f3}, {0x26f5, 0x26f5},
+	{0x26fa, 0x26fa}, {0x26fd, 0x26fd}, {0x2705, 0x2705}, {0x270a, 0x270b},
+	{0x2728, 0x2728}, {0x274c, 0x274c}, {0x274e, 0x274e}, {0x2753, 0x2755},
+	{0x2757, 0x2757}, {0x2795, 0x2797}, {0x27b0, 0x27b0}, {0x27bf, 0x27bf},
+	{0x2b1b, 0x2b1c}, {0x2b50, 0x2b50}, {0x2b55, 0x2b55}, {0x2e80, 0x3029},
+	{0x302e, 0x303e}, {0x3041, 0x3098}, {0x309b, 0x33ff}, {0x3400, 0x4dbf},
+	{0x4e00, 0x9fff}, {0xa000, 0xa4cf}, {0xa960, 0xa97f}, {0xac00, 0xd7a3},
+	{0xf900, 0xfaff}, {0xfe10, 0xfe19}, {0xfe30, 0xfe6f}, {0xff00, 0xff60},
+	{0xffe0, 0xffe6}, {0x16fe0, 0x16fe4}, {0x17000, 0x18cff},
+	{0x1b000, 0x1b2ff}, {0x1f004, 0x1f004}, {0x1f0cf, 0x1f0cf},
+	{0x1f18e, 0x1f18e}, {0x1f191, 0x1f19a}, {0x1f200, 0x1f251},
+	{0x1f300, 0x1f320}, {0x1f32d, 0x1f335}, {0x1f337, 0x1f37c},
+	{0x1f37e, 0x1f393}, {0x1f3a0, 0x1f3ca}, {0x1f3cf, 0x1f3d3},
+	{0x1f3e0, 0x1f3f0}, {0x1f3f4, 0x1f3f4}, {0x1f3f8, 0x1f3fa},
+	{0x1f400, 0x1f43e}, {0x1f440, 0x1f440}, {0x1f442, 0x1f4fc},
+	{0x1f4ff, 0x1f53d}, {0x1f54b, 0x1f54e}, {0x1f550, 0x1f567},
+	{0x1f57a, 0x1f57a}, {0x1f595, 0x1f596}, {0x1f5a4, 0x1f5a4},
+	{0x1f5fb, 0x1f64f}, {0x1f680, 0x1f6c5}, {0x1f6cc, 0x1f6cc},
+	{0x1f6d0, 0x1f6d2}, {0x1f6d5, 0x1f6d7}, {0x1f6eb, 0x1f6ec},
+	{0x1f6f4, 0x1f6fc}, {0x1f7e0, 0x1f7eb}, {0x1f90c, 0x1f93a},
+	{0x1f93c, 0x1f945}, {0x1f947, 0x1f9ff}, {0x1fa70, 0x1faff},
+	{0x20000, 0x2fffd}, {0x30000, 0x3fffd},
+};
+
+// ========================================
+// utf8.h - definition
+// ========================================
+
+int utf8_len(unsigned char ch)
+{
+	if (ch < 0x80)
+		return 1;
+	if (ch < 0xc2)
+		return 0;
+	if (ch < 0xe0)
+		return 2;
+	if (ch < 0xf0)
+		return 3;
+	if (ch < 0xf5)
+		return 4;
+	return 0;
+}
+
+int utf8_decode(const char *src, long len, int *cp)
+{
+	const unsigned char *s = (const unsigned char *) src;
+	int n = utf8_len(s[0]);
+	*cp = -1;
+	if (n == 1)
+		*cp = s[0];
+	if (n <= 1 || n > len)
+		return 1;
+
+	int c = s[0] & (0x7f >> n);
+	for (int i = 1; i < n; i++)
+	{
+		if ((s[i] & 0xc0) != 0x80)
+			return 1;
+		c = (c << 6) | (s[i] & 0x3f);
+	}
+
+	// overlong forms, surrogates and code points past the last one
+	static const int least[] = {0, 0, 0x80, 0x800, 0x10000};
+	if (c < least[n] || (0xd800 <= c && c <= 0xdfff) || c > 0x10ffff)
+		return 1;
+	*cp = c;
+	return n;
+}
+
+int utf8_encode(int cp, char *dest)
+{
+	unsigned char *d = (unsigned char *) dest;
+	if (cp < 0x80)
+	{
+		d[0] = cp;
+		return 1;
+	}
+	if (cp < 0x800)
+	{
+		d[0] = 0xc0 | (cp >> 6);
+		d[1] = 0x80 | (cp & 0x3f);
+		return 2;
+	}
+	if (cp < 0x10000)
+	{
+		d[0] = 0xe0 | (cp >> 12);
+		d[1] = 0x80 | ((cp >> 6) & 0x3f);
+		d[2] = 0x80 | (cp & 0x3f);
+		return 3;
+	}
+	d[0] = 0xf0 | (cp >> 18);
+	d[1] = 0x80 | ((cp >> 12) & 0x3f);
+	d[2] = 0x80 | ((cp >> 6) & 0x3f);
+	d[3] = 0x80 | (cp & 0x3f);
+	return 4;
+}
+
+int utf8_width(int cp)
+{
+	if (cp < 0x300)
+		return 1;
+	if (utf8_in(cp, UTF8_ZERO, sizeof(UTF8_ZERO) / sizeof(UTF8_ZERO[0])))
+		return 0;
+	if (utf8_in(cp, UTF8_WIDE, sizeof(UTF8_WIDE) / sizeof(UTF8_WIDE[0])))
+		return 2;
+	return 1;
+}
+
+long utf8_cols(const char *src, long len)
+{
+	long cols = 0;
+	long i = 0;
+	while (i < len)
+	{
+		// ascii needs no decoding
+		if ((unsigned char) src[i] < 0x80)
+		{
+			cols++;
+			i++;
+			continue;
+		}
+		int cp = 0;
+		i += utf8_decode(src + i, len - i, &cp);
+		cols += utf8_width(cp);
+	}
+	return cols;
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+int utf8_in(int cp, const struct utf8_range_t *ranges, int n)
+{
+	int lo = 0, hi = n - 1;
+	while (lo <= hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (cp < ranges[mid].first)
+			hi = mid - 1;
+		else if (cp > ranges[mid].last)
+			lo = mid + 1;
+		else
+			return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,66 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+#include "util.h"
+
+// ========================================
+// utf-8
+// ========================================
+
+/**
+ * most bytes a character takes
+ */
+#define UTF8_MAX 4
+
+/**
+ * number of bytes of the character starting with a byte; 0 if the byte
+ * can't start one
+ *
+ * params:
+ *	ch	first byte
+ */
+int utf8_len(unsigned char ch);
+
+/**
+ * decode the character at the start of the bytes
+ * a byte that doesn't start a complete and valid character is a
+ * character of its own with the code point -1
+ *
+ * params:
+ *	src	bytes
+ *	len	number of bytes; at least 1
+ *	cp	where the code point is given
+ *	returns	number of bytes of the character
+ */
+int utf8_decode(const char *src, long len, int *cp);
+
+/**
+ * encode a code point
+ *
+ * params:
+ *	cp	code point
+ *	dest	room for UTF8_MAX bytes
+ *	returns	number of bytes written
+ */
+int utf8_encode(int cp, char *dest);
+
+/**
+ * columns a character takes on the screen
+ * combining marks take none and east asian wide characters two; bytes
+ * that aren't characters and control characters are shown in one
+ *
+ * params:
+ *	cp	code point; -1 for a byte that isn't a character
+ */
+int utf8_width(int cp);
+
+/**
+ * columns some bytes take on the screen
+ *
+ * params:
+ *	src	bytes
+ *	len	number of bytes
+ */
+long utf8_cols(const char *src, long len);
+
+#endif // UTF8_H
@@ -1,58 +1,159 @@
 #include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86
+#endif
 
 #include "util.h"
 
+// ========================================
+// helper declaration
+// ========================================
+
+/**
+ * make sure that the gap can hold at least n characters
+ *
+ * params:
+ *	self	self pointer
+ *	n	number of characters
+ */
+int str_grow(struct str_t *self, int n);
+
+/**
+ * character array of the string; inside the struct or on the heap
+ *
+ * params:
+ *	self	self pointer
+ */
+char *str_text(struct str_t *self);
+
+/**
+ * capacity of the character array of the string
+ *
+ * params:
+ *	self	self pointer
+ */
+int str_cap(struct str_t *self);
+
+/**
+ * make room for n more offsets; widens the offsets if needed
+ *
+ * params:
+ *	self	self pointer
+ *	n	number of offsets
+ *	last	largest offset that will be stored
+ */
+int lines_reserve(struct lines_t *self, long n, long last);
+
+/**
+ * scanner implementations; same contract as lines_scan with the room
+ * for the offsets of one block already reserved by the caller
+ */
+long lines_scan_scalar(struct lines_t *self, const char *src, long len,
+	long base);
+long lines_scan_sse2(struct lines_t *self, const char *src, long len,
+	long base);
+long lines_scan_avx2(struct lines_t *self, const char *src, long len,
+	long base);
+
+/**
+ * largest block handed to an implementation at once
+ */
+#define SCAN_BLOCK 4096
+
+/**
+ * scanner implementation in use
+ */
+static long (*SCAN_FN)(struct lines_t *, const char *, long, long);
+
+/**
+ * mem_find implementations; same contract as mem_find with plen >= 2
+ */
+long mem_find_scalar(const char *src, long len, const char *pat, long plen);
+long mem_find_sse2(const char *src, long len, const char *pat, long plen);
+long mem_find_avx2(const char *src, long len, const char *pat, long plen);
+
+/**
+ * mem_find implementation in use
+ */
+static long (*FIND_FN)(const char *, long, const char *, long);
+
 // ========================================
 // string type
 // ========================================
 
 int str_init(struct str_t *self)
 {
-	self->text = NULL;
 	self->len = 0;
-	self->cap = 0;
+	self->gap = 0;
+	memset(self->small, 0, sizeof(self->small));
 	return NO_ERR;
 }
 
 int str_free(struct str_t *self)
 {
-	if (self->text)
-		free(self->text);
+	if (self->heap.on)
+		free(self->heap.text);
 	return str_init(self);
 }
 
 int str_appendc(struct str_t *self, char ch)
 {
-	if (self->len + 1 >= self->cap)
+	// appending happens at the end of the string
+	str_gap_move(self, self->len);
+	if (self->len == str_cap(self))
 	{
-		// reallocate the array with new capacity
-		int old_cap = self->cap;
-		int new_cap = (old_cap + 1) * 2;
-		char *buffer = (char*) realloc(self->text, new_cap * sizeof(char));
-		if (buffer == NULL)
-			return MALLOC_ERR;
-
-		self->text = buffer;
-		self->cap = new_cap;
+		int err = str_grow(self, 1);
+		if (err)
+			return err;
 	}
 
 	// append the character
-	self->text[self->len] = ch;
+	str_text(self)[self->len] = ch;
 	self->len++;
+	self->gap++;
 	return NO_ERR;
 }
 
 int str_appends(struct str_t *self, const char *src, int len)
 {
-	for (int i = 0; i < len; i++)
-	{
-		int err = str_appendc(self, src[i]);
-		if (err)
-			return err;
-	}
+	// appending happens at the end of the string
+	str_gap_move(self, self->len);
+	int err = str_reserve(self, len);
+	if (err)
+		return err;
+
+	memcpy(str_text(self) + self->len, src, len);
+	self->len += len;
+	self->gap += len;
 	return NO_ERR;
 }
 
+int str_reserve(struct str_t *self, int n)
+{
+	if (self->len + n > str_cap(self))
+		return str_grow(self, n);
+	return NO_ERR;
+}
+
+int str_clear(struct str_t *self)
+{
+	self->len = 0;
+	self->gap = 0;
+	return NO_ERR;
+}
+
+const char *str_cstr(struct str_t *self)
+{
+	// the byte after the capacity is there for the terminating character
+	str_gap_move(self, self->len);
+	char *text = str_text(self);
+	text[self->len] = 0;
+	return text;
+}
+
 int str_build(struct str_t *self, char **dest)
 {
 	// create a new buffer
@@ -61,10 +162,549 @@ int str_build(struct str_t *self, char **dest)
 		return MALLOC_ERR;
 
 	// copy the content of buffer and set the dest
-	for (int i = 0; i < self->len; i++)
-		buffer[i] = self->text[i];
+	char *text = str_text(self);
+	int tail = self->len - self->gap;
+	memcpy(buffer, text, self->gap);
+	memcpy(buffer + self->gap, text + str_cap(self) - tail, tail);
 	buffer[self->len] = 0;
 	*dest = buffer;
 	return NO_ERR;
 }
 
+
+int str_gap_move(struct str_t *self, int pos)
+{
+	if (pos < 0 || pos > self->len)
+		return RANGE_ERR;
+
+	char *text = str_text(self);
+	int gap_len = str_cap(self) - self->len;
+	if (pos < self->gap)
+	{
+		// move [pos, gap) to the end of the gap
+		memmove(text + pos + gap_len, text + pos, self->gap - pos);
+	}
+	else if (pos > self->gap)
+	{
+		// move the characters after the gap to the start of the gap
+		memmove(text + self->gap, text + self->gap + gap_len,
+			pos - self->gap);
+	}
+	self->gap = pos;
+	return NO_ERR;
+}
+
+int str_gap_insert(struct str_t *self, const char *src, int len)
+{
+	if (str_cap(self) - self->len < len)
+	{
+		int err = str_grow(self, len);
+		if (err)
+			return err;
+	}
+
+	memcpy(str_text(self) + self->gap, src, len);
+	self->gap += len;
+	self->len += len;
+	return NO_ERR;
+}
+
+int str_gap_delete(struct str_t *self, int before, int after)
+{
+	if (before > self->gap || after > self->len - self->gap)
+		return RANGE_ERR;
+
+	// the deleted characters simply become a part of the gap
+	self->gap -= before;
+	self->len -= before + after;
+	return NO_ERR;
+}
+
+int str_span(struct str_t *self, int off, const char **ptr, int *len)
+{
+	if (off < 0 || off >= self->len)
+		return RANGE_ERR;
+
+	char *text = str_text(self);
+	if (off < self->gap)
+	{
+		*ptr = text + off;
+		*len = self->gap - off;
+	}
+	else
+	{
+		*ptr = text + off + str_cap(self) - self->len;
+		*len = self->len - off;
+	}
+	return NO_ERR;
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+int str_grow(struct str_t *self, int n)
+{
+	// reallocate the array with new capacity and the terminating byte
+	int cap = str_cap(self);
+	int new_cap = (cap + 1) * 2;
+	if (new_cap < self->len + n)
+		new_cap = self->len + n;
+	char *buffer = NULL;
+	if (self->heap.on)
+		buffer = (char *) realloc(self->heap.text, new_cap + 1);
+	else
+	{
+		// a string leaves the struct once it outgrows it
+		buffer = (char *) malloc(new_cap + 1);
+		if (buffer)
+			memcpy(buffer, self->small, cap);
+	}
+	if (buffer == NULL)
+		return MALLOC_ERR;
+
+	// keep the characters after the gap at the end of the array
+	int tail = self->len - self->gap;
+	memmove(buffer + new_cap - tail, buffer + cap - tail, tail);
+
+	self->heap.text = buffer;
+	self->heap.cap = new_cap;
+	self->heap.on = 1;
+	return NO_ERR;
+}
+
+char *str_text(struct str_t *self)
+{
+	return self->heap.on ? self->heap.text : self->small;
+}
+
+int str_cap(struct str_t *self)
+{
+	return self->heap.on ? self->heap.cap : STR_SMALL;
+}
+
+// ========================================
+// line scanner
+// ========================================
+
+int lines_init(struct lines_t *self, long size)
+{
+	self->off = NULL;
+	self->len = 0;
+	self->cap = 0;
+	self->wide = size > 0xffffffffL;
+	self->flags = 0;
+	return NO_ERR;
+}
+
+int lines_free(struct lines_t *self)
+{
+	free(self->off);
+	return lines_init(self, 0);
+}
+
+int lines_scan(struct lines_t *self, const char *src, long len, long base)
+{
+	if (SCAN_FN == NULL)
+		lines_isa(SCAN_AUTO);
+
+	// a block can't have more newlines than bytes
+	for (long i = 0; i < len; i += SCAN_BLOCK)
+	{
+		long n = len - i < SCAN_BLOCK ? len - i : SCAN_BLOCK;
+		int err = lines_reserve(self, n, base + i + n);
+		if (err)
+			return err;
+		SCAN_FN(self, src + i, n, base + i);
+	}
+	return NO_ERR;
+}
+
+int lines_append(struct lines_t *self, struct lines_t *src)
+{
+	self->flags |= src->flags;
+	if (src->len == 0)
+		return NO_ERR;
+
+	int err = lines_reserve(self, src->len, lines_get(src, src->len - 1));
+	if (err)
+		return err;
+
+	// same widths are copied in bulk
+	if (self->wide == src->wide)
+	{
+		size_t size = self->wide ? sizeof(long) : sizeof(unsigned int);
+		memcpy((char *) self->off + self->len * size, src->off,
+			src->len * size);
+	}
+	else if (self->wide)
+		for (long i = 0; i < src->len; i++)
+			((long *) self->off)[self->len + i] = lines_get(src, i);
+	else
+		for (long i = 0; i < src->len; i++)
+			((unsigned int *) self->off)[self->len + i] = lines_get(src, i);
+	self->len += src->len;
+	return NO_ERR;
+}
+
+long lines_get(struct lines_t *self, long i)
+{
+	if (self->wide)
+		return ((long *) self->off)[i];
+	return ((unsigned int *) self->off)[i];
+}
+
+long lines_rank(struct lines_t *self, long off)
+{
+	// first newline offset that is >= off
+	long lo = 0, hi = self->len;
+	while (lo < hi)
+	{
+		long mid = lo + (hi - lo) / 2;
+		if (lines_get(self, mid) < off)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+int lines_isa(int isa)
+{
+#ifdef SCAN_X86
+	__builtin_cpu_init();
+	if (isa == SCAN_AUTO)
+		isa = __builtin_cpu_supports("avx2") ? SCAN_AVX2 : SCAN_SSE2;
+	if (isa == SCAN_AVX2 && !__builtin_cpu_supports("avx2"))
+		return RANGE_ERR;
+	if (isa == SCAN_SSE2 && !__builtin_cpu_supports("sse2"))
+		return RANGE_ERR;
+#else
+	if (isa == SCAN_AUTO)
+		isa = SCAN_SCALAR;
+	if (isa != SCAN_SCALAR)
+		return RANGE_ERR;
+#endif
+
+	if (isa == SCAN_AVX2)
+	{
+		SCAN_FN = lines_scan_avx2;
+		FIND_FN = mem_find_avx2;
+	}
+	else if (isa == SCAN_SSE2)
+	{
+		SCAN_FN = lines_scan_sse2;
+		FIND_FN = mem_find_sse2;
+	}
+	else
+	{
+		SCAN_FN = lines_scan_scalar;
+		FIND_FN = mem_find_scalar;
+	}
+	return NO_ERR;
+}
+
+int lines_reserve(struct lines_t *self, long n, long last)
+{
+	int wide = self->wide || last > 0xffffffffL;
+	if (self->len + n <= self->cap && wide == self->wide)
+		return NO_ERR;
+
+	long new_cap = self->cap;
+	while (new_cap < self->len + n)
+		new_cap = (new_cap + 1) * 2;
+
+	size_t size = wide ? sizeof(long) : sizeof(unsigned int);
+	void *off = NULL;
+	if (wide == self->wide)
+		off = realloc(self->off, new_cap * size);
+	else
+	{
+		// the offsets outgrew 32 bits; copy them into a wider array
+		off = malloc(new_cap * size);
+		if (off)
+			for (long i = 0; i < self->len; i++)
+				((long *) off)[i] = ((unsigned int *) self->off)[i];
+		if (off)
+			free(self->off);
+	}
+	if (off == NULL)
+		return MALLOC_ERR;
+
+	self->off = off;
+	self->cap = new_cap;
+	self->wide = wide;
+	return NO_ERR;
+}
+
+/**
+ * append the newlines of a bit mask; bit i stands for byte base + i
+ */
+#define SCAN_PUSH(self, mask, base) \
+	while (mask) \
+	{ \
+		long o = (base) + __builtin_ctz(mask); \
+		if ((self)->wide) \
+			((long *) (self)->off)[(self)->len++] = o; \
+		else \
+			((unsigned int *) (self)->off)[(self)->len++] = o; \
+		mask &= mask - 1; \
+	}
+
+long lines_scan_scalar(struct lines_t *self, const char *src, long len,
+	long base)
+{
+	int flags = 0;
+	for (long i = 0; i < len; i++)
+	{
+		unsigned char ch = src[i];
+		if (ch >= 32 && ch < 127)
+			continue;
+
+		if (ch == '\n')
+		{
+			if (self->wide)
+				((long *) self->off)[self->len++] = base + i;
+			else
+				((unsigned int *) self->off)[self->len++] = base + i;
+		}
+		else if (ch == '\t')
+			flags |= SCAN_TAB;
+		else if (ch == '\r')
+			flags |= SCAN_CR;
+		else if (ch >= 128)
+			flags |= SCAN_NONASCII;
+		else
+			flags |= SCAN_CTRL;
+	}
+	self->flags |= flags;
+	return len;
+}
+
+#ifdef SCAN_X86
+
+__attribute__((target("sse2")))
+long lines_scan_sse2(struct lines_t *self, const char *src, long len,
+	long base)
+{
+	const __m128i nl = _mm_set1_epi8('\n');
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i space = _mm_set1_epi8(' ');
+	const __m128i del = _mm_set1_epi8(127);
+
+	__m128i seen_tab = _mm_setzero_si128();
+	__m128i seen_cr = _mm_setzero_si128();
+	__m128i seen_ctrl = _mm_setzero_si128();
+	__m128i seen_high = _mm_setzero_si128();
+
+	long i = 0;
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+		__m128i is_nl = _mm_cmpeq_epi8(v, nl);
+		__m128i is_tab = _mm_cmpeq_epi8(v, tab);
+		__m128i is_cr = _mm_cmpeq_epi8(v, cr);
+
+		// control bytes are the ascii bytes below ' ' and DEL
+		__m128i ascii = _mm_cmpgt_epi8(v, _mm_set1_epi8(-1));
+		__m128i low = _mm_or_si128(
+			_mm_and_si128(ascii, _mm_cmplt_epi8(v, space)),
+			_mm_cmpeq_epi8(v, del));
+		__m128i other = _mm_andnot_si128(
+			_mm_or_si128(is_nl, _mm_or_si128(is_tab, is_cr)), low);
+
+		seen_tab = _mm_or_si128(seen_tab, is_tab);
+		seen_cr = _mm_or_si128(seen_cr, is_cr);
+		seen_ctrl = _mm_or_si128(seen_ctrl, other);
+		seen_high = _mm_or_si128(seen_high, v);
+
+		unsigned int mask = _mm_movemask_epi8(is_nl);
+		SCAN_PUSH(self, mask, base + i);
+	}
+
+	int flags = 0;
+	if (_mm_movemask_epi8(seen_tab))
+		flags |= SCAN_TAB;
+	if (_mm_movemask_epi8(seen_cr))
+		flags |= SCAN_CR;
+	if (_mm_movemask_epi8(seen_ctrl))
+		flags |= SCAN_CTRL;
+	if (_mm_movemask_epi8(seen_high))
+		flags |= SCAN_NONASCII;
+	self->flags |= flags;
+
+	return i + lines_scan_scalar(self, src + i, len - i, base + i);
+}
+
+__attribute__((target("avx2")))
+long lines_scan_avx2(struct lines_t *self, const char *src, long len,
+	long base)
+{
+	const __m256i nl = _mm256_set1_epi8('\n');
+	const __m256i tab = _mm256_set1_epi8('\t');
+	const __m256i cr = _mm256_set1_epi8('\r');
+	const __m256i space = _mm256_set1_epi8(' ');
+	const __m256i del = _mm256_set1_epi8(127);
+
+	__m256i seen_tab = _mm256_setzero_si256();
+	__m256i seen_cr = _mm256_setzero_si256();
+	__m256i seen_ctrl = _mm256_setzero_si256();
+	__m256i seen_high = _mm256_setzero_si256();
+
+	long i = 0;
+	for (; i + 32 <= len; i += 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i *) (src + i));
+		__m256i is_nl = _mm256_cmpeq_epi8(v, nl);
+		__m256i is_tab = _mm256_cmpeq_epi8(v, tab);
+		__m256i is_cr = _mm256_cmpeq_epi8(v, cr);
+
+		// control bytes are the ascii bytes below ' ' and DEL
+		__m256i ascii = _mm256_cmpgt_epi8(v, _mm256_set1_epi8(-1));
+		__m256i low = _mm256_or_si256(
+			_mm256_and_si256(ascii, _mm256_cmpgt_epi8(space, v)),
+			_mm256_cmpeq_epi8(v, del));
+		__m256i other = _mm256_andnot_si256(
+			_mm256_or_si256(is_nl, _mm256_or_si256(is_tab, is_cr)), low);
+
+		seen_tab = _mm256_or_si256(seen_tab, is_tab);
+		seen_cr = _mm256_or_si256(seen_cr, is_cr);
+		seen_ctrl = _mm256_or_si256(seen_ctrl, other);
+		seen_high = _mm256_or_si256(seen_high, v);
+
+		unsigned int mask = _mm256_movemask_epi8(is_nl);
+		SCAN_PUSH(self, mask, base + i);
+	}
+
+	int flags = 0;
+	if (_mm256_movemask_epi8(seen_tab))
+		flags |= SCAN_TAB;
+	if (_mm256_movemask_epi8(seen_cr))
+		flags |= SCAN_CR;
+	if (_mm256_movemask_epi8(seen_ctrl))
+		flags |= SCAN_CTRL;
+	if (_mm256_movemask_epi8(seen_high))
+		flags |= SCAN_NONASCII;
+	self->flags |= flags;
+
+	return i + lines_scan_scalar(self, src + i, len - i, base + i);
+}
+
+#else
+
+long lines_scan_sse2(struct lines_t *self, const char *src, long len,
+	long base)
+{
+	return lines_scan_scalar(self, src, len, base);
+}
+
+long lines_scan_avx2(struct lines_t *self, const char *src, long len,
+	long base)
+{
+	return lines_scan_scalar(self, src, len, base);
+}
+
+long mem_find_sse2(const char *src, long len, const char *pat, long plen)
+{
+	return mem_find_scalar(src, len, pat, plen);
+}
+
+long mem_find_avx2(const char *src, long len, const char *pat, long plen)
+{
+	return mem_find_scalar(src, len, pat, plen);
+}
+
+#endif
+
+// ========================================
+// substring search
+// ========================================
+
+long mem_find(const char *src, long len, const char *pat, long plen)
+{
+	if (plen <= 0)
+		return 0;
+	if (plen > len)
+		return -1;
+	if (plen == 1)
+	{
+		const char *p = memchr(src, pat[0], len);
+		return p ? p - src : -1;
+	}
+
+	if (FIND_FN == NULL)
+		lines_isa(SCAN_AUTO);
+	return FIND_FN(src, len, pat, plen);
+}
+
+long mem_find_scalar(const char *src, long len, const char *pat, long plen)
+{
+	// memchr finds the candidates; the last byte rejects most of them
+	const char *p = src, *end = src + len - plen + 1;
+	while (p < end && (p = memchr(p, pat[0], end - p)) != NULL)
+	{
+		if (p[plen - 1] == pat[plen - 1] &&
+			memcmp(p + 1, pat + 1, plen - 2) == 0)
+			return p - src;
+		p++;
+	}
+	return -1;
+}
+
+#ifdef SCAN_X86
+
+__attribute__((target("sse2")))
+long mem_find_sse2(const char *src, long len, const char *pat, long plen)
+{
+	const __m128i first = _mm_set1_epi8(pat[0]);
+	const __m128i last = _mm_set1_epi8(pat[plen - 1]);
+
+	long i = 0;
+	for (; i + plen - 1 + 16 <= len; i += 16)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i *) (src + i));
+		__m128i b = _mm_loadu_si128((const __m128i *) (src + i + plen - 1));
+		unsigned int mask = _mm_movemask_epi8(_mm_and_si128(
+			_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+		while (mask)
+		{
+			int bit = __builtin_ctz(mask);
+			if (memcmp(src + i + bit + 1, pat + 1, plen - 2) == 0)
+				return i + bit;
+			mask &= mask - 1;
+		}
+	}
+
+	long res = mem_find_scalar(src + i, len - i, pat, plen);
+	return res < 0 ? -1 : i + res;
+}
+
+__attribute__((target("avx2")))
+long mem_find_avx2(const char *src, long len, const char *pat, long plen)
+{
+	const __m256i first = _mm256_set1_epi8(pat[0]);
+	const __m256i last = _mm256_set1_epi8(pat[plen - 1]);
+
+	long i = 0;
+	for (; i + plen - 1 + 32 <= len; i += 32)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i *) (src + i));
+		__m256i b = _mm256_loadu_si256(
+			(const __m256i *) (src + i + plen - 1));
+		unsigned int mask = _mm256_movemask_epi8(_mm256_and_si256(
+			_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+		while (mask)
+		{
+			int bit = __builtin_ctz(mask);
+			if (memcmp(src + i + bit + 1, pat + 1, plen - 2) == 0)
+				return i + bit;
+			mask &= mask - 1;
+		}
+	}
+
+	long res = mem_find_scalar(src + i, len - i, pat, plen);
+	return res < 0 ? -1 : i + res;
+}
+
+#endif
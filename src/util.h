@@ -9,25 +9,55 @@ enum
 {
 	NO_ERR = 0,
 	MALLOC_ERR,
+	RANGE_ERR,
+	IO_ERR,
 };
 
 // ========================================
 // string type
 // ========================================
 
+/**
+ * number of characters a string holds without allocating
+ */
+#define STR_SMALL 15
+
 /**
  * string type
  *
+ * the unused capacity is kept as a gap at position gap, so the array
+ * holds [0, gap) followed by cap - len free bytes and then [gap, len)
+ * a string whose gap is at the end is a plain character array
+ * up to STR_SMALL characters are kept inside the struct; longer strings
+ * move to the heap and stay there
+ * the array always has a byte after its capacity for the terminating
+ * character of str_cstr
+ *
  * member:
- *	text	character array to store the string
  *	len	length of the string
- *	cap	capacity of the text array
+ *	gap	position of the gap
+ *	heap	array on the heap; used if on is set
+ *	heap.text	character array to store the string
+ *	heap.cap	capacity of the text array
+ *	heap.on		is the string on the heap; shares the last byte of
+ *			small, which is 0 for a string inside the struct
+ *	small	character array inside the struct
  */
 struct str_t
 {
-	char *text;
 	int len;
-	int cap;
+	int gap;
+	union
+	{
+		struct
+		{
+			char *text;
+			int cap;
+			char unused[3];
+			char on;
+		} heap;
+		char small[STR_SMALL + 1];
+	};
 };
 
 /**
@@ -57,6 +87,7 @@ int str_appendc(struct str_t *self, char ch);
 
 /**
  * append a null terminated string to the str_t type
+ * the string is copied in bulk
  *
  * params:
  *	self	self pointer
@@ -65,6 +96,75 @@ int str_appendc(struct str_t *self, char ch);
  */
 int str_appends(struct str_t *self, const char *src, int len);
 
+/**
+ * make room for at least n more characters
+ * appending up to n characters afterwards doesn't allocate
+ *
+ * params:
+ *	self	self pointer
+ *	n	number of characters
+ */
+int str_reserve(struct str_t *self, int n);
+
+/**
+ * empty the string but keep its capacity
+ *
+ * params:
+ *	self	self pointer
+ */
+int str_clear(struct str_t *self);
+
+/**
+ * move the gap to the given position
+ * costs the distance moved; edits next to the gap cost O(1)
+ *
+ * params:
+ *	self	self pointer
+ *	pos	new position of the gap; 0 <= pos <= len
+ */
+int str_gap_move(struct str_t *self, int pos);
+
+/**
+ * insert a string at the gap; the gap ends up after the inserted string
+ *
+ * params:
+ *	self	self pointer
+ *	src	string that will be inserted
+ *	len	length of the string
+ */
+int str_gap_insert(struct str_t *self, const char *src, int len);
+
+/**
+ * delete characters around the gap
+ *
+ * params:
+ *	self	self pointer
+ *	before	number of characters deleted before the gap
+ *	after	number of characters deleted after the gap
+ */
+int str_gap_delete(struct str_t *self, int before, int after);
+
+/**
+ * longest contiguous span starting at the given position
+ * a string has at most two spans; one on each side of the gap
+ *
+ * params:
+ *	self	self pointer
+ *	off	starting position; 0 <= off < len
+ *	ptr	where the start of the span is given
+ *	len	where the length of the span is given
+ */
+int str_span(struct str_t *self, int off, const char **ptr, int *len);
+
+/**
+ * content as a null terminated string; moves the gap to the end
+ * valid until the string is changed
+ *
+ * params:
+ *	self	self pointer
+ */
+const char *str_cstr(struct str_t *self);
+
 /**
  * build a string from the str_t type
  * the user need to free the build string
@@ -75,4 +175,127 @@ int str_appends(struct str_t *self, const char *src, int len);
  */
 int str_build(struct str_t *self, char **dest);
 
+// ========================================
+// line scanner
+// ========================================
+
+enum
+{
+	SCAN_TAB = 1,		// '\t' was seen
+	SCAN_CR = 2,		// '\r' was seen
+	SCAN_CTRL = 4,		// any other control byte was seen
+	SCAN_NONASCII = 8,	// a byte >= 128 was seen
+};
+
+enum
+{
+	SCAN_AUTO = 0,
+	SCAN_SCALAR,
+	SCAN_SSE2,
+	SCAN_AVX2,
+};
+
+/**
+ * sorted offsets of every newline in a buffer
+ * offsets are 32 bits wide until an offset doesn't fit anymore
+ *
+ * members:
+ *	off	offsets; unsigned int or long depending on wide
+ *	len	number of offsets
+ *	cap	capacity of the offsets array
+ *	wide	are the offsets stored as long
+ *	flags	SCAN_* bits of every byte scanned so far
+ */
+struct lines_t
+{
+	void *off;
+	long len;
+	long cap;
+	int wide;
+	int flags;
+};
+
+/**
+ * initialize an empty index
+ *
+ * params:
+ *	self	self pointer
+ *	size	expected size of the scanned buffer; picks the offset width
+ */
+int lines_init(struct lines_t *self, long size);
+
+/**
+ * free the index
+ *
+ * params:
+ *	self	self pointer
+ */
+int lines_free(struct lines_t *self);
+
+/**
+ * scan a block of bytes in one pass and append its newlines
+ * blocks must be scanned in order of their base
+ *
+ * params:
+ *	self	self pointer
+ *	src	bytes to scan
+ *	len	number of bytes
+ *	base	offset of the first byte in the whole buffer
+ */
+int lines_scan(struct lines_t *self, const char *src, long len, long base);
+
+/**
+ * append the newlines of another index; used to merge indexes of blocks
+ * scanned separately
+ *
+ * params:
+ *	self	self pointer
+ *	src	index whose offsets all come after the offsets of self
+ */
+int lines_append(struct lines_t *self, struct lines_t *src);
+
+/**
+ * offset of the i-th newline
+ *
+ * params:
+ *	self	self pointer
+ *	i	index; 0 <= i < len
+ */
+long lines_get(struct lines_t *self, long i);
+
+/**
+ * number of newlines before the given offset
+ *
+ * params:
+ *	self	self pointer
+ *	off	offset in the buffer
+ */
+long lines_rank(struct lines_t *self, long off);
+
+/**
+ * choose the implementation of the scanner and of mem_find; SCAN_AUTO
+ * picks the best one the cpu supports
+ *
+ * params:
+ *	isa	one of SCAN_*
+ */
+int lines_isa(int isa);
+
+// ========================================
+// substring search
+// ========================================
+
+/**
+ * offset of the first occurrence of a pattern; -1 if there is none
+ * candidates are filtered on their first and last byte many bytes at a
+ * time and only the survivors are compared in full
+ *
+ * params:
+ *	src	bytes to search
+ *	len	number of bytes
+ *	pat	pattern
+ *	plen	length of the pattern; at least 1
+ */
+long mem_find(const char *src, long len, const char *pat, long plen);
+
 #endif // UTIL_H
@@ -1,9 +1,21 @@
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bufs.h"
+#include "cols.h"
+#include "motion.h"
+#include "regex.h"
+#include "text.h"
+#include "utf8.h"
 #include "ve.h"
 #include "util.h"
+#include "win.h"
 
 // ========================================
 // helper declaration
@@ -11,22 +23,157 @@
 
 /**
  * add a new character to the current cursor position
- * takes in character from 32-126 and '\n'
+ * takes in character from 32-126, '\n' or the bytes of a utf-8 character
  *
  * params:
  *	self	self pointer
- *	ch	character that will be added to the editor
+ *	src	character that will be added to the editor
+ *	len	number of bytes of the character
  */
-int ve_add(struct ve_t *self, char ch);
+int ve_add(struct ve_t *self, const char *src, int len);
 
 /**
- * delete character from the current cursor position
+ * delete the character before the cursor with the marks drawn over it
  *
  * params:
  *	self	self pointer
  */
 int ve_delete(struct ve_t *self);
 
+/**
+ * revert the last change of the document
+ *
+ * params:
+ *	self	self pointer
+ */
+int ve_undo(struct ve_t *self);
+
+/**
+ * apply the last reverted change again
+ *
+ * params:
+ *	self	self pointer
+ */
+int ve_redo(struct ve_t *self);
+
+/**
+ * move the cursor to the next match of a pattern; wraps around the end
+ * gives RANGE_ERR and keeps the cursor if there is no match
+ *
+ * params:
+ *	self	self pointer
+ *	pat	pattern
+ *	plen	length of the pattern
+ *	forward	search forward or backward
+ *	from	byte offset the search starts at; forward searches include it
+ *	report	show the result and the scan speed in the message
+ */
+int ve_search(struct ve_t *self, const char *pat, int plen, int forward,
+	long from, int report);
+
+/**
+ * search a regular expression line by line from a byte offset
+ * the match must start before from when searching backward
+ *
+ * params:
+ *	self	self pointer
+ *	re	compiled pattern
+ *	forward	search forward or backward
+ *	from	byte offset the search starts at; forward searches include it
+ *	found	where the offset of the match is given; -1 if there is none
+ *	scanned	where the number of scanned bytes is given
+ *	wrapped	where it is given if the search went around the end
+ */
+int ve_search_regex(struct ve_t *self, struct regex_t *re, int forward,
+	long from, long *found, long *scanned, int *wrapped);
+
+/**
+ * replace the matches of a pattern in a range of lines
+ * every changed line is rebuilt once and replaced with a single delete
+ * and insert; all of the changes are one undo step
+ *
+ * params:
+ *	self	self pointer
+ *	re	compiled pattern
+ *	repl	replacement; & is the match and \n a newline
+ *	rlen	length of the replacement
+ *	global	replace every match of a line instead of the first one
+ *	first	first line
+ *	last	last line
+ *	subs	where the number of replaced matches is given
+ *	lines	where the number of changed lines is given
+ */
+int ve_substitute(struct ve_t *self, struct regex_t *re, const char *repl,
+	long rlen, int global, int first, int last, int *subs, int *lines);
+
+/**
+ * append a replacement with its '&' and escapes expanded
+ *
+ * params:
+ *	repl	replacement
+ *	rlen	length of the replacement
+ *	match	matched text
+ *	mlen	length of the matched text
+ *	dest	where the text is appended
+ */
+int ve_expand(const char *repl, long rlen, const char *match, long mlen,
+	struct str_t *dest);
+
+/**
+ * content of a line without the '\n'
+ * the line is copied into buf only if it spans several pieces
+ *
+ * params:
+ *	self	self pointer
+ *	row	line number
+ *	buf	scratch space for the copy
+ *	start	where the byte offset of the line is given
+ *	ptr	where the content is given
+ *	len	where the length is given
+ */
+int ve_line(struct ve_t *self, int row, struct str_t *buf, long *start,
+	const char **ptr, long *len);
+
+/**
+ * jump to the first match of the search prompt while it is typed
+ *
+ * params:
+ *	self	self pointer
+ */
+int ve_search_prompt(struct ve_t *self);
+
+/**
+ * is the prompt a search
+ *
+ * params:
+ *	self	self pointer
+ */
+int ve_prompt_is_search(struct ve_t *self);
+
+/**
+ * insert the content of a file at the cursor position
+ * the cursor goes to the end of the inserted content
+ *
+ * params:
+ *	self	self pointer
+ *	path	path of the file
+ */
+int ve_read(struct ve_t *self, const char *path);
+
+/**
+ * write the document to a temporary file next to the path and rename it
+ * over the path; the old file is untouched if anything fails
+ * a symlink is followed and the owner and permissions of the old file are
+ * kept; other hard links of the old file keep its old content
+ *
+ * params:
+ *	self	self pointer
+ *	path	path of the file
+ *	res	where the number of written bytes is given
+ *	links	where 1 is given if the old file had other hard links
+ */
+int ve_write(struct ve_t *self, const char *path, long *res, int *links);
+
 /**
  * go to the next state based on the key and insert mode
  *
@@ -72,16 +219,83 @@ int ve_prompt_run(struct ve_t *self);
 int ve_eof(struct ve_t *self, char *res);
 
 /**
- * current character of the cursor position
- * if end of the line then '\n'
- * if end of the file then 0
- * if any others, then any other ascii character
+ * move the cursor to the first non-blank character of a line
+ * the screen is centered on the line if it is not shown
+ *
+ * params:
+ *	self	self pointer
+ *	row	line number; clamped to the document
+ */
+int ve_jump(struct ve_t *self, long row);
+
+/**
+ * scroll the screen and move the cursor by a number of rows
+ * the cursor stays inside the screen
+ *
+ * params:
+ *	self	self pointer
+ *	rows	rows to scroll; negative scrolls up
+ *	cursor	rows to move the cursor
+ */
+int ve_scroll(struct ve_t *self, long rows, long cursor);
+
+/**
+ * move the cursor by a number of characters; newlines count as one
+ *
+ * params:
+ *	self	self pointer
+ *	n	number of characters; negative moves backward
+ */
+int ve_move(struct ve_t *self, long n);
+
+/**
+ * display column of the cursor
+ *
+ * params:
+ *	self	self pointer
+ *	res	where the column is given
+ */
+int ve_col(struct ve_t *self, long *res);
+
+/**
+ * move the cursor to the character covering a display column of its
+ * line; the end of the line if the line is shorter
+ *
+ * params:
+ *	self	self pointer
+ *	col	display column
+ */
+int ve_goto_col(struct ve_t *self, long col);
+
+/**
+ * move the cursor back to the start of the character it is in
+ * motions and searches work on bytes and may stop inside one
  *
  * params:
  *	self	self pointer
- *	res	where result is given
  */
-int ve_current(struct ve_t *self, char *res);
+int ve_snap(struct ve_t *self);
+
+/**
+ * offset of the character of the prompt before or after an offset
+ *
+ * params:
+ *	self	self pointer
+ *	pos	offset in the prompt
+ *	step	-1 for the one before, 1 for the one after
+ */
+int ve_prompt_step(struct ve_t *self, int pos, int step);
+
+/**
+ * run a window command; the keys after ctrl-w
+ * s and v split, c and q close, o keeps only the focused window, w and W
+ * go to the next and previous window, h j k l to the neighbour
+ *
+ * params:
+ *	self	self pointer
+ *	key	command
+ */
+void ve_window(struct ve_t *self, int key);
 
 void ve_prompt_run_hello(struct ve_t *self);
 void ve_prompt_run_discard(struct ve_t *self);
@@ -89,6 +303,17 @@ void ve_prompt_run_quit(struct ve_t *self);
 void ve_prompt_run_saveas(struct ve_t *self);
 void ve_prompt_run_read(struct ve_t *self);
 void ve_prompt_run_write(struct ve_t *self);
+void ve_prompt_run_frame(struct ve_t *self);
+void ve_prompt_run_stats(struct ve_t *self);
+void ve_prompt_run_recover(struct ve_t *self);
+void ve_prompt_run_deleteswap(struct ve_t *self);
+void ve_prompt_run_trace(struct ve_t *self, const char *path);
+void ve_prompt_run_search(struct ve_t *self);
+void ve_prompt_run_substitute(struct ve_t *self);
+void ve_prompt_run_line(struct ve_t *self, const char *prompt);
+void ve_prompt_run_edit(struct ve_t *self, const char *path);
+void ve_prompt_run_buffer(struct ve_t *self, int i);
+void ve_prompt_run_ls(struct ve_t *self);
 
 // ========================================
 // ve_t - definitions
@@ -96,12 +321,11 @@ void ve_prompt_run_write(struct ve_t *self);
 
 int ve_init(struct ve_t *self)
 {
-	self->lines = (struct str_t *) malloc(1 * sizeof(struct str_t));
-	if (self->lines == NULL)
-		return MALLOC_ERR;
-	str_init(self->lines);
+	int err = text_init(&self->text);
+	if (err)
+		return err;
+	undo_init(&self->undo);
 
-	self->sz = 1;
 	self->crow = 0;
 	self->ccol = 0;
 	self->is_running = 1;
@@ -112,43 +336,151 @@ int ve_init(struct ve_t *self)
 	self->dirty = 0;
 	str_init(&self->filename);
 	self->intro = 1;
+	str_init(&self->search);
+	self->search_row = 0;
+	self->search_col = 0;
+	regex_init(&self->re);
+	self->count = 0;
+	self->prefix = 0;
+	self->offset_row = 0;
+	self->offset_col = 0;
+	self->screen_rows = 1;
+	self->frame_bytes = 0;
+	self->frame_total = 0;
+	self->frames = 0;
+	self->frame_ns = 0;
+	self->frame_ns_total = 0;
+	stats_init(&self->stats);
+	swap_init(&self->swap);
+	syntax_init(&self->syntax);
+	self->bufs = NULL;
+	cols_init(&self->cols);
 
 	return NO_ERR;
 }
 
 int ve_free(struct ve_t *self)
 {
-	for (int i = 0; i < self->sz; i++)
-		str_free(self->lines + i);
-	free(self->lines);
+	// the swap thread may still be reading the document
+	swap_free(&self->swap);
+	text_free(&self->text);
+	undo_free(&self->undo);
+	str_free(&self->prompt);
+	str_free(&self->msg);
+	str_free(&self->filename);
+	str_free(&self->search);
+	regex_free(&self->re);
+	stats_free(&self->stats);
+	syntax_free(&self->syntax);
+	cols_free(&self->cols);
 	return NO_ERR;
 }
 
-int ve_eof(struct ve_t *self, char *res)
+int ve_open(struct ve_t *self, const char *path)
 {
-	*res = 0;
-	if (self->crow == self->sz - 1 &&
-		self->ccol == self->lines[self->crow].len)
-		*res = 1;
-	return NO_ERR;
+	str_free(&self->filename);
+	str_init(&self->filename);
+	str_appends(&self->filename, path, strlen(path));
+	syntax_open(&self->syntax, path);
+	self->intro = 0;
+
+	// a big file shows right away while the rest of it is indexed
+	long len = 0, lf = 0, done = 0, total = 0;
+	int err = text_load_lazy(&self->text, path, &len, &lf);
+	text_load_progress(&self->text, &done, &total);
+	char buffer[80];
+	if (err && errno == ENOENT)
+	{
+		// start a new file with the given name
+		snprintf(buffer, sizeof(buffer), "'%s' [New File]", path);
+	}
+	else if (err)
+	{
+		snprintf(buffer, sizeof(buffer), "Couldn't open '%s'", path);
+		self->is_error = 1;
+	}
+	else
+		snprintf(buffer, sizeof(buffer), "Read '%s' %ldL, %ldB", path, lf,
+			len);
+
+	// a swap file left by another session is reported instead
+	swap_open(&self->swap, path);
+	if (self->swap.found)
+	{
+		snprintf(buffer, sizeof(buffer),
+			"Found a swap file; :recover or :deleteswap");
+		self->is_error = 1;
+		total = 0;
+	}
+
+	// the status bar shows the progress of a loading file instead
+	if (total == 0)
+		str_appends(&self->msg, buffer, strlen(buffer));
+
+	// the opened file is not a change that can be undone
+	undo_free(&self->undo);
+	undo_init(&self->undo);
+
+	self->crow = 0;
+	self->ccol = 0;
+	self->dirty = 0;
+	return err;
 }
 
-int ve_current(struct ve_t *self, char *res)
+int ve_insert(struct ve_t *self, const char *src, long len)
 {
-	ve_eof(self, res);
-	if (*res == 1)
-	{
-		*res = 0;
+	if (!self->is_running || len == 0)
 		return NO_ERR;
-	}
 
-	if (self->ccol == self->lines[self->crow].len)
+	// make sure to remove the message; its buffer is kept
+	str_clear(&self->msg);
+	self->is_error = 0;
+
+	if (self->mode == PROMPT_MODE)
 	{
-		*res = '\n';
+		for (long i = 0; i < len; i++)
+		{
+			unsigned char ch = src[i];
+			if ((32 <= ch && ch <= 126) || ch >= 0x80)
+				str_gap_insert(&self->prompt, src + i, 1);
+		}
 		return NO_ERR;
 	}
 
-	*res = self->lines[self->crow].text[self->ccol];
+	long start = 0;
+	text_line_start(&self->text, self->crow, &start);
+	long off = start + self->ccol;
+	int err = text_insert(&self->text, off, src, len);
+	if (err)
+		return err;
+
+	// the whole block is one undo step
+	undo_close(&self->undo);
+	undo_insert(&self->undo, &self->text, off, len, self->crow, self->ccol);
+	undo_close(&self->undo);
+
+	// the cursor goes to the end of the inserted text
+	for (long i = 0; i < len; i++)
+		self->crow += src[i] == '\n';
+	text_line_start(&self->text, self->crow, &start);
+	self->ccol = off + len - start;
+
+	self->dirty = 1;
+	self->intro = 0;
+
+	// stray bytes may have joined the following ones into a character
+	return ve_snap(self);
+}
+
+int ve_eof(struct ve_t *self, char *res)
+{
+	int lines = 0, len = 0;
+	text_lines(&self->text, &lines);
+	text_line_len(&self->text, self->crow, &len);
+
+	*res = 0;
+	if (self->crow == lines - 1 && self->ccol == len)
+		*res = 1;
 	return NO_ERR;
 }
 
@@ -157,9 +489,8 @@ int ve_next(struct ve_t *self, int key)
 	if (!self->is_running)
 		return NO_ERR;
 
-	// make sure to remove the message
-	str_free(&self->msg);
-	str_init(&self->msg);
+	// make sure to remove the message; its memory is kept for the next one
+	str_clear(&self->msg);
 	self->is_error = 0;
 
 	switch(key)
@@ -169,41 +500,44 @@ int ve_next(struct ve_t *self, int key)
 		break;
 	case UP_KEY:
 	case DOWN_KEY:
+		// moving around ends the typing that is undone together
+		undo_close(&self->undo);
 		{
+			// the cursor keeps its display column
+			int lines = 0;
+			long col = 0;
+			text_lines(&self->text, &lines);
+			ve_col(self, &col);
 			int dy = (key == UP_KEY) ? -1 : +1;
-			if (0 <= self->crow + dy && self->crow + dy < self->sz)
+			if (0 <= self->crow + dy && self->crow + dy < lines)
 				self->crow += dy;
-			if (self->ccol > self->lines[self->crow].len)
-				self->ccol = self->lines[self->crow].len;
+			ve_goto_col(self, col);
 		}
 		break;
 	case LEFT_KEY:
 	case RIGHT_KEY:
+		undo_close(&self->undo);
+		if (self->mode == PROMPT_MODE)
 		{
-			int dx = (key == LEFT_KEY) ? -1 : +1;
-			self->ccol += dx;
-			if (self->ccol < 0) 
-			{
-				self->ccol = 0;
-				if (self->crow > 0)
-				{
-					self->crow--;
-					self->ccol = self->lines[self->crow].len;
-				}
-				
-			}
-			if (self->ccol > self->lines[self->crow].len)
-			{
-				self->ccol = self->lines[self->crow].len;
-				if (self->crow < self->sz - 1)
-				{
-					self->crow++;
-					self->ccol = 0;
-				}
-			}
+			// arrows move inside the prompt
+			ve_prompt_mode(self, key);
+			break;
 		}
+		// the end of a line and the start of the next one are a
+		// character apart
+		ve_move(self, key == LEFT_KEY ? -1 : 1);
 		break;
 	case ESC_KEY:
+		undo_close(&self->undo);
+		self->count = 0;
+		self->prefix = 0;
+
+		// a cancelled search goes back to where it started
+		if (self->mode == PROMPT_MODE && ve_prompt_is_search(self))
+		{
+			self->crow = self->search_row;
+			self->ccol = self->search_col;
+		}
 		self->mode = NORMAL_MODE;
 		str_free(&self->prompt);
 		str_init(&self->prompt);
@@ -217,126 +551,367 @@ int ve_next(struct ve_t *self, int key)
 			ve_prompt_mode(self, key);
 	}
 
+	ve_snap(self);
 	return NO_ERR;
 }
 
+int ve_autosave(struct ve_t *self, long now, int *wait)
+{
+	*wait = -1;
+	struct swap_t *swap = &self->swap;
+	int done = 0;
+	int err = swap_poll(swap, 0, &done);
+	if (done && err)
+	{
+		const char *msg = "Couldn't write the swap file";
+		str_free(&self->msg);
+		str_init(&self->msg);
+		str_appends(&self->msg, msg, strlen(msg));
+		self->is_error = 1;
+	}
+	if (swap->running)
+	{
+		*wait = SWAP_POLL_MS;
+		return NO_ERR;
+	}
+
+	// nothing new to save, an old swap file waits for a decision or the
+	// file is still loading
+	long loaded = 0, total = 0;
+	text_load_progress(&self->text, &loaded, &total);
+	if (swap->path == NULL || swap->found || !self->dirty || total > 0 ||
+		self->text.version == swap->saved)
+	{
+		swap->since = 0;
+		return NO_ERR;
+	}
+
+	// changes are saved SWAP_MS after the first one
+	if (swap->since == 0)
+		swap->since = now;
+	long due = swap->since + SWAP_MS * 1000000L;
+	if (now < due)
+	{
+		*wait = (due - now) / 1000000 + 1;
+		return NO_ERR;
+	}
+	swap->since = 0;
+	err = swap_start(swap, &self->text);
+	*wait = swap->running ? SWAP_POLL_MS : -1;
+	return err;
+}
+
 // ========================================
 // helper definition 
 // ========================================
 
-int ve_add(struct ve_t *self, char ch)
+int ve_move(struct ve_t *self, long n)
 {
-	if (ch == '\n')
+	long start = 0, total = 0;
+	text_line_start(&self->text, self->crow, &start);
+	text_len(&self->text, &total);
+
+	// a character is a byte as long as every byte is ascii
+	int flags = 0;
+	text_flags(&self->text, &flags);
+	long off = start + self->ccol;
+	if (!(flags & SCAN_NONASCII))
+		off += n;
+	for (; n > 0 && off < total && (flags & SCAN_NONASCII); n--)
 	{
-		// add a newline
-		int new_sz = self->sz + 1;
-		struct str_t *lines = (struct str_t *) realloc(self->lines, 
-			new_sz * sizeof(struct str_t));
-		if (lines == NULL)
-			return MALLOC_ERR;
-		str_init(lines + self->sz);	
-		self->lines = lines;
-		self->sz = new_sz;
-
-		// bring the appended line to the cursor row
-		for (int i = self->sz - 1; i > self->crow + 1; i--)
-		{
-			struct str_t temp = self->lines[i];
-			self->lines[i] = self->lines[i-1];
-			self->lines[i-1] = temp;
-		}
-
-		// append the current line with previous row values
-		struct str_t *prev_line = self->lines + self->crow;
-		struct str_t *cur_line = self->lines + self->crow + 1;
-		for (int i = self->ccol; i < prev_line->len; i++)
-			str_appendc(cur_line, prev_line->text[i]);
-
-		// change the length of the prev_line
-		if (self->ccol < prev_line->len)
-			prev_line->len = self->ccol;
-		
-		// increase the cursor row value
-		self->crow++;
-		self->ccol = 0;
+		int width = 0;
+		cols_char(&self->text, off, 0, &off, &width);
 	}
-	else if (32 <= ch && ch <= 126)
+	for (; n < 0 && off > 0 && (flags & SCAN_NONASCII); n++)
+		cols_prev(&self->text, off, &off);
+	if (off < 0)
+		off = 0;
+	if (off > total)
+		off = total;
+	return text_pos(&self->text, off, &self->crow, &self->ccol);
+}
+
+int ve_col(struct ve_t *self, long *res)
+{
+	return cols_col(&self->cols, &self->text, self->crow, self->ccol, res);
+}
+
+int ve_goto_col(struct ve_t *self, long col)
+{
+	long off = 0, at = 0;
+	cols_off(&self->cols, &self->text, self->crow, col, &off, &at);
+	self->ccol = off;
+	return NO_ERR;
+}
+
+int ve_snap(struct ve_t *self)
+{
+	int flags = 0;
+	text_flags(&self->text, &flags);
+	if (!(flags & SCAN_NONASCII))
+		return NO_ERR;
+
+	long start = 0, off = 0;
+	text_line_start(&self->text, self->crow, &start);
+	cols_snap(&self->text, start + self->ccol, &off);
+	self->ccol = off - start;
+	return NO_ERR;
+}
+
+int ve_prompt_step(struct ve_t *self, int pos, int step)
+{
+	// the continuation bytes of a character are stepped over with it
+	const char *ptr = NULL;
+	int len = 0;
+	do
 	{
-		struct str_t *line = self->lines + self->crow;
+		pos += step;
+		if (pos <= 0 || pos >= self->prompt.len)
+			break;
+		str_span(&self->prompt, pos, &ptr, &len);
+	} while ((ptr[0] & 0xc0) == 0x80);
+	return pos;
+}
 
-		// append the character
-		int err = str_appendc(line, ch);
-		if (err) return err;
+int ve_jump(struct ve_t *self, long row)
+{
+	// only the lines up to the row have to be loaded
+	text_load_wait(&self->text, row < 0 ? 0 : row);
+
+	int lines = 0, len = 0;
+	text_lines(&self->text, &lines);
+	if (row > lines - 1)
+		row = lines - 1;
+	if (row < 0)
+		row = 0;
+	self->crow = row;
+	self->ccol = 0;
 
-		// bring the character till cursor column
-		for (int i = line->len - 1; i > self->ccol; i--)
+	// skip the indentation
+	struct text_iter_t it;
+	const char *ptr = NULL;
+	long n = 0;
+	text_line_len(&self->text, self->crow, &len);
+	text_iter_row(&self->text, self->crow, &it);
+	while (self->ccol < len && text_iter_span(&it, &ptr, &n) == NO_ERR)
+	{
+		long i = 0;
+		while (i < n && self->ccol < len && (ptr[i] == ' ' || ptr[i] == '\t'))
 		{
-			char temp = line->text[i];
-			line->text[i] = line->text[i-1];
-			line->text[i-1] = temp;
+			i++;
+			self->ccol++;
 		}
+		if (i < n)
+			break;
+		text_iter_advance(&it, n);
+	}
+
+	// a far jump puts the line in the middle of the screen
+	int rows = self->screen_rows;
+	if (self->crow < self->offset_row || self->crow >= self->offset_row + rows)
+		self->offset_row = self->crow > rows / 2 ? self->crow - rows / 2 : 0;
+	return NO_ERR;
+}
+
+int ve_scroll(struct ve_t *self, long rows, long cursor)
+{
+	int lines = 0;
+	text_lines(&self->text, &lines);
+
+	long top = self->offset_row + rows;
+	if (top > lines - 1)
+		top = lines - 1;
+	if (top < 0)
+		top = 0;
+	self->offset_row = top;
+
+	long row = self->crow + cursor;
+	long bottom = top + self->screen_rows - 1;
+	if (row > bottom)
+		row = bottom;
+	if (row < top)
+		row = top;
+	if (row > lines - 1)
+		row = lines - 1;
+	long col = 0;
+	ve_col(self, &col);
+	self->crow = row;
+	return ve_goto_col(self, col);
+}
+
+int ve_add(struct ve_t *self, const char *src, int len)
+{
+	char ch = src[0];
+	if (len == 1 && ch != '\n' && (ch < 32 || ch > 126))
+		return NO_ERR;
+
+	long start = 0;
+	long version = self->text.version;
+	text_line_start(&self->text, self->crow, &start);
+	int err = text_insert(&self->text, start + self->ccol, src, len);
+	if (err)
+		return err;
+	undo_insert(&self->undo, &self->text, start + self->ccol, len,
+		self->crow, self->ccol);
 
-		// increase the cursor column value
-		self->ccol++;
+	if (ch == '\n')
+	{
+		// move the cursor to the start of the new line
+		self->crow++;
+		self->ccol = 0;
+	}
+	else
+	{
+		// the columns after the cursor move over by the new character
+		cols_insert(&self->cols, &self->text, version, self->crow,
+			self->ccol, len, utf8_cols(src, len));
+		self->ccol += len;
 	}
 	return NO_ERR;
 }
 
 int ve_delete(struct ve_t *self)
 {
-	if (self->ccol == 0 && self->crow > 0)
+	if (self->ccol == 0 && self->crow == 0)
+		return NO_ERR;
+
+	long start = 0;
+	text_line_start(&self->text, self->crow, &start);
+
+	if (self->ccol == 0)
 	{
-		// delete the newline
-		struct str_t *prev_line = self->lines + self->crow - 1;
-		struct str_t *cur_line = self->lines + self->crow;
-		int prev_line_pos = prev_line->len;
-		str_appends(prev_line, cur_line->text, cur_line->len);
-		str_free(cur_line);
-		for (int i = self->crow; i < self->sz - 1; i++)
-			self->lines[i] = self->lines[i+1];
+		// delete the newline; the cursor goes to the end of previous line
+		int prev_len = 0;
+		text_line_len(&self->text, self->crow - 1, &prev_len);
+		undo_delete(&self->undo, &self->text, start - 1, 1, self->crow,
+			self->ccol);
+		int err = text_delete(&self->text, start - 1, 1);
+		if (err)
+			return err;
 
-		// decrease the row value
-		self->sz--;
 		self->crow--;
-		self->ccol = prev_line_pos;
+		self->ccol = prev_len;
 	}
-	else if (self->ccol > 0)
+	else
 	{
-		struct str_t *line = self->lines + self->crow;
-		for (int i = self->ccol - 1; i < line->len - 1; i++)
-			line->text[i] = line->text[i+1];
-		
-		// decrease the column and line size
-		line->len--;
-		self->ccol--;
+		// the width of the character is read before it goes
+		long off = start + self->ccol, prev = 0, from = 0, to = 0;
+		long version = self->text.version;
+		cols_prev(&self->text, off, &prev);
+		cols_col(&self->cols, &self->text, self->crow, prev - start, &from);
+		cols_col(&self->cols, &self->text, self->crow, self->ccol, &to);
+
+		undo_delete(&self->undo, &self->text, prev, off - prev, self->crow,
+			self->ccol);
+		int err = text_delete(&self->text, prev, off - prev);
+		if (err)
+			return err;
+
+		// the cursor goes to where the character started
+		self->ccol = prev - start;
+		cols_delete(&self->cols, &self->text, version, self->crow,
+			self->ccol, off - prev, to - from);
 	}
 	return NO_ERR;
 }
 
-int ve_insert_mode(struct ve_t *self, int key)
+int ve_undo(struct ve_t *self)
 {
-	self->intro = 0;
+	int err = undo_undo(&self->undo, &self->text, &self->crow, &self->ccol);
+	if (err == RANGE_ERR)
+	{
+		const char *msg = "Already at oldest change";
+		str_appends(&self->msg, msg, strlen(msg));
+		return NO_ERR;
+	}
+
 	self->dirty = 1;
-	switch(key)
+	return err;
+}
+
+int ve_redo(struct ve_t *self)
+{
+	long off = 0;
+	int err = undo_redo(&self->undo, &self->text, &off);
+	if (err == RANGE_ERR)
 	{
-	case ENTER_KEY:
-		ve_add(self, '\n');
-		break;
-	case TAB_KEY:
-		{
-			int i = 0;
-			int col = self->ccol;
-			do {
-				ve_add(self, ' ');
-				i++;
-			}
-			while (i < 8 && (col + i) % 8 != 0);
-		}
-		break;
+		const char *msg = "Already at newest change";
+		str_appends(&self->msg, msg, strlen(msg));
+		return NO_ERR;
+	}
+	if (err)
+		return err;
+
+	// the cursor goes to the end of the last change
+	self->dirty = 1;
+	return text_pos(&self->text, off, &self->crow, &self->ccol);
+}
+
+int ve_read(struct ve_t *self, const char *path)
+{
+	long start = 0;
+	text_line_start(&self->text, self->crow, &start);
+
+	long len = 0, lf = 0;
+	int err = text_load(&self->text, start + self->ccol, path, &len, &lf);
+	if (err == NO_ERR)
+	{
+		// the file is one undo step; its bytes stay in their buffer
+		undo_close(&self->undo);
+		undo_insert(&self->undo, &self->text, start + self->ccol, len,
+			self->crow, self->ccol);
+		undo_close(&self->undo);
+	}
+	if (err)
+	{
+		char buffer[80];
+		snprintf(buffer, sizeof(buffer), "Couldn't open '%s'", path);
+		str_appends(&self->msg, buffer, strlen(buffer));
+		self->is_error = 1;
+		return err;
+	}
+
+	// the cursor goes to the end of the inserted content
+	long end = start + self->ccol + len;
+	self->crow += lf;
+	text_line_start(&self->text, self->crow, &start);
+	self->ccol = end - start;
+
+	char buffer[80];
+	snprintf(buffer, sizeof(buffer), "Read '%s' %ldL, %ldB", path, lf, len);
+	str_appends(&self->msg, buffer, strlen(buffer));
+	return NO_ERR;
+}
+
+int ve_insert_mode(struct ve_t *self, int key)
+{
+	self->intro = 0;
+	self->dirty = 1;
+	switch(key)
+	{
+	case ENTER_KEY:
+		ve_add(self, "\n", 1);
+		break;
+	case TAB_KEY:
+		{
+			// tab stops are display columns
+			int i = 0;
+			long col = 0;
+			ve_col(self, &col);
+			do {
+				ve_add(self, " ", 1);
+				i++;
+			}
+			while (i < COLS_TAB && (col + i) % COLS_TAB != 0);
+		}
+		break;
 	case DELETE_KEY:
-		if (self->crow != self->sz - 1 ||
-			self->ccol != self->lines[self->crow].len)
 		{
+			char eof = 0;
+			ve_eof(self, &eof);
+			if (eof)
+				break;
+
 			ve_next(self, RIGHT_KEY);
 			ve_delete(self);
 		}
@@ -347,7 +922,15 @@ int ve_insert_mode(struct ve_t *self, int key)
 	default:
 		// check if printable character
 		if (32 <= key && key <= 126)
-			ve_add(self, (char)key);
+		{
+			char ch = (char) key;
+			ve_add(self, &ch, 1);
+		}
+		else if (key >= UTF8_KEY + 0xa0)
+		{
+			char ch[UTF8_MAX];
+			ve_add(self, ch, utf8_encode(key - UTF8_KEY, ch));
+		}
 		break;
 	}
 	return NO_ERR;
@@ -355,87 +938,136 @@ int ve_insert_mode(struct ve_t *self, int key)
 
 int ve_normal_mode(struct ve_t *self, int key)
 {
+	// digits before a command are its count; a leading 0 is a motion
+	if (('1' <= key && key <= '9') || (key == '0' && self->count > 0))
+	{
+		if (self->count <= MOTION_MAX_COUNT / 10)
+			self->count = self->count * 10 + key - '0';
+		return NO_ERR;
+	}
+
+	// g and ctrl-w wait for the second key and keep the count
+	if ((key == 'g' || key == CTRL_KEY('w')) && self->prefix == 0)
+	{
+		self->prefix = key;
+		return NO_ERR;
+	}
+	int prefix = self->prefix;
+	int counted = self->count > 0;
+	long count = counted ? self->count : 1;
+	self->prefix = 0;
+	self->count = 0;
+
+	if (prefix == 'g')
+	{
+		if (key == 'g')
+			ve_jump(self, counted ? count - 1 : 0);
+		return NO_ERR;
+	}
+	if (prefix == CTRL_KEY('w'))
+	{
+		ve_window(self, key == CTRL_KEY('w') ? 'w' : key);
+		return NO_ERR;
+	}
+
+	// pages keep two rows of context; half pages are at least a row
+	int lines = 0;
+	text_lines(&self->text, &lines);
+	int page = self->screen_rows > 2 ? self->screen_rows - 2 : 1;
+	int half = self->screen_rows > 1 ? self->screen_rows / 2 : 1;
+
 	switch(key)
 	{
+	case 'G':
+		// past the last line; waits for the whole file
+		ve_jump(self, counted ? count - 1 : LONG_MAX);
+		break;
+	case '%':
+		// the line at count percent of the file
+		if (counted && count <= 100)
+		{
+			text_load_wait(&self->text, -1);
+			text_lines(&self->text, &lines);
+			ve_jump(self, (count * lines + 99) / 100 - 1);
+		}
+		break;
+	case CTRL_KEY('f'):
+	case CTRL_KEY('b'):
+		// the cursor only moves as far as the screen pushes it
+		ve_scroll(self, key == CTRL_KEY('f') ? count * page : -count * page,
+			0);
+		break;
+	case CTRL_KEY('d'):
+		ve_scroll(self, counted ? count : half, counted ? count : half);
+		break;
+	case CTRL_KEY('u'):
+		ve_scroll(self, counted ? -count : -half, counted ? -count : -half);
+		break;
 	case 'i':
 		self->mode = INSERT_MODE;
+		undo_close(&self->undo);
+		break;
+	case 'u':
+		ve_undo(self);
+		break;
+	case CTRL_KEY('r'):
+		ve_redo(self);
 		break;
 	case ':':
 		self->mode = PROMPT_MODE;
 		ve_prompt_mode(self, key);
 		break;
-	case 'h':
-		ve_next(self, LEFT_KEY);
-		break;
-	case 'j':
-		ve_next(self, DOWN_KEY);
+	case '/':
+		self->mode = PROMPT_MODE;
+		self->search_row = self->crow;
+		self->search_col = self->ccol;
+		ve_prompt_mode(self, key);
 		break;
-	case 'k':
-		ve_next(self, UP_KEY);
+	case 'n':
+	case 'N':
+		if (self->search.len == 0)
+		{
+			const char *msg = "No previous search";
+			str_appends(&self->msg, msg, strlen(msg));
+			self->is_error = 1;
+			break;
+		}
+		{
+			long start = 0;
+			text_line_start(&self->text, self->crow, &start);
+			ve_search(self, str_cstr(&self->search), self->search.len,
+				key == 'n', start + self->ccol + (key == 'n'), 1);
+		}
 		break;
+	case 'h':
 	case 'l':
-		ve_next(self, RIGHT_KEY);
+		ve_move(self, key == 'h' ? -count : count);
 		break;
-	case 'w':
+	case 'j':
+	case 'k':
 		{
-			// 0 = [a-zA-Z0-0_]
-			// 1 = any other non-whitespace
-			// 2 = whitespace
-			char res = 0;
-			ve_current(self, &res);
-			if ('a' <= res && res <= 'z' || 'A' <= res && res <= 'Z' ||
-				'0' <= res && res <= '9' || res == '_')
-				res = 0;
-			else if (res == ' ' || res == '\n' || res == 0)
-				res = 2;
-			else
-				res = 1;
-
-			for (char eof = 0; !eof; ve_eof(self, &eof))
-			{
-				char cur = 0;
-				ve_current(self, &cur);
-				if ('a' <= cur && cur <= 'z' || 'A' <= cur && cur <= 'Z' ||
-					'0' <= cur && cur <= '9' || cur == '_')
-					cur = 0;
-				else if (cur == ' ' || cur == '\n' || cur == 0)
-					cur = 2;
-				else
-					cur = 1;
-				if (cur == res) ve_next(self, RIGHT_KEY);
-				else break;
-			}	
-
-			for (char eof = 0; !eof; ve_eof(self, &eof))
-			{
-				char cur = 0;
-				ve_current(self, &cur);
-				if (cur == ' ' || cur == '\n')
-					ve_next(self, RIGHT_KEY);
-				else
-					break;
-			}
+			long col = 0;
+			long row = self->crow + (key == 'j' ? count : -count);
+			ve_col(self, &col);
+			self->crow = row < 0 ? 0 : row >= lines ? lines - 1 : row;
+			ve_goto_col(self, col);
 		}
 		break;
+	case 'w':
+	case 'b':
+	case 'e':
 	case 'W':
-		for (char eof = 0; !eof; ve_eof(self, &eof))
-		{
-			char cur = 0;
-			ve_current(self, &cur);
-			if (cur == ' ' || cur == '\n')
-				break;
-			ve_next(self, RIGHT_KEY);
-		}
-		for (char eof = 0; !eof; ve_eof(self, &eof))
+	case 'B':
+	case 'E':
 		{
-			char cur = 0;
-			ve_current(self, &cur);
-			if (cur == ' ' || cur == '\n')
-				ve_next(self, RIGHT_KEY);
-			else break;
+			long start = 0, off = 0;
+			text_line_start(&self->text, self->crow, &start);
+			motion_word(&self->text, start + self->ccol, key, count, &off);
+			text_pos(&self->text, off, &self->crow, &self->ccol);
 		}
+		break;
 	case '$':
-		self->ccol = self->lines[self->crow].len;
+		text_line_len(&self->text, self->crow, &self->ccol);
 		break;
 	case '0':
 		self->ccol = 0;
@@ -456,17 +1088,58 @@ int ve_prompt_mode(struct ve_t *self, int key)
 		str_free(&self->prompt);
 		str_init(&self->prompt);
 		break;
+	case LEFT_KEY:
+		// the cursor never goes before the ':'
+		if (self->prompt.gap > 1)
+			str_gap_move(&self->prompt,
+				ve_prompt_step(self, self->prompt.gap, -1));
+		break;
+	case RIGHT_KEY:
+		if (self->prompt.gap < self->prompt.len)
+			str_gap_move(&self->prompt,
+				ve_prompt_step(self, self->prompt.gap, 1));
+		break;
 	case BACKSPACE_KEY:
-		self->prompt.len--;
-		if (self->prompt.len == 0)
+		if (self->prompt.len == 1)
 		{
+			// an abandoned search goes back to where it started
+			if (ve_prompt_is_search(self))
+			{
+				self->crow = self->search_row;
+				self->ccol = self->search_col;
+			}
+			str_gap_delete(&self->prompt, 1, 0);
 			self->mode = NORMAL_MODE;
 		}
+		else if (self->prompt.gap > 1)
+		{
+			int gap = self->prompt.gap;
+			str_gap_delete(&self->prompt,
+				gap - ve_prompt_step(self, gap, -1), 0);
+			ve_search_prompt(self);
+		}
+		break;
+	case DELETE_KEY:
+		if (self->prompt.gap < self->prompt.len)
+		{
+			int gap = self->prompt.gap;
+			str_gap_delete(&self->prompt, 0,
+				ve_prompt_step(self, gap, 1) - gap);
+			ve_search_prompt(self);
+		}
 		break;
 	default:
-		// build the prompt
-		if (32 <= key && key <= 126)
-			str_appendc(&self->prompt, (char) key);
+		// insert at the prompt cursor
+		if ((32 <= key && key <= 126) || key >= UTF8_KEY + 0xa0)
+		{
+			char ch[UTF8_MAX];
+			int len = 1;
+			ch[0] = (char) key;
+			if (key >= UTF8_KEY)
+				len = utf8_encode(key - UTF8_KEY, ch);
+			str_gap_insert(&self->prompt, ch, len);
+			ve_search_prompt(self);
+		}
 		break;
 	}
 
@@ -479,45 +1152,141 @@ int ve_prompt_run(struct ve_t *self)
 	str_free(&self->msg);
 	str_init(&self->msg);
 
-	// create the prompt
-	char *prompt = NULL;
-	str_build(&self->prompt, &prompt);
-	
-	// set the whitespace to nullterminate
-	for (int i = 0; i < self->prompt.len; i++)
+	// searches are not commands
+	if (ve_prompt_is_search(self))
 	{
-		if (prompt[i] == ' ')
-		{
-			prompt[i] = 0;
-			break;
-		}
+		ve_prompt_run_search(self);
+		return NO_ERR;
+	}
+
+	// the prompt is read where it is; it is cleared after the command
+	const char *prompt = str_cstr(&self->prompt);
+
+	// a number is a line to jump to
+	if (prompt[0] == ':' && prompt[1] != 0 &&
+		strspn(prompt + 1, "0123456789") == strlen(prompt + 1))
+	{
+		ve_prompt_run_line(self, prompt);
+		return NO_ERR;
+	}
+
+	// substitutions may contain spaces
+	const char *sub = prompt[0] == ':' ? prompt + 1 : prompt;
+	if (sub[0] == '%')
+		sub++;
+	if (prompt[0] == ':' && sub[0] == 's' && sub[1] != 0 &&
+		strchr("/#|!,;", sub[1]) != NULL)
+	{
+		ve_prompt_run_substitute(self);
+		return NO_ERR;
 	}
+	
+	// the command is the word before the first space
+	char cmd[32];
+	snprintf(cmd, sizeof(cmd), "%.*s", (int) strcspn(prompt, " "), prompt);
 
 	// add a basic hello prompt
-	if (strcmp(prompt, ":hello") == 0)
+	if (strcmp(cmd, ":hello") == 0)
 		ve_prompt_run_hello(self);
-	else if (strcmp(prompt, ":discard") == 0)
+	else if (strcmp(cmd, ":discard") == 0)
 		ve_prompt_run_discard(self);
-	else if (strcmp(prompt, ":quit") == 0)
+	else if (strcmp(cmd, ":quit") == 0)
 		ve_prompt_run_quit(self);
-	else if (strcmp(prompt, ":saveas") == 0)
+	else if (strcmp(cmd, ":saveas") == 0)
 		ve_prompt_run_saveas(self);
-	else if (strcmp(prompt, ":read") == 0)
+	else if (strcmp(cmd, ":read") == 0)
 		ve_prompt_run_read(self);
-	else if (strcmp(prompt, ":write") == 0)
+	else if (strcmp(cmd, ":write") == 0)
 		ve_prompt_run_write(self);
+	else if (strcmp(cmd, ":frame") == 0)
+		ve_prompt_run_frame(self);
+	else if (strcmp(cmd, ":recover") == 0)
+		ve_prompt_run_recover(self);
+	else if (strcmp(cmd, ":deleteswap") == 0)
+		ve_prompt_run_deleteswap(self);
+	else if (strcmp(cmd, ":stats") == 0)
+		ve_prompt_run_stats(self);
+	else if (strcmp(cmd, ":trace") == 0)
+		ve_prompt_run_trace(self, self->prompt.len > 7 ? prompt + 7 : "");
+	else if (strcmp(cmd, ":edit") == 0)
+		ve_prompt_run_edit(self, self->prompt.len > 6 ? prompt + 6 : "");
+	else if (strcmp(cmd, ":bnext") == 0 && self->bufs)
+		ve_prompt_run_buffer(self, (self->bufs->cur + 1) % self->bufs->len);
+	else if (strcmp(cmd, ":bprev") == 0 && self->bufs)
+		ve_prompt_run_buffer(self, (self->bufs->cur + self->bufs->len - 1) %
+			self->bufs->len);
+	else if (strcmp(cmd, ":buffer") == 0 && self->bufs)
+		ve_prompt_run_buffer(self, self->prompt.len > 8 ?
+			atoi(prompt + 8) - 1 : self->bufs->cur);
+	else if (strcmp(cmd, ":ls") == 0 && self->bufs)
+		ve_prompt_run_ls(self);
+	else if (strcmp(cmd, ":split") == 0)
+		ve_window(self, 's');
+	else if (strcmp(cmd, ":vsplit") == 0)
+		ve_window(self, 'v');
+	else if (strcmp(cmd, ":close") == 0)
+		ve_window(self, 'c');
+	else if (strcmp(cmd, ":only") == 0)
+		ve_window(self, 'o');
 	else
 	{
 		char buffer[80];
-		snprintf(buffer, sizeof(buffer), "No such command '%s'", prompt);
+		snprintf(buffer, sizeof(buffer), "No such command '%s'", cmd);
 		self->is_error = 1;
 		str_appends(&self->msg, buffer, strlen(buffer));
 	}
 
-	free(prompt);
 	return NO_ERR;
 }
 
+void ve_window(struct ve_t *self, int key)
+{
+	struct wins_t *wins = self->bufs ? self->bufs->wins : NULL;
+	struct win_t *win = NULL;
+	const char *msg = NULL;
+	if (wins == NULL)
+	{
+		msg = "No windows";
+		key = 0;
+	}
+
+	switch (key)
+	{
+	case 's':
+	case 'v':
+		if (wins_split(wins, key == 's' ? WIN_ROWS : WIN_COLS))
+			msg = "No room for another window";
+		break;
+	case 'c':
+	case 'q':
+		if (wins_close(wins))
+			msg = "Cannot close the last window";
+		break;
+	case 'o':
+		wins_only(wins);
+		break;
+	case 'w':
+	case 'W':
+		wins_focus(wins, wins_next(wins, wins->cur, key == 'w' ? 1 : -1));
+		break;
+	case 'h':
+	case 'j':
+	case 'k':
+	case 'l':
+		win = wins_near(wins, (key == 'j') - (key == 'k'),
+			(key == 'l') - (key == 'h'));
+		if (win)
+			wins_focus(wins, win);
+		break;
+	}
+
+	if (msg)
+	{
+		str_appends(&self->msg, msg, strlen(msg));
+		self->is_error = 1;
+	}
+}
+
 void ve_prompt_run_hello(struct ve_t *self)
 {
 	static const char *msg = "Hello, World!";
@@ -526,20 +1295,41 @@ void ve_prompt_run_hello(struct ve_t *self)
 
 void ve_prompt_run_discard(struct ve_t *self)
 {
+	// the changes of every buffer are thrown away on purpose
+	int n = self->bufs ? self->bufs->len : 1;
+	for (int i = 0; i < n; i++)
+	{
+		struct ve_t *ve = self->bufs ? self->bufs->list[i] : self;
+		if (!ve->swap.found)
+			swap_remove(&ve->swap);
+	}
 	self->is_running = 0;
 }
 
 void ve_prompt_run_quit(struct ve_t *self)
 {
-	if (self->dirty)
+	// the other buffers have to be saved too
+	int unsaved = self->dirty ? 0 : -1;
+	for (int i = 0; self->bufs && unsaved < 0 && i < self->bufs->len; i++)
+		if (self->bufs->list[i]->dirty)
+			unsaved = i;
+
+	if (unsaved >= 0)
 	{
 		char buffer[80];
-		snprintf(buffer, sizeof(buffer), "File is not saved");
+		if (self->dirty)
+			snprintf(buffer, sizeof(buffer), "File is not saved");
+		else
+			snprintf(buffer, sizeof(buffer),
+				"Buffer %d is not saved; :buffer %d", unsaved + 1,
+				unsaved + 1);
 		str_appends(&self->msg, buffer, strlen(buffer));
 		self->is_error = 1;
 	}
 	else
 	{
+		if (!self->swap.found)
+			swap_remove(&self->swap);
 		self->is_running = 0;
 	}
 }
@@ -550,115 +1340,772 @@ void ve_prompt_run_saveas(struct ve_t *self)
 	str_init(&self->filename);
 
 	// get the filename argument
-	char *prompt = NULL;
-	str_build(&self->prompt, &prompt);
-	char buffer[80];
-	sscanf(prompt, ":saveas %s", buffer);
+	const char *prompt = str_cstr(&self->prompt);
+	char buffer[80] = "";
+	sscanf(prompt, ":saveas %79s", buffer);
 
 	// set the filename state
 	str_appends(&self->filename, buffer, strlen(buffer));
 
+	// the swap file follows the file
+	if (!self->swap.found)
+		swap_remove(&self->swap);
+	if (buffer[0])
+		swap_open(&self->swap, buffer);
+	syntax_open(&self->syntax, buffer);
+
 	// set the message
-	char buffer2[80];
-	snprintf(buffer2, sizeof(buffer2), "Filename changed to '%s'", buffer);
+	char buffer2[160];
+	snprintf(buffer2, sizeof(buffer2), "Filename changed to '%s'%s", buffer,
+		self->swap.found ? "; found a swap file, :recover or :deleteswap" :
+		"");
 	str_appends(&self->msg, buffer2, strlen(buffer2));
-
-	// free the prompt
-	free(prompt);
 }
 
 void ve_prompt_run_read(struct ve_t *self)
 {
 	// get the filename argument
-	char *prompt = NULL;
-	str_build(&self->prompt, &prompt);
-	char buffer[80];
-	sscanf(prompt, ":read %s", buffer);
+	const char *prompt = str_cstr(&self->prompt);
+	char buffer[80] = "";
+	sscanf(prompt, ":read %79s", buffer);
+	if (buffer[0] == 0)
+	{
+		const char *msg = "Filename not specified";
+		str_appends(&self->msg, msg, strlen(msg));
+		self->is_error = 1;
+		return;
+	}
+
+	// read the contents of the file in bulk
+	if (ve_read(self, buffer) == NO_ERR)
+	{
+		// set the file as dirty
+		self->dirty = 1;
+		self->intro = 0;
+	}
+}
+
+void ve_prompt_run_write(struct ve_t *self)
+{
+	if (self->filename.len == 0)
+	{
+		const char *msg = "Filename not specified";
+		str_appends(&self->msg, msg, strlen(msg));
+		self->is_error = 1;
+		return;
+	}
+
+	const char *filename = str_cstr(&self->filename);
 
-	// read the file content
-	FILE *fd = fopen(buffer, "r");
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	long bytes = 0;
+	int links = 0;
+	int err = ve_write(self, filename, &bytes, &links);
+	clock_gettime(CLOCK_MONOTONIC, &end);
 
-	// couldn't open the file
-	if (fd == NULL)
+	char buffer[160];
+	if (err)
 	{
-		char buffer2[80];
-		snprintf(buffer2, sizeof(buffer2), "Couldn't open '%s'", buffer);
-		str_appends(&self->msg, buffer2, strlen(buffer2));
+		snprintf(buffer, sizeof(buffer), "Couldn't write '%s'", filename);
+		str_appends(&self->msg, buffer, strlen(buffer));
 		self->is_error = 1;
-		free(prompt);
 		return;
 	}
 
-	// set the file as dirty
-	self->dirty = 1;
+	// send the message that the file is written
+	double secs = (end.tv_sec - start.tv_sec) +
+		(end.tv_nsec - start.tv_nsec) / 1e9;
+	int lines = 0;
+	text_lines(&self->text, &lines);
+	snprintf(buffer, sizeof(buffer), "'%s' %dL, %ldB written, %.1fMB/s%s",
+		filename, lines, bytes, secs > 0 ? bytes / secs / 1e6 : 0.0,
+		links ? "; its other hard links keep the old content" : "");
+	str_appends(&self->msg, buffer, strlen(buffer));
+
+	// not dirty anymore; the swap file is older than the file now
+	self->dirty = 0;
+	if (!self->swap.found)
+		swap_remove(&self->swap);
+}
+
+void ve_prompt_run_frame(struct ve_t *self)
+{
+	long frames = self->frames ? self->frames : 1;
+	char buffer[120];
+	snprintf(buffer, sizeof(buffer),
+		"Last frame %ldB %ldus, %ld frames, %ldB %ldus avg",
+		self->frame_bytes, self->frame_ns / 1000, self->frames,
+		self->frame_total / frames, self->frame_ns_total / frames / 1000);
+	str_appends(&self->msg, buffer, strlen(buffer));
+}
+
+void ve_prompt_run_stats(struct ve_t *self)
+{
+	// p50/p99/max of every stage in microseconds
+	char buffer[256];
+	int len = snprintf(buffer, sizeof(buffer), "p50/p99/max us:");
+	for (int i = 0; i < STATS_STAGES && len < (int) sizeof(buffer); i++)
+	{
+		long p50 = 0, p99 = 0, max = 0;
+		stats_get(&self->stats, i, &p50, &p99, &max);
+		len += snprintf(buffer + len, sizeof(buffer) - len,
+			" %s %.1f/%.1f/%.1f", stats_name(i),
+			p50 / 1e3, p99 / 1e3, max / 1e3);
+	}
+	str_appends(&self->msg, buffer, strlen(buffer));
+}
+
+void ve_prompt_run_recover(struct ve_t *self)
+{
+	char buffer[160];
+	if (!self->swap.found)
+	{
+		snprintf(buffer, sizeof(buffer), "No swap file to recover");
+		str_appends(&self->msg, buffer, strlen(buffer));
+		self->is_error = 1;
+		return;
+	}
+
+	// the swap file replaces the document
+	struct text_t text;
+	long len = 0, lf = 0;
+	int err = text_init(&text);
+	if (err == NO_ERR)
+		err = text_load_lazy(&text, self->swap.path, &len, &lf);
+	if (err)
+	{
+		text_free(&text);
+		snprintf(buffer, sizeof(buffer), "Couldn't read '%s'",
+			self->swap.path);
+		str_appends(&self->msg, buffer, strlen(buffer));
+		self->is_error = 1;
+		return;
+	}
+	// the version keeps counting so that nothing drawn from the old
+	// document is taken for the new one
+	text.version += self->text.version;
+	text_free(&self->text);
+	self->text = text;
+	syntax_clear(&self->syntax);
+	undo_free(&self->undo);
+	undo_init(&self->undo);
+	self->crow = 0;
+	self->ccol = 0;
+	self->offset_row = 0;
 	self->intro = 0;
 
-	// read the contents of the file
-	do {
-		char ch = fgetc(fd);
-		if (feof(fd)) break;
+	// it isn't saved yet; the next autosave replaces the swap file
+	self->dirty = 1;
+	self->swap.found = 0;
+	snprintf(buffer, sizeof(buffer), "Recovered '%s'; :write to keep it",
+		self->swap.path);
+	str_appends(&self->msg, buffer, strlen(buffer));
+}
 
-		ve_add(self, ch);
-	} while (1);
+void ve_prompt_run_deleteswap(struct ve_t *self)
+{
+	char buffer[160];
+	if (self->swap.path == NULL || swap_remove(&self->swap))
+	{
+		snprintf(buffer, sizeof(buffer), "Couldn't delete the swap file");
+		self->is_error = 1;
+	}
+	else
+		snprintf(buffer, sizeof(buffer), "Deleted '%s'", self->swap.path);
+	str_appends(&self->msg, buffer, strlen(buffer));
+}
 
-	fclose(fd);
+void ve_prompt_run_trace(struct ve_t *self, const char *path)
+{
+	while (path[0] == ' ')
+		path++;
 
-	// set the message
-	char buffer2[80];
-	snprintf(buffer2, sizeof(buffer2), "Read '%s'", buffer);
-	str_appends(&self->msg, buffer2, strlen(buffer2));
+	char buffer[160];
+	if (path[0] == 0)
+	{
+		// without a file the trace is toggled
+		int on = self->stats.trace == NULL;
+		if (stats_trace(&self->stats, on))
+		{
+			snprintf(buffer, sizeof(buffer), "Couldn't start tracing");
+			self->is_error = 1;
+		}
+		else
+			snprintf(buffer, sizeof(buffer), on ?
+				"Tracing the last %d frames" : "Stopped tracing",
+				STATS_TRACE);
+	}
+	else if (self->stats.trace == NULL)
+	{
+		snprintf(buffer, sizeof(buffer), "Not tracing; run :trace first");
+		self->is_error = 1;
+	}
+	else if (stats_dump(&self->stats, path))
+	{
+		snprintf(buffer, sizeof(buffer), "Couldn't write '%s'", path);
+		self->is_error = 1;
+	}
+	else
+	{
+		long frames = self->stats.traced;
+		if (frames > STATS_TRACE)
+			frames = STATS_TRACE;
+		snprintf(buffer, sizeof(buffer), "'%s' %ld frames traced",
+			path, frames);
+	}
+	str_appends(&self->msg, buffer, strlen(buffer));
+}
 
-	// free the prompt
-	free(prompt);
+void ve_prompt_run_line(struct ve_t *self, const char *prompt)
+{
+	// :0 is the first line like :1
+	ve_jump(self, atol(prompt + 1) - 1);
 }
 
-void ve_prompt_run_write(struct ve_t *self)
+void ve_prompt_run_edit(struct ve_t *self, const char *path)
 {
-	if (self->filename.len == 0)
+	while (path[0] == ' ')
+		path++;
+
+	char buffer[160];
+	int found = 0;
+	if (self->bufs == NULL || path[0] == 0)
 	{
-		const char *msg = "Filename not specified";
-		str_appends(&self->msg, msg, strlen(msg));
+		snprintf(buffer, sizeof(buffer), self->bufs ?
+			"Filename not specified" : "No buffer list");
+		str_appends(&self->msg, buffer, strlen(buffer));
+		self->is_error = 1;
+	}
+	else if (bufs_open(self->bufs, path, &found) == MALLOC_ERR)
+	{
+		snprintf(buffer, sizeof(buffer), "Couldn't open '%s'", path);
+		str_appends(&self->msg, buffer, strlen(buffer));
+		self->is_error = 1;
+	}
+	else if (found)
+		ve_prompt_run_buffer(self, self->bufs->cur);
+}
+
+void ve_prompt_run_buffer(struct ve_t *self, int i)
+{
+	char buffer[200];
+	if (bufs_switch(self->bufs, i))
+	{
+		snprintf(buffer, sizeof(buffer), "No buffer %d", i + 1);
+		str_appends(&self->msg, buffer, strlen(buffer));
 		self->is_error = 1;
 		return;
 	}
 
-	// read the file content
-	char *filename = NULL;
-	str_build(&self->filename, &filename);
-	FILE *fd = fopen(filename, "w");
+	// the message is shown by the buffer switched to
+	struct ve_t *ve = bufs_cur(self->bufs);
+	const char *name = str_cstr(&ve->filename);
+	snprintf(buffer, sizeof(buffer), "[%d/%d] '%s'%s", i + 1,
+		self->bufs->len, name[0] ? name : "[No Name]",
+		ve->dirty ? " [Modified]" : "");
+	str_free(&ve->msg);
+	str_init(&ve->msg);
+	str_appends(&ve->msg, buffer, strlen(buffer));
+	ve->is_error = 0;
+}
 
-	// couldn't open the file
-	if (fd == NULL)
+void ve_prompt_run_ls(struct ve_t *self)
+{
+	// one entry per buffer; > marks the shown one and + the unsaved ones
+	for (int i = 0; i < self->bufs->len; i++)
 	{
-		char buffer[80];
-		snprintf(buffer, sizeof(buffer), "Couldn't open '%s'", filename);
+		struct ve_t *ve = self->bufs->list[i];
+		const char *name = str_cstr(&ve->filename);
+		char buffer[200];
+		snprintf(buffer, sizeof(buffer), "%s%s%d %s%s", i ? "  " : "",
+			i == self->bufs->cur ? ">" : "", i + 1,
+			name[0] ? name : "[No Name]", ve->dirty ? "+" : "");
+		str_appends(&self->msg, buffer, strlen(buffer));
+	}
+}
+
+void ve_prompt_run_substitute(struct ve_t *self)
+{
+	const char *prompt = str_cstr(&self->prompt);
+
+	// :[%]s/pattern/replacement/[g]
+	const char *p = prompt + 1;
+	int all = *p == '%';
+	p += all + 1;
+	if (all)
+		text_load_wait(&self->text, -1);
+	char delim = *p++;
+
+	struct str_t pat, repl;
+	str_init(&pat);
+	str_init(&repl);
+	struct str_t *parts[2] = {&pat, &repl};
+	for (int i = 0; i < 2; i++)
+	{
+		for (; *p && *p != delim; p++)
+		{
+			// an escaped delimiter is part of the text
+			if (*p == '\\' && p[1] == delim)
+				p++;
+			else if (*p == '\\' && p[1])
+				str_appendc(parts[i], *p++);
+			str_appendc(parts[i], *p);
+		}
+		if (*p == delim)
+			p++;
+	}
+	int global = strchr(p, 'g') != NULL;
+
+	// an empty pattern uses the last search
+	const char *pattern = str_cstr(pat.len > 0 ? &pat : &self->search);
+	const char *replacement = str_cstr(&repl);
+	long plen = strlen(pattern);
+
+	int err = plen > 0 ? regex_compile(&self->re, pattern, plen) :
+		RANGE_ERR;
+	char buffer[160];
+	if (err)
+	{
+		snprintf(buffer, sizeof(buffer), "Invalid pattern: %.80s", pattern);
 		str_appends(&self->msg, buffer, strlen(buffer));
 		self->is_error = 1;
-		free(filename);
+	}
+	else
+	{
+		int lines = 0, subs = 0, changed = 0;
+		text_lines(&self->text, &lines);
+		err = ve_substitute(self, &self->re, replacement, repl.len, global,
+			all ? 0 : self->crow, all ? lines - 1 : self->crow, &subs,
+			&changed);
+
+		if (subs == 0)
+		{
+			snprintf(buffer, sizeof(buffer), "Pattern not found: %.80s",
+				pattern);
+			self->is_error = 1;
+		}
+		else
+			snprintf(buffer, sizeof(buffer), "%d substitutions on %d lines",
+				subs, changed);
+		str_appends(&self->msg, buffer, strlen(buffer));
+		if (subs > 0)
+		{
+			self->dirty = 1;
+			self->intro = 0;
+		}
+	}
+
+	str_free(&pat);
+	str_free(&repl);
+}
+
+void ve_prompt_run_search(struct ve_t *self)
+{
+	// an empty pattern repeats the last search
+	const char *prompt = str_cstr(&self->prompt);
+	if (self->prompt.len > 1)
+	{
+		str_free(&self->search);
+		str_init(&self->search);
+		str_appends(&self->search, prompt + 1, self->prompt.len - 1);
+	}
+
+	self->crow = self->search_row;
+	self->ccol = self->search_col;
+	if (self->search.len == 0)
 		return;
+
+	long start = 0;
+	text_line_start(&self->text, self->crow, &start);
+	ve_search(self, str_cstr(&self->search), self->search.len, 1,
+		start + self->ccol + 1, 1);
+}
+
+int ve_search(struct ve_t *self, const char *pat, int plen, int forward,
+	long from, int report)
+{
+	// searching while typing looks at what is loaded so far
+	if (report)
+		text_load_wait(&self->text, -1);
+
+	long total = 0;
+	text_len(&self->text, &total);
+	if (from > total)
+		from = total;
+
+	struct regex_t *re = &self->re;
+	int err = regex_compile(re, pat, plen);
+	if (err)
+	{
+		if (report && err == RANGE_ERR)
+		{
+			char buffer[160];
+			snprintf(buffer, sizeof(buffer), "Invalid pattern: %.*s",
+				plen > 80 ? 80 : plen, pat);
+			str_appends(&self->msg, buffer, strlen(buffer));
+			self->is_error = 1;
+		}
+		return err;
 	}
 
-	// write the contents of the file
-	int bytes = 0;
-	for (int i = 0; i < self->sz; i++)
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	// search up to the end of the text first and wrap around after
+	long found = -1, scanned = 0;
+	int wrapped = 0;
+	if (re->lit_len == 0)
+		ve_search_regex(self, re, forward, from, &found, &scanned, &wrapped);
+	else if (forward)
+	{
+		// plain patterns skip the automata and use the vector search
+		const char *lit = re->lit;
+		long llen = re->lit_len;
+		text_search(&self->text, lit, llen, from, total, &found);
+		scanned = found < 0 ? total - from : found - from + llen;
+		if (found < 0)
+		{
+			wrapped = 1;
+			text_search(&self->text, lit, llen, 0, from, &found);
+			scanned += found < 0 ? from : found + llen;
+		}
+	}
+	else
 	{
-		char *line = NULL;
-		str_build(&self->lines[i], &line);
-		bytes += fprintf(fd, "%s", line);
-		if (i != self->sz - 1)
-			bytes += fprintf(fd, "\n");
-		free(line);
+		const char *lit = re->lit;
+		long llen = re->lit_len;
+		text_search_back(&self->text, lit, llen, 0, from, &found);
+		scanned = found < 0 ? from : from - found;
+		if (found < 0)
+		{
+			wrapped = 1;
+			text_search_back(&self->text, lit, llen, from, total, &found);
+			scanned += found < 0 ? total - from : total - found;
+		}
 	}
 
-	// send the message that the file is written
-	char buffer[80];
-	snprintf(buffer, sizeof(buffer), "'%s' %dL, %dB written", 
-		filename, self->sz, bytes);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double secs = (end.tv_sec - start.tv_sec) +
+		(end.tv_nsec - start.tv_nsec) / 1e9;
+
+	if (found >= 0)
+		text_pos(&self->text, found, &self->crow, &self->ccol);
+	if (!report)
+		return found < 0 ? RANGE_ERR : NO_ERR;
+
+	char buffer[160];
+	if (found < 0)
+	{
+		snprintf(buffer, sizeof(buffer), "Pattern not found: %.*s",
+			plen > 80 ? 80 : plen, pat);
+		self->is_error = 1;
+	}
+	else
+		snprintf(buffer, sizeof(buffer), "%c%.*s%s %.1fMB/s",
+			forward ? '/' : '?', plen > 80 ? 80 : plen, pat,
+			wrapped ? " [wrapped]" : "",
+			secs > 0 ? scanned / secs / 1e6 : 0.0);
 	str_appends(&self->msg, buffer, strlen(buffer));
+	return found < 0 ? RANGE_ERR : NO_ERR;
+}
 
-	// not dirty anymore
-	self->dirty = 0;
+int ve_search_regex(struct ve_t *self, struct regex_t *re, int forward,
+	long from, long *found, long *scanned, int *wrapped)
+{
+	*found = -1;
+	*scanned = 0;
+	*wrapped = 0;
+	int lines = 0, row = 0, col = 0;
+	text_lines(&self->text, &lines);
+	text_pos(&self->text, from, &row, &col);
+
+	struct str_t buf;
+	str_init(&buf);
+
+	// the line of the cursor is searched again last for the other part
+	int err = NO_ERR;
+	for (int k = 0; k <= lines && *found < 0; k++)
+	{
+		int r = forward ? row + k : row - k;
+		if (r >= lines || r < 0)
+		{
+			*wrapped = 1;
+			r = forward ? r - lines : r + lines;
+		}
+
+		long start = 0, len = 0;
+		const char *line = NULL;
+		err = ve_line(self, r, &buf, &start, &line, &len);
+		if (!err)
+			err = regex_line(re, line, len);
+		if (err)
+			break;
+		*scanned += len + 1;
+
+		// matches must start in [lo, hi)
+		long lo = 0, hi = len + 1;
+		if (k == 0 && forward)
+			lo = col;
+		else if (k == 0)
+			hi = col;
+		else if (k == lines && forward)
+			hi = col;
+		else if (k == lines)
+			lo = col;
+
+		// the last match before hi is the first one going backward
+		long s = 0, e = 0;
+		if (forward)
+			regex_next(re, lo, &s, &e);
+		else
+			regex_prev(re, hi, &s, &e);
+		if (s >= lo && s < hi)
+			*found = start + s;
+	}
+
+	str_free(&buf);
+	return err;
+}
+
+int ve_substitute(struct ve_t *self, struct regex_t *re, const char *repl,
+	long rlen, int global, int first, int last, int *subs, int *lines)
+{
+	*subs = 0;
+	*lines = 0;
+
+	struct str_t buf, out;
+	str_init(&buf);
+	str_init(&out);
+	undo_close(&self->undo);
+
+	int err = NO_ERR;
+	for (int row = first; row <= last && !err; row++)
+	{
+		long start = 0, len = 0;
+		const char *line = NULL;
+		err = ve_line(self, row, &buf, &start, &line, &len);
+		if (!err)
+			err = regex_line(re, line, len);
+		if (err)
+			break;
+
+		// rebuild the part of the line from the first to the last match
+		str_clear(&out);
+		long from = 0, pos = -1, head = 0;
+		int n = 0;
+		while (from <= len)
+		{
+			long s = 0, e = 0;
+			regex_next(re, from, &s, &e);
+			if (s < 0)
+				break;
+			if (pos < 0)
+				head = pos = s;
+			str_appends(&out, line + pos, s - pos);
+			ve_expand(repl, rlen, line + s, e - s, &out);
+			pos = e;
+			n++;
+
+			// an empty match moves on by one character
+			if (!global)
+				break;
+			from = e > s ? e : e + 1;
+		}
+		if (n == 0)
+			continue;
+
+		// one delete and one insert replace the changed part
+		undo_delete(&self->undo, &self->text, start + head, pos - head,
+			self->crow, self->ccol);
+		err = text_delete(&self->text, start + head, pos - head);
+		const char *src = str_cstr(&out);
+		if (!err)
+			err = text_insert(&self->text, start + head, src, out.len);
+		if (err)
+			break;
+		undo_insert(&self->undo, &self->text, start + head, out.len,
+			self->crow, self->ccol);
+
+		// inserted newlines push the remaining lines down
+		int added = 0;
+		for (long i = 0; i < out.len; i++)
+			added += src[i] == '\n';
+		row += added;
+		last += added;
+
+		*subs += n;
+		(*lines)++;
+		self->crow = row;
+		self->ccol = 0;
+	}
+
+	undo_close(&self->undo);
+	str_free(&buf);
+	str_free(&out);
+	return err;
+}
+
+int ve_expand(const char *repl, long rlen, const char *match, long mlen,
+	struct str_t *dest)
+{
+	int err = NO_ERR;
+	for (long i = 0; i < rlen && !err; i++)
+	{
+		char ch = repl[i];
+		if (ch == '&')
+		{
+			err = str_appends(dest, match, mlen);
+			continue;
+		}
+		if (ch == '\\' && i + 1 < rlen)
+		{
+			ch = repl[++i];
+			if (ch == 'n')
+				ch = '\n';
+			else if (ch == 't')
+				ch = '\t';
+		}
+		err = str_appendc(dest, ch);
+	}
+	return err;
+}
+
+int ve_line(struct ve_t *self, int row, struct str_t *buf, long *start,
+	const char **ptr, long *len)
+{
+	int n = 0;
+	int err = text_line_start(&self->text, row, start);
+	if (!err)
+		err = text_line_len(&self->text, row, &n);
+	if (err)
+		return err;
+	*len = n;
+	*ptr = "";
+	if (n == 0)
+		return NO_ERR;
+
+	const char *span = NULL;
+	long span_len = 0;
+	text_span(&self->text, *start, &span, &span_len);
+	if (span_len >= n)
+	{
+		*ptr = span;
+		return NO_ERR;
+	}
+
+	// the line crosses pieces
+	str_clear(buf);
+	for (long done = 0; done < n; done += span_len)
+	{
+		text_span(&self->text, *start + done, &span, &span_len);
+		if (span_len > n - done)
+			span_len = n - done;
+		err = str_appends(buf, span, span_len);
+		if (err)
+			return err;
+	}
+	*ptr = str_cstr(buf);
+	return NO_ERR;
+}
+
+int ve_search_prompt(struct ve_t *self)
+{
+	if (!ve_prompt_is_search(self))
+		return NO_ERR;
+
+	// every change of the pattern searches again from the start
+	self->crow = self->search_row;
+	self->ccol = self->search_col;
+	if (self->prompt.len == 1)
+		return NO_ERR;
+
+	// the gap is the cursor of the prompt and goes back after the search
+	int gap = self->prompt.gap;
+	const char *prompt = str_cstr(&self->prompt);
+	long start = 0;
+	text_line_start(&self->text, self->crow, &start);
+	ve_search(self, prompt + 1, self->prompt.len - 1, 1,
+		start + self->ccol + 1, 0);
+	return str_gap_move(&self->prompt, gap);
+}
+
+int ve_prompt_is_search(struct ve_t *self)
+{
+	const char *span = NULL;
+	int len = 0;
+	if (self->prompt.len == 0 ||
+		str_span(&self->prompt, 0, &span, &len) != NO_ERR)
+		return 0;
+	return span[0] == '/';
+}
+
+int ve_write(struct ve_t *self, const char *path, long *res, int *links)
+{
+	// the whole file has to be loaded before it is written
+	*links = 0;
+	int err = text_load_wait(&self->text, -1);
+	if (err)
+		return err;
+
+	// the file a symlink points to is replaced, not the symlink; a file
+	// that doesn't exist yet is written where it is named
+	char *real = realpath(path, NULL);
+	if (real != NULL)
+		path = real;
+
+	// write next to the file and rename it over the file at the end
+	// the old file may still be memory mapped by the document, so it is
+	// never written in place
+	char *tmp = (char *) malloc(strlen(path) + 8);
+	if (tmp == NULL)
+	{
+		free(real);
+		return MALLOC_ERR;
+	}
+	sprintf(tmp, "%s.XXXXXX", path);
+	int fd = mkstemp(tmp);
+	if (fd == -1)
+	{
+		free(tmp);
+		free(real);
+		return IO_ERR;
+	}
 
-	// filename
-	free(filename);
+	err = text_write(&self->text, fd, res);
+	if (!err && VE_FSYNC && fsync(fd) != 0)
+		err = IO_ERR;
+
+	// keep the owner and the permissions of the old file; mkstemp always
+	// gives 0600 and the user running the editor, who may not be allowed
+	// to give the file away
+	struct stat st;
+	mode_t mode;
+	if (stat(path, &st) == 0)
+	{
+		mode = st.st_mode & 07777;
+		if (!err && fchown(fd, st.st_uid, st.st_gid) != 0 &&
+			errno != EPERM)
+			err = IO_ERR;
+		*links = st.st_nlink > 1;
+	}
+	else
+	{
+		mode_t mask = umask(0);
+		umask(mask);
+		mode = 0666 & ~mask;
+	}
+	if (!err && fchmod(fd, mode) != 0)
+		err = IO_ERR;
+
+	if (close(fd) != 0)
+		err = IO_ERR;
+	if (!err && rename(tmp, path) != 0)
+		err = IO_ERR;
+	if (err)
+		unlink(tmp);
+
+	free(tmp);
+	free(real);
+	return err;
 }
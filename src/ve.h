@@ -1,8 +1,17 @@
 #ifndef VE_H
 #define VE_H
 
+#include "cols.h"
+#include "regex.h"
+#include "stats.h"
+#include "swap.h"
+#include "syntax.h"
+#include "text.h"
+#include "undo.h"
 #include "util.h"
 
+struct bufs_t;
+
 enum
 {
 	UP_KEY = 1000,
@@ -15,8 +24,19 @@ enum
 	ESC_KEY,
 	QUIT_KEY,
 	TAB_KEY,
+	PASTE_KEY,
 };
 
+/**
+ * key of a character typed as utf-8; the code point is added to it
+ */
+#define UTF8_KEY 0x1000000
+
+/**
+ * key sent by ctrl and the given letter
+ */
+#define CTRL_KEY(k) ((k) & 0x1f)
+
 enum
 {
 	NORMAL_MODE = 0,
@@ -24,14 +44,22 @@ enum
 	PROMPT_MODE,
 };
 
+/**
+ * flush a written file to the disk before renaming it over the old one
+ * build with -DVE_FSYNC=0 to trade durability for faster saves
+ */
+#ifndef VE_FSYNC
+#define VE_FSYNC 1
+#endif
+
 /**
  * visual editor
  *
  * members:
- *	lines		array of string to store lines
- *	sz		number of lines
+ *	text		piece table storing the document
+ *	undo		log of the changes to the document
  *	crow		cursor position; row
- *	ccol		cursor position; col
+ *	ccol		cursor position; byte offset in the row
  *	is_running	is the editor running?
  *	mode		current mode
  *	prompt		current prompt command
@@ -40,11 +68,34 @@ enum
  *	dirty		is the state dirtied
  *	filename	name of the file
  *	intro		should the editor show intro
+ *	search		last searched pattern
+ *	search_row	cursor row when the search prompt was opened
+ *	search_col	cursor column when the search prompt was opened
+ *	re		last compiled pattern; its memory is kept for the next
+ *			one so that searching while typing allocates nothing
+ *	count		count typed before a normal mode command; 0 for none
+ *	prefix		first key of a two key normal mode command; 0 for none
+ *	offset_row	first row shown on the screen
+ *	offset_col	first display column shown on the screen
+ *	screen_rows	number of rows of text the screen shows
+ *	frame_bytes	bytes sent to the terminal by the last frame
+ *	frame_total	bytes sent to the terminal by every frame
+ *	frames		number of frames sent
+ *	frame_ns	nanoseconds spent building the last frame
+ *	frame_ns_total	nanoseconds spent building every frame
+ *	stats		latency of the stages of the frames; measured by the
+ *			terminal
+ *	swap		swap file of the document; written by ve_autosave
+ *	syntax		highlighting of the document; kept up to date by the
+ *			terminal
+ *	bufs		buffer list holding the editor; NULL if it is alone
+ *	cols		display columns of the cursor line; kept up to date
+ *			by typing
  */
 struct ve_t
 {
-	struct str_t *lines;
-	int sz;
+	struct text_t text;
+	struct undo_t undo;
 
 	int crow;
 	int ccol;
@@ -60,6 +111,30 @@ struct ve_t
 	struct str_t filename;
 
 	int intro;
+
+	struct str_t search;
+	int search_row;
+	int search_col;
+	struct regex_t re;
+
+	long count;
+	int prefix;
+
+	int offset_row;
+	int offset_col;
+	int screen_rows;
+
+	long frame_bytes;
+	long frame_total;
+	long frames;
+	long frame_ns;
+	long frame_ns_total;
+
+	struct stats_t stats;
+	struct swap_t swap;
+	struct syntax_t syntax;
+	struct bufs_t *bufs;
+	struct cols_t cols;
 };
 
 /**
@@ -78,15 +153,49 @@ int ve_init(struct ve_t *self);
  */
 int ve_free(struct ve_t *self);
 
+/**
+ * open a file for editing
+ * a missing file gives an empty document with the given name
+ *
+ * params:
+ *	self	self pointer
+ *	path	path of the file
+ */
+int ve_open(struct ve_t *self, const char *path);
+
+/**
+ * insert a block of text at the cursor in one go; used for pastes
+ * the cursor goes to the end of the inserted text
+ * in prompt mode the printable characters and utf-8 go into the prompt
+ *
+ * params:
+ *	self	self pointer
+ *	src	text that will be inserted
+ *	len	length of the text
+ */
+int ve_insert(struct ve_t *self, const char *src, long len);
+
 /**
  * move to the next state of the editor based on key
  *
  * params:
  *	self	self pointer
- *	key	keyboard input; *_KEY or printable ascii value
- *		i.e. 32 <= key && key <= 126
+ *	key	keyboard input; *_KEY, printable ascii value
+ *		i.e. 32 <= key && key <= 126, or UTF8_KEY + code point
  */
 int ve_next(struct ve_t *self, int key);
 
+/**
+ * write the document to its swap file in the background once it has
+ * been changed for SWAP_MS; the caller keeps calling it as time passes
+ * an old swap file found on open is kept until :recover or :deleteswap
+ *
+ * params:
+ *	self	self pointer
+ *	now	monotonic clock in nanoseconds
+ *	wait	where the milliseconds until the next call is needed are
+ *		given; -1 if it is only needed after the next change
+ */
+int ve_autosave(struct ve_t *self, long now, int *wait);
 
 #endif // VE_H
@@ -0,0 +1,334 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bufs.h"
+#include "text.h"
+#include "util.h"
+#include "ve.h"
+#include "win.h"
+
+// ========================================
+// helper declaration
+// ========================================
+
+/**
+ * allocate a window showing a buffer
+ *
+ * params:
+ *	from	window whose buffer, cursor and offsets are copied
+ *	res	where the window is given
+ */
+int wins_new(struct win_t *from, struct win_t **res);
+
+/**
+ * free a window and every window inside it
+ *
+ * params:
+ *	win	window; may be NULL
+ */
+void wins_drop(struct win_t *win);
+
+/**
+ * give a window and the windows inside it their rectangles
+ *
+ * params:
+ *	self	self pointer
+ *	win	window
+ *	row	first row
+ *	col	first column
+ *	rows	number of rows
+ *	cols	number of columns
+ */
+void wins_place(struct wins_t *self, struct win_t *win, int row, int col,
+	int rows, int cols);
+
+/**
+ * first or last window showing a buffer inside a window
+ *
+ * params:
+ *	win	window
+ *	side	0 for the first, 1 for the last
+ */
+struct win_t *wins_edge(struct win_t *win, int side);
+
+/**
+ * window showing a buffer at a cell of the screen; NULL if there is none
+ *
+ * params:
+ *	self	self pointer
+ *	row	row of the cell
+ *	col	column of the cell
+ */
+struct win_t *wins_at(struct wins_t *self, int row, int col);
+
+// ========================================
+// win.h - definition
+// ========================================
+
+int wins_init(struct wins_t *self, struct bufs_t *bufs)
+{
+	self->bufs = bufs;
+	self->rows = 0;
+	self->cols = 0;
+	self->root = (struct win_t *) calloc(1, sizeof(struct win_t));
+	if (self->root == NULL)
+		return MALLOC_ERR;
+	self->cur = self->root;
+	self->cur->ve = bufs_cur(bufs);
+	bufs->wins = self;
+	wins_sync(self);
+	return NO_ERR;
+}
+
+int wins_free(struct wins_t *self)
+{
+	wins_drop(self->root);
+	if (self->bufs)
+		self->bufs->wins = NULL;
+	self->root = NULL;
+	self->cur = NULL;
+	return NO_ERR;
+}
+
+int wins_layout(struct wins_t *self, int rows, int cols)
+{
+	self->rows = rows > 0 ? rows : 0;
+	self->cols = cols > 0 ? cols : 0;
+	wins_place(self, self->root, 0, 0, self->rows, self->cols);
+	wins_sync(self);
+	return NO_ERR;
+}
+
+void wins_sync(struct wins_t *self)
+{
+	struct win_t *cur = self->cur;
+	struct ve_t *ve = bufs_cur(self->bufs);
+	cur->ve = ve;
+	cur->crow = ve->crow;
+	cur->ccol = ve->ccol;
+	cur->offset_row = ve->offset_row;
+	cur->offset_col = ve->offset_col;
+	ve->screen_rows = cur->text_rows > 0 ? cur->text_rows : 1;
+}
+
+int wins_split(struct wins_t *self, int split)
+{
+	// both halves need a row of text and a status line, or a column each
+	// and the separator
+	struct win_t *cur = self->cur;
+	if (split == WIN_ROWS ? cur->rows < 4 : cur->cols < 3)
+		return RANGE_ERR;
+	wins_sync(self);
+
+	// the window becomes the split and its copies the two halves
+	struct win_t *top = NULL, *bottom = NULL;
+	int err = wins_new(cur, &top);
+	if (err == NO_ERR)
+		err = wins_new(cur, &bottom);
+	if (err)
+	{
+		free(top);
+		return err;
+	}
+	cur->split = split;
+	cur->child[0] = top;
+	cur->child[1] = bottom;
+	top->parent = cur;
+	bottom->parent = cur;
+
+	// the new window is the first one and shows the same place
+	self->cur = top;
+	return wins_layout(self, self->rows, self->cols);
+}
+
+int wins_close(struct wins_t *self)
+{
+	struct win_t *cur = self->cur;
+	struct win_t *parent = cur->parent;
+	if (parent == NULL)
+		return RANGE_ERR;
+	wins_sync(self);
+
+	// the other half takes the place of the split
+	struct win_t *other = parent->child[parent->child[0] == cur];
+	struct win_t *up = parent->parent;
+	*parent = *other;
+	parent->parent = up;
+	for (int i = 0; i < 2; i++)
+		if (parent->child[i])
+			parent->child[i]->parent = parent;
+	free(other);
+	free(cur);
+
+	// the focus goes to the first window of that half; nothing is kept
+	// of the closed one
+	self->cur = wins_edge(parent, 0);
+	wins_layout(self, self->rows, self->cols);
+	return wins_focus(self, self->cur);
+}
+
+int wins_only(struct wins_t *self)
+{
+	struct win_t *cur = self->cur;
+	struct win_t *parent = cur->parent;
+	if (parent == NULL)
+		return NO_ERR;
+	wins_sync(self);
+
+	parent->child[parent->child[1] == cur] = NULL;
+	wins_drop(self->root);
+	cur->parent = NULL;
+	self->root = cur;
+	return wins_layout(self, self->rows, self->cols);
+}
+
+int wins_focus(struct wins_t *self, struct win_t *win)
+{
+	if (win != self->cur)
+		wins_sync(self);
+	self->cur = win;
+
+	// another window may have shortened the document meanwhile
+	struct ve_t *ve = win->ve;
+	int lines = 0, len = 0;
+	text_lines(&ve->text, &lines);
+	ve->crow = win->crow < lines ? win->crow : lines - 1;
+	text_line_len(&ve->text, ve->crow, &len);
+	ve->ccol = win->ccol < len ? win->ccol : len;
+	ve->offset_row = win->offset_row;
+	ve->offset_col = win->offset_col;
+
+	for (int i = 0; i < self->bufs->len; i++)
+		if (self->bufs->list[i] == ve)
+			bufs_switch(self->bufs, i);
+	wins_sync(self);
+	return NO_ERR;
+}
+
+struct win_t *wins_next(struct wins_t *self, struct win_t *win, int step)
+{
+	int side = step > 0;
+	if (win == NULL)
+		return wins_edge(self->root, 0);
+
+	// up to the first split the window isn't on the far side of
+	while (win->parent && win->parent->child[side] == win)
+		win = win->parent;
+	if (win->parent == NULL)
+		return wins_edge(self->root, !side);
+	return wins_edge(win->parent->child[side], !side);
+}
+
+struct win_t *wins_near(struct wins_t *self, int drow, int dcol)
+{
+	wins_sync(self);
+
+	// the neighbour is the window next to the cursor
+	struct win_t *cur = self->cur;
+	int row = cur->row + cur->crow - cur->offset_row;
+	int col = cur->col + cur->ccol - cur->offset_col;
+	if (row >= cur->row + cur->text_rows)
+		row = cur->row + cur->text_rows - 1;
+	if (col >= cur->col + cur->cols)
+		col = cur->col + cur->cols - 1;
+	if (col < cur->col)
+		col = cur->col;
+
+	// a separator column is skipped on the way to the left or right
+	if (drow < 0)
+		row = cur->row - 1;
+	else if (drow > 0)
+		row = cur->row + cur->rows;
+	if (dcol < 0)
+		col = cur->col - 2;
+	else if (dcol > 0)
+		col = cur->col + cur->cols + 1;
+	return wins_at(self, row, col);
+}
+
+// ========================================
+// helper definition
+// ========================================
+
+int wins_new(struct win_t *from, struct win_t **res)
+{
+	struct win_t *win = (struct win_t *) calloc(1, sizeof(struct win_t));
+	if (win == NULL)
+		return MALLOC_ERR;
+	win->ve = from->ve;
+	win->crow = from->crow;
+	win->ccol = from->ccol;
+	win->offset_row = from->offset_row;
+	win->offset_col = from->offset_col;
+	*res = win;
+	return NO_ERR;
+}
+
+void wins_drop(struct win_t *win)
+{
+	if (win == NULL)
+		return;
+	wins_drop(win->child[0]);
+	wins_drop(win->child[1]);
+	free(win);
+}
+
+void wins_place(struct wins_t *self, struct win_t *win, int row, int col,
+	int rows, int cols)
+{
+	win->row = row;
+	win->col = col;
+	win->rows = rows;
+	win->cols = cols;
+	memset(&win->drawn, 0, sizeof(win->drawn));
+
+	// a lone window leaves its status to the status bar
+	if (win->split == WIN_LEAF)
+	{
+		win->text_rows = rows - (self->root->split != WIN_LEAF);
+		if (win->text_rows < 0)
+			win->text_rows = 0;
+	}
+	else if (win->split == WIN_ROWS)
+	{
+		int top = rows - rows / 2;
+		wins_place(self, win->child[0], row, col, top, cols);
+		wins_place(self, win->child[1], row + top, col, rows - top, cols);
+	}
+	else
+	{
+		int left = cols > 0 ? cols - 1 - (cols - 1) / 2 : 0;
+		int right = cols - 1 - left;
+		wins_place(self, win->child[0], row, col, rows, left);
+		wins_place(self, win->child[1], row, col + left + 1, rows,
+			right > 0 ? right : 0);
+	}
+}
+
+struct win_t *wins_edge(struct win_t *win, int side)
+{
+	while (win->split != WIN_LEAF)
+		win = win->child[side];
+	return win;
+}
+
+struct win_t *wins_at(struct wins_t *self, int row, int col)
+{
+	if (row < 0 || row >= self->rows || col < 0 || col >= self->cols)
+		return NULL;
+
+	struct win_t *win = self->root;
+	while (win->split != WIN_LEAF)
+	{
+		struct win_t *second = win->child[1];
+		if (win->split == WIN_ROWS)
+			win = win->child[row >= second->row];
+		else
+			win = win->child[col >= second->col];
+	}
+
+	// the separator belongs to no window
+	if (col >= win->col + win->cols)
+		return NULL;
+	return win;
+}
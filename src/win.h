@@ -0,0 +1,209 @@
+#ifndef WIN_H
+#define WIN_H
+
+#include "util.h"
+#include "ve.h"
+
+struct bufs_t;
+
+// ========================================
+// windows
+// ========================================
+
+/**
+ * kinds of windows
+ *
+ * kinds:
+ *	WIN_LEAF	shows a buffer
+ *	WIN_ROWS	split into a top and a bottom window
+ *	WIN_COLS	split into a left and a right window with a separator
+ *		column between them
+ */
+enum
+{
+	WIN_LEAF = 0,
+	WIN_ROWS,
+	WIN_COLS,
+};
+
+/**
+ * what the text of a window was last drawn from; the text is drawn again
+ * only when it changes
+ *
+ * members:
+ *	ve		buffer shown; NULL if nothing was drawn
+ *	version		version of the document
+ *	lang		language of the highlighting
+ *	offset_row	first row shown
+ *	offset_col	first column shown
+ *	intro		was the intro shown
+ */
+struct win_key_t
+{
+	struct ve_t *ve;
+	long version;
+	int lang;
+	int offset_row;
+	int offset_col;
+	int intro;
+};
+
+/**
+ * window; a view of a buffer with its own cursor and scroll offsets, or a
+ * split of its rectangle between two windows
+ * the focused window keeps its cursor and offsets in its buffer; the
+ * others keep theirs here
+ *
+ * members:
+ *	split		one of WIN_*
+ *	parent		split holding the window; NULL for the whole screen
+ *	child		the two halves of a split; top or left first
+ *	ve		buffer shown
+ *	crow		cursor row
+ *	ccol		cursor column
+ *	offset_row	first row shown
+ *	offset_col	first column shown
+ *	row		first row on the screen
+ *	col		first column on the screen
+ *	rows		number of rows with the status line
+ *	cols		number of columns
+ *	text_rows	number of rows of text
+ *	drawn		what the text was drawn from
+ */
+struct win_t
+{
+	int split;
+	struct win_t *parent;
+	struct win_t *child[2];
+
+	struct ve_t *ve;
+	int crow;
+	int ccol;
+	int offset_row;
+	int offset_col;
+
+	int row;
+	int col;
+	int rows;
+	int cols;
+	int text_rows;
+
+	struct win_key_t drawn;
+};
+
+/**
+ * windows sharing the screen above the status bar
+ * a window gets a status line of its own once there are several
+ *
+ * members:
+ *	root	window of the whole screen
+ *	cur	focused window; shows the current buffer of bufs
+ *	bufs	buffer list the windows show
+ *	rows	number of rows of the screen
+ *	cols	number of columns of the screen
+ */
+struct wins_t
+{
+	struct win_t *root;
+	struct win_t *cur;
+	struct bufs_t *bufs;
+	int rows;
+	int cols;
+};
+
+/**
+ * initialize one window showing the current buffer
+ *
+ * params:
+ *	self	self pointer
+ *	bufs	buffer list; gets a pointer to the windows
+ */
+int wins_init(struct wins_t *self, struct bufs_t *bufs);
+
+/**
+ * free every window; the buffers stay
+ *
+ * params:
+ *	self	self pointer
+ */
+int wins_free(struct wins_t *self);
+
+/**
+ * place the windows on a screen of the given size; all of them are drawn
+ * again
+ *
+ * params:
+ *	self	self pointer
+ *	rows	number of rows
+ *	cols	number of columns
+ */
+int wins_layout(struct wins_t *self, int rows, int cols);
+
+/**
+ * make the focused window follow its buffer; it takes the buffer
+ * switched to and the cursor moved by the editor
+ *
+ * params:
+ *	self	self pointer
+ */
+void wins_sync(struct wins_t *self);
+
+/**
+ * split the focused window in two; the new window shows the same place
+ * of the same buffer and gets the focus
+ * gives RANGE_ERR if the window is too small
+ *
+ * params:
+ *	self	self pointer
+ *	split	WIN_ROWS or WIN_COLS
+ */
+int wins_split(struct wins_t *self, int split);
+
+/**
+ * close the focused window; its neighbour takes its place and the focus
+ * gives RANGE_ERR for the last window
+ *
+ * params:
+ *	self	self pointer
+ */
+int wins_close(struct wins_t *self);
+
+/**
+ * close every window but the focused one
+ *
+ * params:
+ *	self	self pointer
+ */
+int wins_only(struct wins_t *self);
+
+/**
+ * focus a window; its buffer becomes the current one with the cursor and
+ * offsets of the window
+ *
+ * params:
+ *	self	self pointer
+ *	win	window showing a buffer
+ */
+int wins_focus(struct wins_t *self, struct win_t *win);
+
+/**
+ * window after another one, top to bottom and left to right
+ *
+ * params:
+ *	self	self pointer
+ *	win	window; NULL for the first one
+ *	step	+1 for the next window, -1 for the one before; wraps around
+ */
+struct win_t *wins_next(struct wins_t *self, struct win_t *win, int step);
+
+/**
+ * window next to the focused one on the screen; NULL if there is none
+ *
+ * params:
+ *	self	self pointer
+ *	drow	-1 for above, +1 for below, 0 for the same rows
+ *	dcol	-1 for the left, +1 for the right, 0 for the same columns
+ */
+struct win_t *wins_near(struct wins_t *self, int drow, int dcol);
+
+#endif // WIN_H